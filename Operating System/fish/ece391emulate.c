@@ -176,6 +176,13 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+/* no back page here, the drawing goes straight to /dev/mem */
+int32_t 
+ece391_vidflip (void)
+{
+    return -1;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
@@ -41,6 +41,7 @@ int main(void)
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
         mp1_rtc_tasklet(garbage);
+        ece391_vidflip();
     }
 
     blink_struct.on_char = 'I';
@@ -54,6 +55,7 @@ int main(void)
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
         mp1_rtc_tasklet(garbage);
+        ece391_vidflip();
     }
 
     mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
@@ -61,6 +63,7 @@ int main(void)
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
         mp1_rtc_tasklet(garbage);
+        ece391_vidflip();
     }
 
     mp1_ioctl(6*80+60, RTC_REMOVE);
@@ -68,6 +71,7 @@ int main(void)
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
         mp1_rtc_tasklet(garbage);
+        ece391_vidflip();
     }
 
     ece391_close(rtc_fd);
@@ -152,9 +156,11 @@ mp1_set_video_mode (void)
 {
     if(ece391_vidmap(&vmem_base_addr) == -1) {
         return NULL;
-    } else {
-        return vmem_base_addr;
     }
+    /* draw into a back page, each frame goes on the screen whole;
+     * without it ece391_vidflip fails and the drawing goes straight there */
+    ece391_vidflip();
+    return vmem_base_addr;
 }
 
 void* mp1_malloc(int32_t size)
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Symbolize the output of the "prof" user program into a flat profile.
+
+Usage: profsym.py [-k bootimg] [-f filesys_img] [-e elfdir ...] [dump]
+
+The dump is the text printed by "prof stop" / "prof dump" (read from
+stdin when no file is given).  Kernel samples are looked up in bootimg,
+user samples in <name>.exe or <name> under each elfdir, where <name> is
+the file whose inode the pid was running according to filesys_img.
+"""
+
+import argparse
+import bisect
+import collections
+import os
+import struct
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DENTRY_OFFSET = 64
+DENTRY_SIZE = 64
+NAME_LEN = 32
+
+
+def read_inode_names(fs_img):
+    """Map inode number -> file name from the boot block of a filesys_img."""
+    names = {}
+    with open(fs_img, "rb") as f:
+        boot = f.read(4096)
+    (num_dentry,) = struct.unpack_from("<I", boot, 0)
+    for i in range(num_dentry):
+        off = DENTRY_OFFSET + i * DENTRY_SIZE
+        raw, _ftype, inode = struct.unpack_from("<32sII", boot, off)
+        names[inode] = raw.split(b"\0", 1)[0].decode("ascii", "replace")
+    return names
+
+
+class SymbolTable:
+    """Sorted text symbols of one ELF file, as reported by nm."""
+
+    def __init__(self, path):
+        self.path = path
+        self.addrs = []
+        self.names = []
+        try:
+            out = subprocess.run(["nm", "-n", "--defined-only", path],
+                                 capture_output=True, text=True).stdout
+        except OSError:
+            out = ""
+        for line in out.splitlines():
+            parts = line.split()
+            if len(parts) == 3 and parts[1] in "tTwW":
+                self.addrs.append(int(parts[0], 16))
+                self.names.append(parts[2])
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%08x" % addr
+        return self.names[i]
+
+
+def find_elf(name, elf_dirs):
+    for d in elf_dirs:
+        for cand in (name + ".exe", name):
+            path = os.path.join(d, cand)
+            if os.path.isfile(path):
+                return path
+    return None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("-k", "--kernel",
+                    default=os.path.join(HERE, "student-distrib", "bootimg"))
+    ap.add_argument("-f", "--fsimg",
+                    default=os.path.join(HERE, "student-distrib", "filesys_img"))
+    ap.add_argument("-e", "--elfdir", action="append",
+                    default=[os.path.join(HERE, "syscalls"),
+                             os.path.join(HERE, "fish"),
+                             os.path.join(HERE, "fsdir")])
+    ap.add_argument("dump", nargs="?")
+    args = ap.parse_args()
+
+    inode_names = read_inode_names(args.fsimg)
+    kernel = SymbolTable(args.kernel)
+    user_tables = {}
+    pid_prog = {}
+    counts = collections.Counter()
+    total = 0
+
+    src = open(args.dump) if args.dump else sys.stdin
+    for line in src:
+        parts = line.split()
+        if len(parts) == 3 and parts[0] == "C":
+            pid_prog[int(parts[1], 16)] = inode_names.get(int(parts[2], 16), "?")
+        elif len(parts) == 4 and parts[0] == "S":
+            pid, cs, eip = (int(p, 16) for p in parts[1:])
+            if cs & 3 == 0:
+                image, sym = "kernel", kernel.lookup(eip)
+            else:
+                image = pid_prog.get(pid, "pid%d" % pid)
+                if image not in user_tables:
+                    path = find_elf(image, args.elfdir)
+                    user_tables[image] = SymbolTable(path) if path else None
+                table = user_tables[image]
+                sym = table.lookup(eip) if table else "0x%08x" % eip
+            counts[(image, sym)] += 1
+            total += 1
+
+    if total == 0:
+        print("no samples")
+        return
+    print("%8s %7s  %-12s %s" % ("samples", "%", "image", "symbol"))
+    for (image, sym), n in counts.most_common():
+        print("%8d %6.2f%%  %-12s %s" % (n, 100.0 * n / total, image, sym))
+
+
+if __name__ == "__main__":
+    main()
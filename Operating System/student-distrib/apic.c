@@ -0,0 +1,224 @@
+#include "apic.h"
+#include "lib.h"
+#include "paging.h"
+#include "pit.h"
+#include "i8259.h"
+
+volatile uint32_t ioapic_active;
+
+/* PIC masks, the irqs that are enabled when the IOAPIC takes over */
+extern uint8_t master_mask;
+extern uint8_t slave_mask;
+
+static uint8_t irq_pin[ISA_IRQS];
+static uint32_t ioapic_pins;
+
+/*
+ *	Function: lapic_read / lapic_write
+ *	Description: access a local APIC register of the calling cpu
+ *	input: reg -- register offset, value -- what to write
+ *	output: the register (read)
+ *	side-effect: none
+ */
+static uint32_t lapic_read(uint32_t reg) {
+  return *(volatile uint32_t*)(LAPIC_VIRT + reg);
+}
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+  *(volatile uint32_t*)(LAPIC_VIRT + reg) = value;
+}
+
+/*
+ *	Function: ioapic_read / ioapic_write
+ *	Description: access an IOAPIC register through IOREGSEL/IOWIN
+ *	input: reg -- register index, value -- what to write
+ *	output: the register (read)
+ *	side-effect: none
+ */
+static uint32_t ioapic_read(uint32_t reg) {
+  *(volatile uint32_t*)(IOAPIC_VIRT + IOAPIC_REGSEL) = reg;
+  return *(volatile uint32_t*)(IOAPIC_VIRT + IOAPIC_WIN);
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value) {
+  *(volatile uint32_t*)(IOAPIC_VIRT + IOAPIC_REGSEL) = reg;
+  *(volatile uint32_t*)(IOAPIC_VIRT + IOAPIC_WIN) = value;
+}
+
+/*
+ *	Function: apic_map
+ *	Description: map the local APIC and IOAPIC registers uncached and
+ *	             start with every ISA irq on the pin of the same number
+ *	input: lapic_phys, ioapic_phys -- register bases from the MP table
+ *	output: None
+ *	side-effect: none
+ */
+void apic_map(uint32_t lapic_phys, uint32_t ioapic_phys) {
+  uint32_t i;
+
+  map_virt_to_phys(page_directory, LAPIC_VIRT, lapic_phys, RW_P_SET | PAGE_GLOBAL | PAGE_NOCACHE);
+  map_virt_to_phys(page_directory, IOAPIC_VIRT, ioapic_phys, RW_P_SET | PAGE_GLOBAL | PAGE_NOCACHE);
+  for (i = 0; i < ISA_IRQS; i++) {
+    irq_pin[i] = i;
+  }
+  ioapic_pins = ((ioapic_read(IOAPIC_VER) >> IOAPIC_MAX_SHIFT) & 0xFF) + 1;
+  if (ioapic_pins > IOAPIC_PINS_MAX) {
+    ioapic_pins = IOAPIC_PINS_MAX;
+  }
+}
+
+/*
+ *	Function: lapic_init
+ *	Description: software-enable the local APIC with the spurious vector,
+ *	             mask LINT0 (the PIC is not used once the IOAPIC runs) and
+ *	             accept every priority
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void lapic_init() {
+  lapic_write(LAPIC_SVR, LAPIC_ENABLE | SPURIOUS_VEC);
+  lapic_write(LAPIC_LVT_TIMER, LAPIC_MASKED);
+  lapic_write(LAPIC_LVT_LINT0, LAPIC_MASKED);
+  lapic_write(LAPIC_LVT_LINT1, LAPIC_NMI);
+  lapic_write(LAPIC_LVT_ERROR, LAPIC_MASKED);
+  lapic_write(LAPIC_ESR, 0);
+  lapic_write(LAPIC_ESR, 0);
+  lapic_write(LAPIC_TPR, 0);
+  lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ *	Function: lapic_id
+ *	Description: APIC id of the calling cpu
+ *	input: None
+ *	output: the id
+ *	side-effect: none
+ */
+uint32_t lapic_id() {
+  return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+ *	Function: lapic_eoi
+ *	Description: end of interrupt for the local APIC
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void lapic_eoi() {
+  lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ *	Function: lapic_ipi
+ *	Description: send an interprocessor interrupt
+ *	input: apic_id -- destination, icr -- delivery mode and vector
+ *	output: None
+ *	side-effect: spins until the local APIC has sent it
+ */
+void lapic_ipi(uint32_t apic_id, uint32_t icr) {
+  lapic_write(LAPIC_ICR_HI, apic_id << LAPIC_ID_SHIFT);
+  lapic_write(LAPIC_ICR_LO, icr);
+  while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_BUSY) {
+    asm volatile("pause");
+  }
+}
+
+/*
+ *	Function: lapic_timer_calibrate
+ *	Description: count how far the LAPIC timer runs in LAPIC_CALIBRATE
+ *	             PIT ticks
+ *	input: None
+ *	output: LAPIC timer ticks per PIT tick, with divide by 16
+ *	side-effect: needs interrupts on, the PIT is what moves pit_ticks
+ */
+uint32_t lapic_timer_calibrate() {
+  uint32_t start;
+
+  lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+  lapic_write(LAPIC_LVT_TIMER, LAPIC_MASKED);
+  start = pit_ticks;
+  while (pit_ticks == start)
+    ;
+  lapic_write(LAPIC_TIMER_INIT, LAPIC_TIMER_MAX);
+  start = pit_ticks;
+  while (pit_ticks - start < LAPIC_CALIBRATE)
+    ;
+  return (LAPIC_TIMER_MAX - lapic_read(LAPIC_TIMER_CUR)) / LAPIC_CALIBRATE;
+}
+
+/*
+ *	Function: lapic_timer_start
+ *	Description: run the LAPIC timer periodically on LAPIC_TIMER_VEC
+ *	input: count -- ticks between interrupts, from lapic_timer_calibrate
+ *	output: None
+ *	side-effect: none
+ */
+void lapic_timer_start(uint32_t count) {
+  lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+  lapic_write(LAPIC_LVT_TIMER, LAPIC_PERIODIC | LAPIC_TIMER_VEC);
+  lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/*
+ *	Function: ioapic_set_pin
+ *	Description: record that an ISA irq is wired to another IOAPIC pin
+ *	input: irq -- ISA irq, pin -- IOAPIC input
+ *	output: None
+ *	side-effect: none
+ */
+void ioapic_set_pin(uint32_t irq, uint32_t pin) {
+  if (irq < ISA_IRQS && pin < IOAPIC_PINS_MAX) {
+    irq_pin[irq] = pin;
+  }
+}
+
+/*
+ *	Function: ioapic_mask
+ *	Description: mask or unmask an ISA irq at the IOAPIC
+ *	input: irq -- ISA irq, masked -- 1 to mask
+ *	output: None
+ *	side-effect: none
+ */
+void ioapic_mask(uint32_t irq, uint32_t masked) {
+  uint32_t reg, low;
+
+  if (irq >= ISA_IRQS || irq_pin[irq] >= ioapic_pins) {
+    return;
+  }
+  reg = IOAPIC_REDTBL + 2 * irq_pin[irq];
+  low = ioapic_read(reg);
+  low = masked ? (low | LAPIC_MASKED) : (low & ~LAPIC_MASKED);
+  ioapic_write(reg, low);
+}
+
+/*
+ *	Function: ioapic_takeover
+ *	Description: route every ISA irq to its old vector on one cpu, keep
+ *	             the PIC's enabled set and mask the PIC itself
+ *	input: apic_id -- cpu that handles device interrupts
+ *	output: None
+ *	side-effect: interrupts must be off; send_eoi and enable_irq go to the
+ *	             APICs from now on
+ */
+void ioapic_takeover(uint32_t apic_id) {
+  uint32_t irq, masked;
+
+  for (irq = 0; irq < ioapic_pins; irq++) {
+    ioapic_write(IOAPIC_REDTBL + 2 * irq, LAPIC_MASKED);
+  }
+  for (irq = 0; irq < ISA_IRQS; irq++) {
+    /* the cascade input means nothing without the PIC */
+    if (irq == ISA_CASCADE_IRQ || irq_pin[irq] >= ioapic_pins) {
+      continue;
+    }
+    masked = (irq < 8) ? (master_mask >> irq) & 1 : (slave_mask >> (irq - 8)) & 1;
+    /* edge triggered, active high, fixed delivery in physical mode */
+    ioapic_write(IOAPIC_REDTBL + 2 * irq_pin[irq] + 1, apic_id << LAPIC_ID_SHIFT);
+    ioapic_write(IOAPIC_REDTBL + 2 * irq_pin[irq], (IRQ_BASE_VEC + irq) | (masked ? LAPIC_MASKED : 0));
+  }
+  outb(0xFF, MASTER_8259_PORT_D);
+  outb(0xFF, SLAVE_8259_PORT_D);
+  ioapic_active = 1;
+}
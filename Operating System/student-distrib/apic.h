@@ -0,0 +1,81 @@
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* the local APIC and IOAPIC registers are mapped uncached at the top of
+ * the kernel's first 4MB, which every page directory shares */
+#define LAPIC_VIRT        0x003FE000
+#define IOAPIC_VIRT       0x003FF000
+#define LAPIC_DEFAULT     0xFEE00000
+#define IOAPIC_DEFAULT    0xFEC00000
+
+/* local APIC register offsets */
+#define LAPIC_ID          0x020
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ESR         0x280
+#define LAPIC_ICR_LO      0x300
+#define LAPIC_ICR_HI      0x310
+#define LAPIC_LVT_TIMER   0x320
+#define LAPIC_LVT_LINT0   0x350
+#define LAPIC_LVT_LINT1   0x360
+#define LAPIC_LVT_ERROR   0x370
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_CUR   0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+#define LAPIC_ID_SHIFT    24
+#define LAPIC_ENABLE      0x00000100  /* SVR software enable */
+#define LAPIC_MASKED      0x00010000
+#define LAPIC_PERIODIC    0x00020000
+#define LAPIC_NMI         0x00000400
+#define LAPIC_DIV_16      0x3
+#define LAPIC_ICR_INIT    0x00004500  /* INIT, level assert */
+#define LAPIC_ICR_SIPI    0x00004600  /* startup, vector is the page number */
+#define LAPIC_ICR_FIXED   0x00004000
+#define LAPIC_ICR_BUSY    0x00001000
+#define LAPIC_TIMER_MAX   0xFFFFFFFF
+#define LAPIC_CALIBRATE   10          /* PIT ticks to count LAPIC ticks over */
+
+/* vectors above the PIC range */
+#define LAPIC_TIMER_VEC   0x40
+#define IPI_RESCHED_VEC   0x41
+#define IPI_TLB_VEC       0x42
+#define SPURIOUS_VEC      0xFF
+
+/* IOAPIC registers, reached through the select/window pair */
+#define IOAPIC_REGSEL     0x00
+#define IOAPIC_WIN        0x10
+#define IOAPIC_VER        0x01
+#define IOAPIC_REDTBL     0x10
+#define IOAPIC_MAX_SHIFT  16
+#define IOAPIC_PINS_MAX   24
+#define ISA_IRQS          16
+#define ISA_CASCADE_IRQ   2
+#define IRQ_BASE_VEC      0x20        /* same vectors the PIC used */
+
+/* set once the legacy IRQs go through the IOAPIC instead of the 8259 */
+extern volatile uint32_t ioapic_active;
+
+/* map the registers, physical bases from the MP table */
+void apic_map(uint32_t lapic_phys, uint32_t ioapic_phys);
+/* enable the local APIC of the calling cpu */
+void lapic_init();
+uint32_t lapic_id();
+void lapic_eoi();
+/* send a fixed, INIT or startup IPI and wait for it to be accepted */
+void lapic_ipi(uint32_t apic_id, uint32_t icr);
+/* LAPIC timer ticks in one PIT tick, measured on the boot cpu */
+uint32_t lapic_timer_calibrate();
+/* periodic LAPIC timer on the calling cpu */
+void lapic_timer_start(uint32_t count);
+
+/* ISA irq to IOAPIC pin, from the MP table's interrupt entries */
+void ioapic_set_pin(uint32_t irq, uint32_t pin);
+/* move every unmasked PIC irq to the IOAPIC, delivered to apic_id */
+void ioapic_takeover(uint32_t apic_id);
+void ioapic_mask(uint32_t irq, uint32_t masked);
+
+#endif
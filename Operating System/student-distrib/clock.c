@@ -0,0 +1,155 @@
+#include "clock.h"
+#include "lib.h"
+#include "pit.h"
+#include "sys_call.h"
+#include "kstat.h"
+
+uint32_t tsc_khz;
+static uint32_t clock_mult;
+static uint64_t clock_base;
+
+/*
+ *	Function: div64_32
+ *	Description: 64 by 32 bit division, one divl per half so the quotient
+ *	             of each step fits
+ *	input: n -- dividend, replaced by the quotient, base -- divisor
+ *	output: the remainder
+ *	side-effect: none
+ */
+uint32_t div64_32(uint64_t* n, uint32_t base) {
+  uint32_t high = (uint32_t)(*n >> 32);
+  uint32_t low = (uint32_t)*n;
+  uint32_t q_high = high / base;
+  uint32_t q_low, rem;
+
+  high %= base;
+  asm("divl %4" : "=a"(q_low), "=d"(rem) : "a"(low), "d"(high), "rm"(base));
+  *n = ((uint64_t)q_high << 32) | q_low;
+  return rem;
+}
+
+/*
+ *	Function: clock_cal_run
+ *	Description: count TSC cycles while PIT channel 2 counts down
+ *	             CLOCK_CAL_MS milliseconds
+ *	input: None
+ *	output: cycles elapsed
+ *	side-effect: uses channel 2 and the speaker gate, interrupts must be off
+ */
+static uint32_t clock_cal_run() {
+  uint32_t count = PIT_BASE_FREQ / 1000 * CLOCK_CAL_MS;
+  uint8_t gate = inb(SPEAKER_PORT) & ~(SPEAKER_GATE2 | SPEAKER_DATA);
+  uint64_t start;
+
+  outb(gate, SPEAKER_PORT);
+  outb(PIT_MODE0_CH2, PIT_CMD_PORT);
+  outb(count & PIT_LOW_MASK, PIT_CHANNEL2);
+  outb((count >> PIT_HIGH_SHIFT) & PIT_LOW_MASK, PIT_CHANNEL2);
+  outb(gate | SPEAKER_GATE2, SPEAKER_PORT);
+  start = rdtsc();
+  while (!(inb(SPEAKER_PORT) & SPEAKER_OUT2)) {
+  }
+  return (uint32_t)(rdtsc() - start);
+}
+
+/*
+ *	Function: clock_init
+ *	Description: calibrate the TSC and start the clock at 0
+ *	input: None
+ *	output: None
+ *	side-effect: leaves channel 2 stopped
+ */
+void clock_init() {
+  uint32_t i, cycles, best = 0;
+  uint64_t n;
+
+  for (i = 0; i < CLOCK_CAL_RUNS; i++) {
+    cycles = clock_cal_run();
+    if (best == 0 || cycles < best) {
+      best = cycles;
+    }
+  }
+  outb(inb(SPEAKER_PORT) & ~(SPEAKER_GATE2 | SPEAKER_DATA), SPEAKER_PORT);
+  tsc_khz = best / CLOCK_CAL_MS;
+  if (tsc_khz == 0) {
+    tsc_khz = 1;
+  }
+  n = (uint64_t)NS_PER_MS << CLOCK_SHIFT;
+  div64_32(&n, tsc_khz);
+  clock_mult = (uint32_t)n;
+  clock_base = rdtsc();
+}
+
+/*
+ *	Function: cycles_to_ns
+ *	Description: convert a TSC interval to nanoseconds, the product is
+ *	             split at 32 bits so nothing overflows before the shift
+ *	input: cycles -- TSC cycles
+ *	output: nanoseconds
+ *	side-effect: none
+ */
+uint64_t cycles_to_ns(uint64_t cycles) {
+  uint64_t low = (uint64_t)(uint32_t)cycles * clock_mult;
+  uint64_t high = (uint64_t)(uint32_t)(cycles >> 32) * clock_mult;
+
+  return (low >> CLOCK_SHIFT) + (high << (32 - CLOCK_SHIFT));
+}
+
+/*
+ *	Function: clock_ns
+ *	Description: monotonic time
+ *	input: None
+ *	output: nanoseconds since clock_init
+ *	side-effect: none
+ */
+uint64_t clock_ns() {
+  return cycles_to_ns(rdtsc() - clock_base);
+}
+
+/*
+ *	Function: clock_tsc_ns
+ *	Description: place a saved TSC reading on the monotonic clock
+ *	input: tsc -- from rdtsc
+ *	output: nanoseconds since clock_init, 0 for readings before it
+ *	side-effect: none
+ */
+uint64_t clock_tsc_ns(uint64_t tsc) {
+  return tsc < clock_base ? 0 : cycles_to_ns(tsc - clock_base);
+}
+
+/*
+ *	Function: clock_gettime
+ *	Description: system call, read a clock into a user timespec
+ *	input: clock_id -- only CLOCK_MONOTONIC is kept, tp -- destination
+ *	output: 0, -1 for an unknown clock or a bad pointer
+ *	side-effect: none
+ */
+int32_t clock_gettime(int32_t clock_id, timespec_t* tp) {
+  uint64_t ns;
+
+  if (clock_id != CLOCK_MONOTONIC || (uint32_t)tp < _128MB || (uint32_t)(tp + 1) > USER_END) {
+    return -1;
+  }
+  ns = clock_ns();
+  tp->nsec = div64_32(&ns, NS_PER_SEC);
+  tp->sec = (uint32_t)ns;
+  return 0;
+}
+
+/*
+ *	Function: clock_kstat
+ *	Description: append the calibrated TSC frequency and the uptime
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void clock_kstat() {
+  uint64_t ms = clock_ns();
+
+  div64_32(&ms, NS_PER_MS);
+  kstat_puts("clock: tsc ");
+  kstat_putu(tsc_khz);
+  kstat_puts(" kHz, up ");
+  kstat_putu((uint32_t)ms);
+  kstat_puts(" ms\n");
+}
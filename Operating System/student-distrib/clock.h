@@ -0,0 +1,50 @@
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include "types.h"
+
+/* high-resolution clock: the TSC, calibrated against PIT channel 2 at boot.
+ * Time is kept as nanoseconds since clock_init. */
+#define CLOCK_MONOTONIC     1
+
+/* PIT channel 2, gated by the speaker port, counts down once */
+#define PIT_CHANNEL2        0x42
+#define PIT_MODE0_CH2       0xB0      /* channel 2, lobyte/hibyte, interrupt on terminal count */
+#define SPEAKER_PORT        0x61
+#define SPEAKER_GATE2       0x01      /* starts channel 2 counting */
+#define SPEAKER_DATA        0x02      /* keep the speaker itself off */
+#define SPEAKER_OUT2        0x20      /* output of channel 2, high at terminal count */
+#define CLOCK_CAL_MS        10        /* length of one calibration run */
+#define CLOCK_CAL_RUNS      3         /* the shortest run wins, it was interrupted least */
+
+/* ns = cycles * mult >> CLOCK_SHIFT */
+#define CLOCK_SHIFT         24
+#define NS_PER_US           1000
+#define NS_PER_MS           1000000
+#define NS_PER_SEC          1000000000
+
+typedef struct {
+    uint32_t sec;
+    uint32_t nsec;
+} timespec_t;
+
+/* TSC frequency, in kHz so it fits 32 bits */
+extern uint32_t tsc_khz;
+
+/* measure the TSC, before pit_init takes over the PIT */
+void clock_init();
+/* nanoseconds since boot, and TSC cycles converted to nanoseconds */
+uint64_t clock_ns();
+/* a TSC reading taken earlier, as nanoseconds since clock_init */
+uint64_t clock_tsc_ns(uint64_t tsc);
+uint64_t cycles_to_ns(uint64_t cycles);
+/* divide n in place, return the remainder; no 64-bit division in libgcc-less builds */
+uint32_t div64_32(uint64_t* n, uint32_t base);
+
+/* system call */
+int32_t clock_gettime(int32_t clock_id, timespec_t* tp);
+
+/* append the clock frequency to the kstat report */
+void clock_kstat();
+
+#endif
@@ -0,0 +1,189 @@
+#include "fpu.h"
+#include "lib.h"
+#include "slab.h"
+#include "kstat.h"
+#include "sys_call.h"
+#include "smp.h"
+#include "klog.h"
+
+fpu_stats_t fpu_stats;
+
+/* the thread whose state is in a cpu's FPU registers is cpu->fpu_owner */
+static kmem_cache_t* fpu_cache;
+static uint32_t fpu_enabled;
+static uint32_t fpu_cr4;
+
+/*
+ *	Function: fpu_init
+ *	Description: turn on the FPU with FXSAVE and SSE support and leave
+ *	             CR0.TS set so the first FP instruction traps
+ *	input: None
+ *	output: None
+ *	side-effect: without FXSR CR0.EM stays set and FP use still halts
+ *	             the program
+ */
+void fpu_init() {
+  uint32_t eax, ebx, ecx, edx;
+
+  asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(CPUID_FEATURES));
+  if (!(edx & CPUID_FXSR)) {
+    return;
+  }
+  fpu_cache = kmem_cache_create("fpu state", FPU_STATE_SIZE);
+  if (fpu_cache == NULL) {
+    return;
+  }
+  fpu_cr4 = CR4_OSFXSR;
+  if (edx & CPUID_SSE) {
+    fpu_cr4 |= CR4_OSXMMEXCPT;
+  }
+  fpu_enabled = 1;
+  fpu_cpu_init();
+}
+
+/*
+ *	Function: fpu_cpu_init
+ *	Description: set the CR0/CR4 bits fpu_init chose on the calling cpu
+ *	input: None
+ *	output: None
+ *	side-effect: leaves CR0.TS set
+ */
+void fpu_cpu_init() {
+  uint32_t cr0, cr4;
+
+  if (!fpu_enabled) {
+    return;
+  }
+  asm volatile("movl %%cr4, %0" : "=r"(cr4));
+  asm volatile("movl %0, %%cr4" : : "r"(cr4 | fpu_cr4));
+
+  asm volatile("movl %%cr0, %0" : "=r"(cr0));
+  cr0 = (cr0 & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS;
+  asm volatile("movl %0, %%cr0" : : "r"(cr0));
+}
+
+/*
+ *	Function: fpu_switch
+ *	Description: arm the #NM trap for a thread that does not own the FPU.
+ *	             With other cpus running, prev may resume on one of them,
+ *	             so its registers are saved now instead of on the next trap.
+ *	input: prev -- the thread giving up the cpu, next -- the one about to run
+ *	output: None
+ *	side-effect: sets or clears CR0.TS
+ */
+void fpu_switch(thread_t* prev, thread_t* next) {
+  cpu_t* cpu;
+
+  if (!fpu_enabled) {
+    return;
+  }
+  cpu = this_cpu();
+  if (smp_active && prev != next && cpu->fpu_owner == prev) {
+    asm volatile("clts; fxsave (%0)" : : "r"(prev->fpu) : "memory");
+    fpu_stats.saves++;
+  }
+  if (next == cpu->fpu_owner) {
+    asm volatile("clts");
+  } else {
+    uint32_t cr0;
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    asm volatile("movl %0, %%cr0" : : "r"(cr0 | CR0_TS));
+  }
+}
+
+/*
+ *	Function: fpu_trap
+ *	Description: save the previous owner's registers and load the current
+ *	             thread's, starting from a clean state on its first use
+ *	input: None
+ *	output: None
+ *	side-effect: allocates the thread's save area on first use, halts the
+ *	             program if there is no FPU support or no memory for it
+ */
+void fpu_trap() {
+  thread_t* cur = get_cur_thread();
+  cpu_t* cpu;
+  uint32_t mxcsr = MXCSR_DEFAULT;
+  uint32_t flags;
+  uint32_t i;
+
+  if (!fpu_enabled) {
+    klog(KLOG_ERR, "%s", "Device Not Available");
+    halt(255);
+    return;
+  }
+  cli_and_save(flags);
+  cpu = this_cpu();
+  fpu_stats.traps++;
+  asm volatile("clts");
+  if (cur != cpu->fpu_owner) {
+    /* fpu_switch already saved it when other cpus are running */
+    if (cpu->fpu_owner != NULL && !smp_active) {
+      asm volatile("fxsave (%0)" : : "r"(cpu->fpu_owner->fpu) : "memory");
+      fpu_stats.saves++;
+    }
+    cpu->fpu_owner = NULL;
+    /* registers another cpu still has for us are older than the saved area */
+    for (i = 0; i < MAX_CPUS; i++) {
+      if (cpus[i].fpu_owner == cur) {
+        cpus[i].fpu_owner = NULL;
+      }
+    }
+    if (cur->fpu == NULL) {
+      cur->fpu = kmem_cache_alloc(fpu_cache);
+      if (cur->fpu == NULL) {
+        restore_flags(flags);
+        halt(255);
+        return;
+      }
+      asm volatile("fninit; ldmxcsr %0" : : "m"(mxcsr));
+      fpu_stats.inits++;
+    } else {
+      asm volatile("fxrstor (%0)" : : "r"(cur->fpu) : "memory");
+      fpu_stats.restores++;
+    }
+    cpu->fpu_owner = cur;
+  }
+  restore_flags(flags);
+}
+
+/*
+ *	Function: fpu_release
+ *	Description: drop a thread's FPU state without saving it
+ *	input: t -- thread that is exiting
+ *	output: None
+ *	side-effect: none
+ */
+void fpu_release(thread_t* t) {
+  uint32_t flags;
+  uint32_t i;
+
+  cli_and_save(flags);
+  for (i = 0; i < MAX_CPUS; i++) {
+    if (cpus[i].fpu_owner == t) {
+      cpus[i].fpu_owner = NULL;
+    }
+  }
+  kmem_cache_free(fpu_cache, t->fpu);
+  t->fpu = NULL;
+  restore_flags(flags);
+}
+
+/*
+ *	Function: fpu_kstat
+ *	Description: append the FPU counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void fpu_kstat() {
+  kstat_puts("fpu: traps ");
+  kstat_putu(fpu_stats.traps);
+  kstat_puts(", first uses ");
+  kstat_putu(fpu_stats.inits);
+  kstat_puts(", saves ");
+  kstat_putu(fpu_stats.saves);
+  kstat_puts(", restores ");
+  kstat_putu(fpu_stats.restores);
+  kstat_puts("\n");
+}
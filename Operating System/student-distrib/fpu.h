@@ -0,0 +1,45 @@
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+#include "thread.h"
+
+/* control register bits for the FPU/SSE unit */
+#define CR0_MP          0x00000002  /* WAIT honours TS */
+#define CR0_EM          0x00000004  /* emulate, every FP instruction traps */
+#define CR0_TS          0x00000008  /* task switched, next FP instruction traps */
+#define CR0_NE          0x00000020  /* report FP errors as #MF */
+#define CR4_OSFXSR      0x00000200  /* FXSAVE/FXRSTOR and SSE enabled */
+#define CR4_OSXMMEXCPT  0x00000400  /* unmasked SSE exceptions raise #XF */
+
+#define CPUID_FEATURES  1
+#define CPUID_FXSR      0x01000000  /* edx bit 24 */
+#define CPUID_SSE       0x02000000  /* edx bit 25 */
+
+#define FPU_STATE_SIZE  512         /* FXSAVE area, 16 byte aligned */
+#define MXCSR_DEFAULT   0x1F80      /* all SSE exceptions masked */
+
+typedef struct {
+    uint32_t traps;         // #NM traps taken
+    uint32_t restores;      // FXRSTOR of a saved state
+    uint32_t saves;         // FXSAVE of the previous owner
+    uint32_t inits;         // first use by a thread
+} fpu_stats_t;
+
+extern fpu_stats_t fpu_stats;
+
+/* enable the FPU and SSE if the CPU has FXSR, needs slab_init */
+void fpu_init();
+/* same control register setup on an application processor */
+void fpu_cpu_init();
+/* called on every switch from prev to next: trap on next's first FP
+ * instruction unless its state is still in the registers */
+void fpu_switch(thread_t* prev, thread_t* next);
+/* #NM handler, hands the FPU to the current thread */
+void fpu_trap();
+/* forget and free the state of a thread that is going away */
+void fpu_release(thread_t* t);
+/* append the FPU counters to the kstat report */
+void fpu_kstat();
+
+#endif
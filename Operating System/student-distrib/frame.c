@@ -0,0 +1,178 @@
+#include "frame.h"
+#include "lib.h"
+#include "kstat.h"
+#include "spinlock.h"
+
+frame_stats_t frame_stats;
+
+/* one bit per frame below FRAME_LIMIT, set when the frame is in use */
+static uint32_t frame_map[FRAME_WORDS];
+/* word to start the next search from */
+static uint32_t frame_hint;
+static uint32_t frame_end;
+static spinlock_t frame_lock = SPINLOCK_INIT("frame");
+
+/*
+ *	Function: frame_mark
+ *	Description: mark the whole frames inside [start, end) as free or used
+ *	input: start, end -- physical byte range, free -- 1 to release the frames
+ *	output: None
+ *	side-effect: updates frame_stats.total/free
+ */
+static void frame_mark(uint32_t start, uint32_t end, uint32_t free) {
+  uint32_t frame, bit;
+
+  if (start < FRAME_LOW) {
+    start = FRAME_LOW;
+  }
+  if (end > FRAME_LIMIT) {
+    end = FRAME_LIMIT;
+  }
+  /* only frames that lie entirely inside the range */
+  start = (start + FRAME_SIZE - 1) >> FRAME_SHIFT;
+  end = end >> FRAME_SHIFT;
+  for (frame = start; frame < end; frame++) {
+    bit = 1 << (frame % FRAME_WORD_BITS);
+    if (free && (frame_map[frame / FRAME_WORD_BITS] & bit)) {
+      frame_map[frame / FRAME_WORD_BITS] &= ~bit;
+      frame_stats.total++;
+      frame_stats.free++;
+    } else if (!free && !(frame_map[frame / FRAME_WORD_BITS] & bit)) {
+      frame_map[frame / FRAME_WORD_BITS] |= bit;
+      frame_stats.total--;
+      frame_stats.free--;
+    }
+  }
+  if (free && end << FRAME_SHIFT > frame_end) {
+    frame_end = end << FRAME_SHIFT;
+  }
+}
+
+/*
+ *	Function: frame_init
+ *	Description: free every frame the boot loader reports as available RAM,
+ *	             then take back the ones holding boot modules
+ *	input: mbi -- multiboot information from the boot loader
+ *	output: None
+ *	side-effect: must run before paging_init, which maps up to frame_top
+ */
+void frame_init(multiboot_info_t* mbi) {
+  memory_map_t* mmap;
+  module_t* mod;
+  uint32_t i, end;
+
+  memset(frame_map, FRAME_WORD_FULL & 0xFF, sizeof(frame_map));
+  frame_stats.total = 0;
+  frame_stats.free = 0;
+  frame_hint = 0;
+  frame_end = FRAME_LOW;
+
+  if (mbi->flags & MULTIBOOT_INFO_MMAP) {
+    for (mmap = (memory_map_t*)mbi->mmap_addr;
+         (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+         mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))) {
+      if (mmap->type != MMAP_AVAILABLE || mmap->base_addr_high != 0) {
+        continue;
+      }
+      end = mmap->base_addr_low + mmap->length_low;
+      if (mmap->length_high != 0 || end < mmap->base_addr_low) {
+        end = FRAME_LIMIT;
+      }
+      frame_mark(mmap->base_addr_low, end, 1);
+    }
+  } else if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+    /* no memory map, mem_upper counts the KB above 1MB */
+    frame_mark(MULTIBOOT_UPPER_START, MULTIBOOT_UPPER_START + mbi->mem_upper * 1024, 1);
+  }
+
+  if (mbi->flags & MULTIBOOT_INFO_MODS) {
+    mod = (module_t*)mbi->mods_addr;
+    for (i = 0; i < mbi->mods_count; i++, mod++) {
+      frame_mark(mod->mod_start & ~(FRAME_SIZE - 1), mod->mod_end + FRAME_SIZE - 1, 0);
+    }
+  }
+  frame_stats.min_free = frame_stats.free;
+}
+
+/*
+ *	Function: frame_top
+ *	Description: end of the highest usable frame
+ *	input: None
+ *	output: physical address, at most FRAME_LIMIT
+ *	side-effect: none
+ */
+uint32_t frame_top() {
+  return frame_end;
+}
+
+/*
+ *	Function: frame_alloc
+ *	Description: take a free frame, searching on from the last allocation
+ *	input: None
+ *	output: physical address of the frame, 0 if memory is exhausted
+ *	side-effect: the frame is not cleared
+ */
+uint32_t frame_alloc() {
+  uint32_t i, w, bit;
+  uint32_t flags;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  for (i = 0; i < FRAME_WORDS; i++) {
+    w = (frame_hint + i) % FRAME_WORDS;
+    if (frame_map[w] == FRAME_WORD_FULL) {
+      continue;
+    }
+    for (bit = 0; frame_map[w] & (1 << bit); bit++)
+      ;
+    frame_map[w] |= 1 << bit;
+    frame_hint = w;
+    frame_stats.free--;
+    if (frame_stats.free < frame_stats.min_free) {
+      frame_stats.min_free = frame_stats.free;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return (w * FRAME_WORD_BITS + bit) << FRAME_SHIFT;
+  }
+  spin_unlock_irqrestore(&frame_lock, flags);
+  return 0;
+}
+
+/*
+ *	Function: frame_free
+ *	Description: return a frame to the allocator
+ *	input: addr -- physical address from frame_alloc
+ *	output: None
+ *	side-effect: freeing a frame twice or outside the map is ignored
+ */
+void frame_free(uint32_t addr) {
+  uint32_t frame = addr >> FRAME_SHIFT;
+  uint32_t bit = 1 << (frame % FRAME_WORD_BITS);
+  uint32_t flags;
+
+  if (addr < FRAME_LOW || addr >= FRAME_LIMIT) {
+    return;
+  }
+  spin_lock_irqsave(&frame_lock, flags);
+  if (frame_map[frame / FRAME_WORD_BITS] & bit) {
+    frame_map[frame / FRAME_WORD_BITS] &= ~bit;
+    frame_stats.free++;
+  }
+  spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ *	Function: frame_kstat
+ *	Description: append the frame counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void frame_kstat() {
+  kstat_puts("frames: total ");
+  kstat_putu(frame_stats.total);
+  kstat_puts(", free ");
+  kstat_putu(frame_stats.free);
+  kstat_puts(", min free ");
+  kstat_putu(frame_stats.min_free);
+  kstat_puts("\n");
+}
@@ -0,0 +1,45 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+/* physical frames handed out to page directories, page tables and user
+ * pages. Frames below FRAME_LOW hold the kernel image, PCBs and video
+ * memory; frames from FRAME_LIMIT up are not reachable through the
+ * kernel's direct map (the kernel half ends where user space begins). */
+#define FRAME_SIZE       0x1000
+#define FRAME_SHIFT      12
+#define FRAME_LOW        0x00800000
+#define FRAME_LIMIT      0x08000000
+#define FRAME_COUNT      (FRAME_LIMIT >> FRAME_SHIFT)
+#define FRAME_WORD_BITS  32
+#define FRAME_WORDS      (FRAME_COUNT / FRAME_WORD_BITS)
+#define FRAME_WORD_FULL  0xFFFFFFFF
+#define MMAP_AVAILABLE   1
+
+/* multiboot_info_t.flags bits, and where mem_upper starts counting */
+#define MULTIBOOT_INFO_MEMORY  0x00000001
+#define MULTIBOOT_INFO_MODS    0x00000008
+#define MULTIBOOT_INFO_MMAP    0x00000040
+#define MULTIBOOT_UPPER_START  0x00100000
+
+typedef struct {
+    uint32_t total;     // usable frames found in the memory map
+    uint32_t free;      // frames not allocated right now
+    uint32_t min_free;  // low watermark of free
+} frame_stats_t;
+
+extern frame_stats_t frame_stats;
+
+/* build the free bitmap from the multiboot memory map */
+void frame_init(multiboot_info_t* mbi);
+/* end of the highest usable frame, for the kernel's direct map */
+uint32_t frame_top();
+/* allocate/free one 4kb frame by physical address, 0 if none is left */
+uint32_t frame_alloc();
+void frame_free(uint32_t addr);
+/* append the frame counters to the kstat report */
+void frame_kstat();
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask=0xFF; /* IRQs 0-7  */
@@ -34,6 +35,11 @@ void enable_irq(uint32_t irq_num) {
   /* IRQ 0-7 is master, 8-15 is slave */
   // Check if valid
 	if ((irq_num > 15) || (irq_num < 0))return;
+  // the IO APIC has taken over the ISA interrupts
+  if (ioapic_active) {
+    ioapic_mask(irq_num, 0);
+    return;
+  }
 
   uint8_t mask = 0xFE;  /* setup mask */
 
@@ -64,6 +70,10 @@ void enable_irq(uint32_t irq_num) {
 void disable_irq(uint32_t irq_num) {
   // Check if valid
 	if ((irq_num > 15) || (irq_num < 0))return;
+  if (ioapic_active) {
+    ioapic_mask(irq_num, 1);
+    return;
+  }
 
   uint8_t mask = 0x01;  /* setup mask */
 
@@ -92,6 +102,10 @@ void disable_irq(uint32_t irq_num) {
 
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num) {
+  if (ioapic_active) {
+    lapic_eoi();
+    return;
+  }
   if ((irq_num>=0)&&(irq_num < PIC_SIZE))
     outb(EOI|irq_num, MASTER_8259_PORT);
   else if ((irq_num>=PIC_SIZE)&&(irq_num < PIC_SIZE*2)) {
@@ -9,19 +9,25 @@
 // #include "syshandler.h"
 // #include "handlers.h"
 #include "sys_call.h"
+#include "paging.h"
+#include "smp.h"
+#include "apic.h"
+#include "irq.h"
+#include "klog.h"
 
 /*
  * Exception handler
  *
- * Description: Prints the exception type and halt the program by the loop
+ * Description: Logs the exception type and halts the program
  * Inputs: exception -- the exception type
-           message -- the message printed on screen
+           message -- the message logged
  * Outputs: none
  * Side effects: halt the program
  */
 #define EXCEPTION_HANDLER(exception,message)	\
 void exception() {				  \
-	printf("%s\n", #message);	\
+	kernel_enter();				  \
+	klog(KLOG_ERR, "%s", message);	\
 	halt(255);				          \
 }
 
@@ -29,20 +35,36 @@ void exception() {				  \
 /*
  * undefined handler
  *
- * Description: Prints the message when encountered undefined interrupt
+ * Description: Logs the message when encountered undefined interrupt
  * Inputs: none
  * Outputs: none
- * Side effects: mask the interrupt flag until the message is printed
+ * Side effects: none
  */
 void undefined_handler() {
-  cli();
-	clear();
-  printf("undefined interrupt");
-  sti();
+  klog(KLOG_WARN, "undefined interrupt");
 }
 
 
 
+/*
+ * page_fault_handler
+ *
+ * Description: fills in not-present user pages on demand and treats any
+ *              other page fault like the rest of the exceptions
+ * Inputs: error -- error code pushed by the processor
+ * Outputs: none
+ * Side effects: halts the program if the fault can not be resolved
+ */
+void page_fault_handler(uint32_t error) {
+	uint32_t addr;
+	asm volatile ("movl %%cr2, %0" : "=r" (addr));
+	if (!(error & PRESENT_BIT) && demand_page(addr) == 0) {
+		return;
+	}
+	klog(KLOG_ERR, "Page Fault at 0x%x, error 0x%x", addr, error);
+	halt(255);
+}
+
 // Exceptions handler
 EXCEPTION_HANDLER(DE,"Divide Error");
 EXCEPTION_HANDLER(DB,"Debug");
@@ -51,14 +73,12 @@ EXCEPTION_HANDLER(BP,"Breakpoint");
 EXCEPTION_HANDLER(OF,"Overflow");
 EXCEPTION_HANDLER(BR,"BOUND Range Exceeded");
 EXCEPTION_HANDLER(UD,"Invalid Opcode");
-EXCEPTION_HANDLER(NM,"Device Not Available");
 EXCEPTION_HANDLER(DF,"Double Fault");
 EXCEPTION_HANDLER(CSO,"Coprocessor Segment Overrun");
 EXCEPTION_HANDLER(TS,"Invalid TSS");
 EXCEPTION_HANDLER(NP,"Segment Not Present");
 EXCEPTION_HANDLER(SS,"Stack-Segment Fault");
 EXCEPTION_HANDLER(GP,"General Protection");
-EXCEPTION_HANDLER(PF,"Page Fault");
 EXCEPTION_HANDLER(MF,"FPU Floating-Poin");
 EXCEPTION_HANDLER(AC,"Alignment Check");
 EXCEPTION_HANDLER(MC,"Machine Check");
@@ -107,21 +127,27 @@ void idt_init() {
   SET_IDT_ENTRY(idt[4], OF);
   SET_IDT_ENTRY(idt[5], BR);
   SET_IDT_ENTRY(idt[6], UD);
-  SET_IDT_ENTRY(idt[7], NM);
+  SET_IDT_ENTRY(idt[7], nm_wrapper);
   SET_IDT_ENTRY(idt[8], DF);
   SET_IDT_ENTRY(idt[9], CSO);
   SET_IDT_ENTRY(idt[10], TS);
   SET_IDT_ENTRY(idt[11], NP);
   SET_IDT_ENTRY(idt[12], SS);
   SET_IDT_ENTRY(idt[13], GP);
-  SET_IDT_ENTRY(idt[14], PF);
+  SET_IDT_ENTRY(idt[14], pf_wrapper);
   //15 is reserved by intel referenc(ISA manual table 5.11)
   SET_IDT_ENTRY(idt[16], MF);
   SET_IDT_ENTRY(idt[17], AC);
   SET_IDT_ENTRY(idt[18], MC);
   SET_IDT_ENTRY(idt[19], XF);
 
-	SET_IDT_ENTRY(idt[0x21], keyboard_wrapper);
-	SET_IDT_ENTRY(idt[0x28], rtc_wrapper);
+	// every ISA line goes through irq_common, drivers register with request_irq
+	for (i = 0; i < NR_IRQS; i++) {
+		SET_IDT_ENTRY(idt[IRQ_VEC_BASE + i], irq_stubs[i]);
+	}
     SET_IDT_ENTRY(idt[0x80], sys_wrapper);
+	SET_IDT_ENTRY(idt[LAPIC_TIMER_VEC], lapic_timer_wrapper);
+	SET_IDT_ENTRY(idt[IPI_RESCHED_VEC], resched_wrapper);
+	SET_IDT_ENTRY(idt[IPI_TLB_VEC], tlb_wrapper);
+	SET_IDT_ENTRY(idt[SPURIOUS_VEC], spurious_wrapper);
 }
@@ -1,8 +1,12 @@
 #ifndef _INTERRUPT_WRAPPER_H
 #define _INTERRUPT_WRAPPER_H
 
-extern void rtc_wrapper(void);
-extern void keyboard_wrapper(void);
 extern void sys_wrapper(void);
+extern void pf_wrapper(void);
+extern void nm_wrapper(void);
+extern void lapic_timer_wrapper(void);
+extern void resched_wrapper(void);
+extern void tlb_wrapper(void);
+extern void spurious_wrapper(void);
 
 #endif
@@ -0,0 +1,207 @@
+#include "irq.h"
+#include "lib.h"
+#include "i8259.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "kstat.h"
+
+irq_desc_t irq_descs[NR_IRQS];
+irq_stats_t irq_stats;
+
+static tasklet_t* tasklet_head;
+static tasklet_t* tasklet_tail;
+static spinlock_t tasklet_lock = SPINLOCK_INIT("tasklet");
+
+/*
+ *	Function: request_irq
+ *	Description: install the handler of an interrupt line and unmask it
+ *	input: irq -- the line, handler -- runs with interrupts off before
+ *	       the EOI, name -- for kstat, dev -- handed to the handler
+ *	output: 0 on success, -1 for a bad or taken line
+ *	side-effect: enables the line on the PIC or IOAPIC
+ */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, const int8_t* name, void* dev) {
+  irq_desc_t* desc;
+  uint32_t flags;
+
+  if (irq >= NR_IRQS || handler == NULL) {
+    return -1;
+  }
+  desc = &irq_descs[irq];
+  cli_and_save(flags);
+  if (desc->handler != NULL) {
+    restore_flags(flags);
+    return -1;
+  }
+  desc->handler = handler;
+  desc->dev = dev;
+  desc->name = name;
+  restore_flags(flags);
+  enable_irq(irq);
+  return 0;
+}
+
+/*
+ *	Function: free_irq
+ *	Description: mask an interrupt line and remove its handler
+ *	input: irq -- the line
+ *	output: None
+ *	side-effect: the counters are kept
+ */
+void free_irq(uint32_t irq) {
+  uint32_t flags;
+
+  if (irq >= NR_IRQS) {
+    return;
+  }
+  disable_irq(irq);
+  cli_and_save(flags);
+  irq_descs[irq].handler = NULL;
+  irq_descs[irq].dev = NULL;
+  restore_flags(flags);
+}
+
+/*
+ *	Function: do_irq
+ *	Description: serve one interrupt: time the handler, acknowledge the
+ *	             line, run the deferred work and preempt user mode if the
+ *	             tick asked for it
+ *	input: irq -- the line, frame -- the interrupted eip/cs/eflags
+ *	output: None
+ *	side-effect: interrupts are off on entry and on return
+ */
+void do_irq(uint32_t irq, intr_frame_t* frame) {
+  irq_desc_t* desc = &irq_descs[irq];
+  uint64_t start;
+  uint32_t cycles;
+
+  /* the interrupt gate turned interrupts off */
+  irqtrace_off(frame->eflags, IRQTRACE_SITE);
+  if (desc->handler == NULL) {
+    irq_stats.unhandled++;
+    send_eoi(irq);
+    irqtrace_restore(frame->eflags, IRQTRACE_SITE);
+    return;
+  }
+  start = rdtsc();
+  desc->handler(frame, desc->dev);
+  cycles = (uint32_t)(rdtsc() - start);
+  desc->count++;
+  desc->avg_cycles += ((int32_t)cycles - (int32_t)desc->avg_cycles) >> IRQ_AVG_SHIFT;
+  if (cycles > desc->max_cycles) {
+    desc->max_cycles = cycles;
+  }
+  send_eoi(irq);
+  softirq_run();
+  sched_preempt(frame->cs);
+  /* and iret turns them back on */
+  irqtrace_restore(frame->eflags, IRQTRACE_SITE);
+}
+
+/*
+ *	Function: tasklet_schedule
+ *	Description: queue a tasklet for the end of the current interrupt
+ *	input: t -- caller owned, not queued again while pending
+ *	output: None
+ *	side-effect: safe from interrupt handlers
+ */
+void tasklet_schedule(tasklet_t* t) {
+  uint32_t flags;
+
+  spin_lock_irqsave(&tasklet_lock, flags);
+  if (!t->pending) {
+    t->pending = 1;
+    t->next = NULL;
+    if (tasklet_tail != NULL) {
+      tasklet_tail->next = t;
+    } else {
+      tasklet_head = t;
+    }
+    tasklet_tail = t;
+  }
+  spin_unlock_irqrestore(&tasklet_lock, flags);
+}
+
+/*
+ *	Function: softirq_run
+ *	Description: run the queued tasklets in order with interrupts on. An
+ *	             interrupt arriving meanwhile only queues more, the loop
+ *	             already running picks them up.
+ *	input: None
+ *	output: None
+ *	side-effect: interrupts must be off, and are off again on return
+ */
+void softirq_run() {
+  thread_t* cur = get_cur_thread();
+  tasklet_t* t;
+  uint64_t start;
+  uint32_t cycles;
+
+  if (cur->in_softirq || tasklet_head == NULL) {
+    return;
+  }
+  cur->in_softirq = 1;
+  start = rdtsc();
+  for (;;) {
+    spin_lock(&tasklet_lock);
+    t = tasklet_head;
+    if (t == NULL) {
+      spin_unlock(&tasklet_lock);
+      break;
+    }
+    tasklet_head = t->next;
+    if (tasklet_head == NULL) {
+      tasklet_tail = NULL;
+    }
+    t->pending = 0;
+    irq_stats.tasklets++;
+    spin_unlock(&tasklet_lock);
+    sti();
+    t->fn(t->arg);
+    cli();
+  }
+  cycles = (uint32_t)(rdtsc() - start);
+  irq_stats.softirq_avg += ((int32_t)cycles - (int32_t)irq_stats.softirq_avg) >> IRQ_AVG_SHIFT;
+  if (cycles > irq_stats.softirq_max) {
+    irq_stats.softirq_max = cycles;
+  }
+  cur->in_softirq = 0;
+}
+
+/*
+ *	Function: irq_kstat
+ *	Description: append one line per registered interrupt to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void irq_kstat() {
+  uint32_t i;
+
+  for (i = 0; i < NR_IRQS; i++) {
+    irq_desc_t* desc = &irq_descs[i];
+    if (desc->handler == NULL && desc->count == 0) {
+      continue;
+    }
+    kstat_puts("irq ");
+    kstat_putu(i);
+    kstat_puts(" ");
+    kstat_puts(desc->name != NULL ? desc->name : "?");
+    kstat_puts(": count ");
+    kstat_putu(desc->count);
+    kstat_puts(", avg ");
+    kstat_putu(desc->avg_cycles);
+    kstat_puts(" cycles, max ");
+    kstat_putu(desc->max_cycles);
+    kstat_puts("\n");
+  }
+  kstat_puts("softirq: tasklets ");
+  kstat_putu(irq_stats.tasklets);
+  kstat_puts(", avg ");
+  kstat_putu(irq_stats.softirq_avg);
+  kstat_puts(" cycles, max ");
+  kstat_putu(irq_stats.softirq_max);
+  kstat_puts(", unhandled irqs ");
+  kstat_putu(irq_stats.unhandled);
+  kstat_puts("\n");
+}
@@ -0,0 +1,62 @@
+#ifndef _IRQ_H
+#define _IRQ_H
+
+#include "types.h"
+#include "pit.h"
+
+/* generic dispatch of the 16 ISA interrupt lines. Every line enters
+ * through irq_common, do_irq runs the registered handler, sends the EOI
+ * and then runs the tasklets the handler queued, with interrupts on. */
+#define NR_IRQS         16
+#define IRQ_VEC_BASE    0x20
+#define IRQ_AVG_SHIFT   3           /* averages move 1/8 toward each sample */
+
+typedef void (*irq_handler_t)(intr_frame_t* frame, void* dev);
+
+typedef struct {
+    irq_handler_t handler;
+    void* dev;                  // passed back to the handler
+    const int8_t* name;
+    uint32_t count;             // interrupts served
+    uint32_t avg_cycles;        // tsc cycles in the handler, moving average
+    uint32_t max_cycles;
+} irq_desc_t;
+
+/* deferred half of an interrupt, run once after EOI however often it is
+ * scheduled before that */
+typedef struct tasklet {
+    void (*fn)(void*);
+    void* arg;
+    struct tasklet* next;
+    uint32_t pending;           // queued and not yet started
+} tasklet_t;
+
+typedef struct {
+    uint32_t unhandled;         // interrupts on lines with no handler
+    uint32_t tasklets;          // tasklets run
+    uint32_t softirq_avg;       // tsc cycles per softirq_run, moving average
+    uint32_t softirq_max;
+} irq_stats_t;
+
+extern irq_desc_t irq_descs[NR_IRQS];
+extern irq_stats_t irq_stats;
+
+/* install the handler of a line and unmask it, -1 if the line is taken */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, const int8_t* name, void* dev);
+/* mask a line and forget its handler */
+void free_irq(uint32_t irq);
+/* called by irq_common with interrupts off */
+void do_irq(uint32_t irq, intr_frame_t* frame);
+
+/* run fn(arg) after the current interrupt's EOI, safe from handlers */
+void tasklet_schedule(tasklet_t* t);
+/* run the queued tasklets with interrupts on, does nothing when nested */
+void softirq_run();
+
+/* append the per-line counters to the kstat report */
+void irq_kstat();
+
+/* interrupt_wrapper.S, entry stub of every line */
+extern uint32_t irq_stubs[NR_IRQS];
+
+#endif
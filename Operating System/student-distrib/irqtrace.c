@@ -0,0 +1,300 @@
+#include "irqtrace.h"
+#include "lib.h"
+#include "spinlock.h"
+#include "smp.h"
+#include "kstat.h"
+
+irqtrace_stats_t irqtrace_stats;
+/* open section of each cpu, start 0 when interrupts are on */
+static uint32_t irqtrace_start[MAX_CPUS];
+static const int8_t* irqtrace_site[MAX_CPUS];
+/* taken with interrupts off only, the hooks run inside cli sections */
+static spinlock_t irqtrace_lock = SPINLOCK_INIT("irqtrace");
+
+/*
+ *	Function: irqtrace_read_flags
+ *	Description: current eflags, without going through the traced macros
+ *	input: None
+ *	output: eflags
+ *	side-effect: none
+ */
+static uint32_t irqtrace_read_flags() {
+  uint32_t flags;
+  asm volatile("pushfl; popl %0" : "=r"(flags) : : "memory");
+  return flags;
+}
+
+/*
+ *	Function: irqtrace_bucket
+ *	Description: histogram bucket of a section, by powers of two
+ *	input: cycles -- its length
+ *	output: index in hist
+ *	side-effect: none
+ */
+static uint32_t irqtrace_bucket(uint32_t cycles) {
+  uint32_t bucket = 0;
+
+  cycles >>= IRQTRACE_MIN_SHIFT + 1;
+  while (cycles != 0 && bucket < IRQTRACE_BUCKETS - 1) {
+    cycles >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/*
+ *	Function: irqtrace_record
+ *	Description: account one finished section to the histogram and its
+ *	             call site. A new site takes a free slot, or the one with
+ *	             the shortest worst case if it beats it.
+ *	input: off_site, on_site -- where it started and ended,
+ *	       cycles -- its length
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+static void irqtrace_record(const int8_t* off_site, const int8_t* on_site, uint32_t cycles) {
+  irqtrace_site_t* slot = NULL;
+  irqtrace_site_t* least = NULL;
+  uint32_t i;
+
+  spin_lock(&irqtrace_lock);
+  irqtrace_stats.sections++;
+  irqtrace_stats.hist[irqtrace_bucket(cycles)]++;
+  if (cycles > irqtrace_stats.max) {
+    irqtrace_stats.max = cycles;
+  }
+  for (i = 0; i < IRQTRACE_SITES; i++) {
+    irqtrace_site_t* site = &irqtrace_stats.sites[i];
+    if (site->off_site == off_site || site->off_site == NULL) {
+      slot = site;
+      break;
+    }
+    if (least == NULL || site->max < least->max) {
+      least = site;
+    }
+  }
+  if (slot == NULL && cycles > least->max) {
+    slot = least;
+    slot->off_site = NULL;
+  }
+  if (slot != NULL) {
+    if (slot->off_site == NULL) {
+      slot->off_site = off_site;
+      slot->on_site = on_site;
+      slot->max = 0;
+      slot->count = 0;
+    }
+    slot->count++;
+    if (cycles > slot->max) {
+      slot->max = cycles;
+      slot->on_site = on_site;
+    }
+  }
+  spin_unlock(&irqtrace_lock);
+}
+
+/*
+ *	Function: irqtrace_off
+ *	Description: interrupts were just turned off, start timing if they
+ *	             were on before
+ *	input: flags -- eflags from before the cli, site -- "file:line"
+ *	output: None
+ *	side-effect: a section left open by an iret is dropped
+ */
+void irqtrace_off(uint32_t flags, const int8_t* site) {
+  uint32_t cpu;
+
+  if (!(flags & EFLAGS_IF)) {
+    return;
+  }
+  cpu = this_cpu()->id;
+  if (irqtrace_start[cpu] != 0) {
+    irqtrace_stats.dropped++;
+  }
+  irqtrace_start[cpu] = (uint32_t)rdtsc() | 1;
+  irqtrace_site[cpu] = site;
+}
+
+/*
+ *	Function: irqtrace_on
+ *	Description: interrupts are about to go back on, end the section
+ *	input: site -- "file:line"
+ *	output: None
+ *	side-effect: if they are on already, whatever is open is stale
+ */
+void irqtrace_on(const int8_t* site) {
+  uint32_t cpu = this_cpu()->id;
+  uint32_t start = irqtrace_start[cpu];
+
+  if (start == 0) {
+    return;
+  }
+  irqtrace_start[cpu] = 0;
+  if (irqtrace_read_flags() & EFLAGS_IF) {
+    irqtrace_stats.dropped++;
+    return;
+  }
+  irqtrace_record(irqtrace_site[cpu], site, (uint32_t)rdtsc() - start);
+}
+
+/*
+ *	Function: irqtrace_restore
+ *	Description: restore_flags is about to run, it ends the section only
+ *	             if it turns interrupts back on
+ *	input: flags -- eflags being restored, site -- "file:line"
+ *	output: None
+ *	side-effect: none
+ */
+void irqtrace_restore(uint32_t flags, const int8_t* site) {
+  if (flags & EFLAGS_IF) {
+    irqtrace_on(site);
+  }
+}
+
+/*
+ *	Function: irqtrace_reset
+ *	Description: clear the histogram and the call sites
+ *	input: None
+ *	output: None
+ *	side-effect: sections open right now are still timed
+ */
+void irqtrace_reset() {
+  uint32_t flags;
+
+  cli_and_save(flags);
+  spin_lock(&irqtrace_lock);
+  memset(&irqtrace_stats, 0, sizeof(irqtrace_stats));
+  spin_unlock(&irqtrace_lock);
+  restore_flags(flags);
+}
+
+/*
+ *	Function: irqtrace_snapshot
+ *	Description: copy the counters, so printing them does not race the hooks
+ *	input: stats -- filled in
+ *	output: None
+ *	side-effect: none
+ */
+static void irqtrace_snapshot(irqtrace_stats_t* stats) {
+  uint32_t flags;
+
+  cli_and_save(flags);
+  spin_lock(&irqtrace_lock);
+  memcpy(stats, &irqtrace_stats, sizeof(irqtrace_stats_t));
+  spin_unlock(&irqtrace_lock);
+  restore_flags(flags);
+}
+
+/*
+ *	Function: irqtrace_kstat
+ *	Description: append the number of sections and the longest one to
+ *	             the kstat report, the details are in the irqtrace device
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void irqtrace_kstat() {
+  kstat_puts("irqoff: sections ");
+  kstat_putu(irqtrace_stats.sections);
+  kstat_puts(", longest ");
+  kstat_putu(irqtrace_stats.max);
+  kstat_puts(" cycles, dropped ");
+  kstat_putu(irqtrace_stats.dropped);
+  kstat_puts("\n");
+}
+
+/*
+ *	Function: irqtrace_report
+ *	Description: build the full report: histogram and the call sites
+ *	             with the longest sections, worst first
+ *	input: None
+ *	output: None
+ *	side-effect: overwrites the kstat buffer
+ */
+static void irqtrace_report() {
+  static irqtrace_stats_t stats;
+  irqtrace_site_t* worst;
+  uint32_t i, j;
+
+  irqtrace_snapshot(&stats);
+  irqtrace_kstat();
+  kstat_puts("histogram (cycles):\n");
+  for (i = 0; i < IRQTRACE_BUCKETS; i++) {
+    if (stats.hist[i] == 0) {
+      continue;
+    }
+    kstat_puts(i == IRQTRACE_BUCKETS - 1 ? "  >= " : "  < ");
+    kstat_putu(1 << (IRQTRACE_MIN_SHIFT + i + (i == IRQTRACE_BUCKETS - 1 ? 0 : 1)));
+    kstat_puts(": ");
+    kstat_putu(stats.hist[i]);
+    kstat_puts("\n");
+  }
+  kstat_puts("worst call sites:\n");
+  for (i = 0; i < IRQTRACE_WORST; i++) {
+    worst = NULL;
+    for (j = 0; j < IRQTRACE_SITES; j++) {
+      if (stats.sites[j].count != 0 && (worst == NULL || stats.sites[j].max > worst->max)) {
+        worst = &stats.sites[j];
+      }
+    }
+    if (worst == NULL) {
+      break;
+    }
+    kstat_puts("  ");
+    kstat_putu(worst->max);
+    kstat_puts(" cycles ");
+    kstat_puts(worst->off_site);
+    kstat_puts(" -> ");
+    kstat_puts(worst->on_site);
+    kstat_puts(" (");
+    kstat_putu(worst->count);
+    kstat_puts(" sections)\n");
+    worst->count = 0;
+  }
+}
+
+/*
+ *	Function: irqtrace_open
+ *	Description: open the irqtrace device
+ *	input: filename -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t irqtrace_open(const uint8_t* filename) {
+  return 0;
+}
+
+/*
+ *	Function: irqtrace_close
+ *	Description: close the irqtrace device
+ *	input: fd -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t irqtrace_close(int32_t fd) {
+  return 0;
+}
+
+/*
+ *	Function: irqtrace_read
+ *	Description: read the report like a file, reading from offset 0 takes
+ *	             a fresh snapshot
+ *	input: fd -- fd index, buf -- destination, nbytes -- size of buf
+ *	output: number of bytes read, 0 at the end of the report
+ *	side-effect: advances the file position
+ */
+int32_t irqtrace_read(int32_t fd, void* buf, int32_t nbytes) {
+  return kstat_read_report(fd, buf, nbytes, irqtrace_report);
+}
+
+/*
+ *	Function: irqtrace_write
+ *	Description: any write starts the measurement over
+ *	input: fd, buf -- unused, nbytes -- returned
+ *	output: nbytes
+ *	side-effect: clears the statistics
+ */
+int32_t irqtrace_write(int32_t fd, const void* buf, int32_t nbytes) {
+  irqtrace_reset();
+  return nbytes;
+}
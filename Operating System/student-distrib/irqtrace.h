@@ -0,0 +1,43 @@
+#ifndef _IRQTRACE_H
+#define _IRQTRACE_H
+
+#include "types.h"
+
+/* interrupt-off latency tracer. The cli/sti macros of lib.h report every
+ * change of the interrupt flag with their call site; each section that
+ * turned interrupts off on a cpu is timed from the disabling site to the
+ * enabling one. Sections ended by iret without a macro are dropped. */
+#define IRQTRACE_BUCKETS    16
+#define IRQTRACE_MIN_SHIFT  10      /* bucket 0 holds everything below 2^11 cycles */
+#define IRQTRACE_SITES      16      /* call sites remembered */
+#define IRQTRACE_WORST      8       /* call sites in the report */
+
+typedef struct {
+    const int8_t* off_site;     // where interrupts went off
+    const int8_t* on_site;      // where the longest section ended
+    uint32_t max;               // longest section, tsc cycles
+    uint32_t count;             // sections started here
+} irqtrace_site_t;
+
+typedef struct {
+    uint32_t sections;
+    uint32_t dropped;           // ended by iret, not timed
+    uint32_t max;
+    uint32_t hist[IRQTRACE_BUCKETS];
+    irqtrace_site_t sites[IRQTRACE_SITES];
+} irqtrace_stats_t;
+
+extern irqtrace_stats_t irqtrace_stats;
+
+/* forget everything recorded so far */
+void irqtrace_reset();
+/* append the worst section to the kstat report */
+void irqtrace_kstat();
+
+/* "irqtrace" device: reading gives the full report, any write resets */
+int32_t irqtrace_open(const uint8_t* filename);
+int32_t irqtrace_close(int32_t fd);
+int32_t irqtrace_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t irqtrace_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif
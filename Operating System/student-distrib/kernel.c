@@ -12,6 +12,17 @@
 #include "keyboard.h"
 #include "paging.h"
 #include "file_sys.h"
+#include "pit.h"
+#include "frame.h"
+#include "slab.h"
+#include "sys_call.h"
+#include "thread.h"
+#include "fpu.h"
+#include "smp.h"
+#include "text_cache.h"
+#include "clock.h"
+#include "serial.h"
+#include "klog.h"
 #define RUN_TESTS 0
 
 /* Macros. */
@@ -145,10 +156,13 @@ void entry(unsigned long magic, unsigned long addr) {
     i8259_init();
     // printf(1);
     rtc_init();
+    clock_init();
+    pit_init();
 
 
 
     keyboard_init();
+    serial_init();
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
     //clear();
@@ -159,7 +173,15 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("Enabling Interrupts\n");
 
     sti();
+    frame_init(mbi);
     paging_init();
+    slab_init();
+    text_cache_init();
+    sys_call_init();
+    sched_init();
+    klog_init();
+    fpu_init();
+    smp_init();
 
     // putc('\0');
     clear();
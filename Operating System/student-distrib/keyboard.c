@@ -4,12 +4,14 @@
 #include "lib.h"
 #include "i8259.h"
 
-volatile uint8_t return_flag = 0;
-// Index of the last item in the keyboard buffer
-volatile uint8_t buffer_idx = 0;
-
-// Key buffer terminated by return key
-volatile uint8_t *keyboard_buffer;
+/* scancodes from the handler to the bottom half, head is only moved by
+ * the handler and tail by the bottom half */
+static volatile uint8_t kbd_ring[KBD_RING_SIZE];
+static volatile uint32_t kbd_ring_head;
+static volatile uint32_t kbd_ring_tail;
+uint32_t kbd_dropped;
+static void keyboard_bh(void* unused);
+static tasklet_t kbd_tasklet = { keyboard_bh, NULL, NULL, 0 };
 
 /* caps and shift are not pressed*/
 char scancode_array[59][4] = {
@@ -74,8 +76,6 @@ char scancode_array[59][4] = {
     {  0 , 0 , 0 , 0   }, // 0x3A    CapsLock
 };
 
-static char* video_mem = (char *)VIDEO; // pointer to vid mem
-
 int lim_x, lim_y;                       // local vars for backspace
 uint8_t held_keys = OFF;                // local key-being-held var
 
@@ -98,30 +98,39 @@ void update_limit(int new_x, int new_y){
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Enables IRQ on PIC through enable_irq
+ *   SIDE EFFECTS: Enables IRQ on PIC through request_irq
  */
 void keyboard_init() {
   /*initialize keyboard*/
-  enable_irq(KEYBOARD_IRQ);
+  request_irq(KEYBOARD_IRQ, keyboard_handler, "keyboard", NULL);
 }
 
 /*
- * keyboard_handler()
+ * keyboard_key()
  *   DESCRIPTION: handle all key pressing cmds
- *   INPUTS: none
+ *   INPUTS: scancode -- the key, from the handler's ring
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: execute key cmd
+ *   SIDE EFFECTS: execute key cmd, runs in the bottom half with
+ *                 interrupts on. Edits the line of the terminal on
+ *                 screen and queues it on enter.
  */
-void keyboard_handler(){
-  /*critical area*/
-  cli();
+static void keyboard_key(uint8_t scancode){
   char input;
-  uint8_t scancode = inb(KEYBOARD_DATA_PORT);   //* get the input from port*/
+  uint32_t flags;
+  term_t* term = &terms[current_term_id];
 
+  /* the lock keeps other cpus off the screen */
+  spin_lock_irqsave(&term_lock, flags);
   int xcopy = get_x();        // get current coord
   int ycopy = get_y();
 
+  /* any other key brings the live screen back from the scrollback */
+  if (scancode < UNPRESS && scancode != PAGE_UP && scancode != PAGE_DOWN &&
+      scancode != LSHIFT_PRESS && scancode != RSHIFT_PRESS) {
+     vga_view_live();
+  }
+
   switch (scancode){
 
      case LSHIFT_PRESS:                        // handle L/R shift
@@ -163,17 +172,15 @@ void keyboard_handler(){
         break;
 
      case BACKSPACE:                        // handle backspace
-        if (buffer_idx > 0) {
+        if (term->edit_len > 0) {
            set_x(xcopy-1); // move writing spot one step back
-           keyboard_buffer[buffer_idx] = '\0'; // clean
-           buffer_idx--;
-           *(uint8_t *)(video_mem + ((NUM_COLS * ycopy  + xcopy-1) << 1)) = ' '; // clean char
+           term->edit_len--;
+           *(uint8_t *)(vga_screen(&term->con) + NUM_COLS * ycopy + xcopy-1) = ' '; // clean char
            update_cursor(get_x(), ycopy); // not in last row update cursor
       }
         break;
 
      case ENTER:                       // handle enter
-        return_flag = 1;
         if (ycopy == NUM_ROWS - 1){
            scroll_up();
            update_cursor(0,NUM_ROWS - 1);
@@ -186,8 +193,9 @@ void keyboard_handler(){
            update_cursor(get_x(),get_y());
            update_limit(get_x() + 1,get_y()); // update backspace limit
         }
-        keyboard_buffer[buffer_idx] = '\n';
-        buffer_idx++;
+        /* a full ring drops the line, the reader never sees half of one */
+        term_put_line(term, term->edit_buf, term->edit_len);
+        term->edit_len = 0;
         break;
 
      case ESC:                  // debugging use now
@@ -195,54 +203,111 @@ void keyboard_handler(){
         set_y(NUM_ROWS -1);
         update_cursor(get_x(),get_y());
         break;
+
+     case PAGE_UP:              // shift+pgup/pgdn move through the scrollback
+        if ((held_keys & SHIFTS_MASK) != OFF){
+           vga_view(NUM_ROWS / 2);
+        }
+        break;
+     case PAGE_DOWN:
+        if ((held_keys & SHIFTS_MASK) != OFF){
+           vga_view(-(NUM_ROWS / 2));
+        }
+        break;
   }
+  spin_unlock_irqrestore(&term_lock, flags);
 
   input = scancode_array[scancode][capital(held_keys)];   /* for cp1 lowercase*/
 
-  if (input && scancode < 60) {							//Only print if valid character
+  if (input && scancode < 60 && term->edit_len < BUFFER_LEN-1) {	//Only print if valid character and the line has room
       int xcopy = get_x();
-      terminal_write(0,&input, 1);           // write to terminal
-      keyboard_buffer[buffer_idx] = input;
-      buffer_idx++;
+      term_write(term, &input, 1);           // echo on the terminal on the screen
+      spin_lock_irqsave(&term_lock, flags);
+      term->edit_buf[term->edit_len++] = input;
       if (xcopy == NUM_COLS-1) {
     	  update_cursor(get_x(),get_y()+1);
       } else {
     	  update_cursor(get_x(),get_y());
       }
-
+      spin_unlock_irqrestore(&term_lock, flags);
    }
 
    if (scancode == LETTERL && (held_keys & CTRLS_MASK) != OFF){  // if a CTRL key is held and L is pushed, clear screen
+      spin_lock_irqsave(&term_lock, flags);
       clear();
       update_cursor(0,0);// move cursor to beginning of screen
       set_x(0);
       set_y(0);
       update_limit(-1,-1);
-
-	   int i;
-		for (i = 0; i < buffer_idx; i++) {
-			keyboard_buffer[i] = '\0';
-		}
-		buffer_idx = 0;
+      term->edit_len = 0;
+      spin_unlock_irqrestore(&term_lock, flags);
    }
    /* handle terminal switches; max number of terminal is 3 */
    if (scancode == F1_KEY && (held_keys & ALTS_MASK) != OFF){
-      send_eoi(1);
       terminal_launch(TERMINAL_ONE);
    }
    if (scancode == F2_KEY && (held_keys & ALTS_MASK) != OFF){
-      send_eoi(1);
       terminal_launch(TERMINAL_TWO);
    }
    if (scancode == F3_KEY && (held_keys & ALTS_MASK) != OFF){
-      send_eoi(1);
       terminal_launch(TERMINAL_THREE);
    }
-	// Send EOI and unmask interrupts
-	send_eoi(1);
-	sti();
 }
 
+/*
+ * keyboard_bh()
+ *   DESCRIPTION: bottom half, feed the scancodes the handler saved to
+ *                keyboard_key in order
+ *   INPUTS: unused
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch terminals, a new one gets its shell from a
+ *                 kernel thread
+ */
+static void keyboard_bh(void* unused){
+  uint8_t scancode;
+
+  while (kbd_ring_tail != kbd_ring_head) {
+    scancode = kbd_ring[kbd_ring_tail % KBD_RING_SIZE];
+    kbd_ring_tail++;
+    keyboard_key(scancode);
+  }
+}
+
+/*
+ * keyboard_inject()
+ *   DESCRIPTION: queue a scancode for the bottom half, as if the
+ *                keyboard had sent it
+ *   INPUTS: scancode -- the key
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops the key if the ring is full; interrupts must be off
+ */
+void keyboard_inject(uint8_t scancode){
+  if (kbd_ring_head - kbd_ring_tail < KBD_RING_SIZE) {
+    kbd_ring[kbd_ring_head % KBD_RING_SIZE] = scancode;
+    kbd_ring_head++;
+  } else {
+    kbd_dropped++;
+  }
+  tasklet_schedule(&kbd_tasklet);
+}
+
+/*
+ * keyboard_handler()
+ *   DESCRIPTION: top half, read the scancode and leave the rest to the
+ *                bottom half
+ *   INPUTS: frame, dev -- unused
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops the key if the ring is full
+ */
+void keyboard_handler(intr_frame_t* frame, void* dev){
+  keyboard_inject(inb(KEYBOARD_DATA_PORT));   //* get the input from port*/
+}
+
+
+
 /*
 * void update_cursor
 * Description: update cursor position
@@ -251,7 +316,7 @@ void keyboard_handler(){
 * Effects: update cursor position
 */
 void update_cursor(int x, int y){
-	uint16_t pos = NUM_COLS*y + x;
+	uint16_t pos = vga_origin(vga_shown) + NUM_COLS*y + x;
 	outw(0x000E | (pos & 0xFF00), 0x03D4);
 	outw(0x000F | ((pos << 8) & 0xFF00), 0x03D4);
 }
@@ -261,28 +326,11 @@ void update_cursor(int x, int y){
 * Description: move screen up one row to scroll down
 * Inputs: None
 * Outputs: None
-* Effects: Everything in Video Memory is shifted
+* Effects: the top row goes to the scrollback and the hardware start
+*          address moves down a row
 */
 void scroll_up(void){
-	int32_t x;
-	int32_t y;
-	int32_t old_line;
-	int32_t new_line;
-
-	// Move each row in the video memory up by 1
-	for (y = 0; y < NUM_ROWS-1; y++) {
-		for (x = 0; x < NUM_COLS; x++) {
-			old_line = NUM_COLS*(y+1) + x;
-			new_line = NUM_COLS*y + x;
-			*(uint8_t *)(video_mem + (new_line << 1)) = *(uint8_t *)(video_mem + (old_line << 1));
-		}
-	}
-
-	// Clear the bottom line
-	for (x = 0; x < NUM_COLS; x++) {
-		new_line = NUM_COLS*(NUM_ROWS-1) + x;
-		*(uint8_t *)(video_mem + (new_line << 1)) = ' ';
-	}
+	vga_scroll(vga_shown, 1);
 	set_x(0);
    update_limit(0, NUM_ROWS-2);
 }
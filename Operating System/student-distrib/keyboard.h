@@ -2,9 +2,11 @@
 #define KEYBOARD_H
 
 #include "keyboard.h"
+#include "spinlock.h"
 #include "lib.h"
 #include "i8259.h"
 #include "terminal.h"
+#include "irq.h"
 
 /*for magic numbers*/
 #define KEYBOARD_DATA_PORT 0x60
@@ -14,6 +16,7 @@
 #define BUFFER_LEN         128
 #define ENTER_ON           1
 #define ENTER_OFF          0
+#define KBD_RING_SIZE      64      /* scancodes waiting for the bottom half */
 
 /* the number of chars on a keyboard */
 #define KEY_CHAR_NUM 59
@@ -31,11 +34,14 @@
 #define TAB             0x0F
 #define SPACE           0x39
 #define ESC             0x01
+#define PAGE_UP         0x49
+#define PAGE_DOWN       0x51
 
 #define CAPSANDSHIFTS      ((CAPS_MASK | RSHIFT_MASK) | LSHIFT_MASK)
 #define LETTERL            0x26
 #define CTRLS_MASK         (LCTRL_MASK | RCTRL_MASK)
 #define ALTS_MASK          (LALT_MASK | RALT_MASK)
+#define SHIFTS_MASK        (LSHIFT_MASK | RSHIFT_MASK)
 
 // bit masks for held_keys
 #define LCTRL_MASK         0x01
@@ -52,14 +58,16 @@
 #define TERMINAL_TWO       1
 #define TERMINAL_THREE     2
 
-extern volatile uint8_t *keyboard_buffer;
-extern volatile uint8_t buffer_idx;
-extern volatile uint8_t return_flag;
+/* scancodes lost because the bottom half fell behind */
+extern uint32_t kbd_dropped;
 
 /* Initialize the keyboard */
 extern void keyboard_init();
-/* keyboard handler */
-extern void keyboard_handler();
+/* keyboard handler, the keys are handled in a tasklet */
+extern void keyboard_handler(intr_frame_t* frame, void* dev);
+/* queue a scancode as if it came from the keyboard, interrupts off */
+void keyboard_inject(uint8_t scancode);
+extern uint8_t held_keys;
 /* deal capitalizing key */
 uint8_t capital(uint8_t held_keys);
 /* helpers to deal writing process */
@@ -0,0 +1,313 @@
+#include "klog.h"
+#include "lib.h"
+#include "thread.h"
+#include "clock.h"
+#include "serial.h"
+#include "terminal.h"
+#include "sys_call.h"
+#include "kstat.h"
+
+klog_stats_t klog_stats;
+uint32_t klog_console_level = KLOG_CONSOLE_LEVEL;
+static klog_rec_t klog_ring[KLOG_RECORDS];
+/* next sequence number to hand out, and the first one kworker has not
+ * copied out yet */
+static volatile uint32_t klog_next;
+static uint32_t klog_flushed;
+static uint32_t klog_ready;
+static work_t klog_work;
+static const int8_t* klog_names[KLOG_DEBUG + 1] = {
+  "emerg", "alert", "crit", "err", "warn", "notice", "info", "debug"
+};
+
+/*
+ *	Function: klog_emit
+ *	Description: vformat output into a record, cut at KLOG_TEXT_MAX
+ *	input: c -- character, arg -- the record
+ *	output: None
+ *	side-effect: none
+ */
+static void klog_emit(uint8_t c, void* arg) {
+  klog_rec_t* rec = (klog_rec_t*)arg;
+
+  if (c == '\n') {
+    return;
+  }
+  if (rec->len < KLOG_TEXT_MAX) {
+    rec->text[rec->len++] = c;
+  } else if (rec->len == KLOG_TEXT_MAX) {
+    rec->len++;
+  }
+}
+
+/*
+ *	Function: klog
+ *	Description: append a message. The writer takes a sequence number
+ *	             with one locked add and formats into its own record,
+ *	             which it marks written last, so writers on any cpu or in
+ *	             any interrupt never wait for each other.
+ *	input: level -- KLOG_ERR..KLOG_DEBUG, format -- as for printf
+ *	output: None
+ *	side-effect: asks kworker to flush
+ */
+void klog(uint32_t level, int8_t* format, ...) {
+  int32_t* esp = (void*)&format;
+  uint32_t seq = 1;
+  klog_rec_t* rec;
+
+  asm volatile("lock xaddl %0, %1" : "+r"(seq), "+m"(klog_next) : : "memory");
+  rec = &klog_ring[seq & (KLOG_RECORDS - 1)];
+  rec->seq = 0;
+  asm volatile("" : : : "memory");
+  rec->tsc = rdtsc();
+  rec->level = level > KLOG_DEBUG ? KLOG_DEBUG : level;
+  rec->len = 0;
+  vformat(klog_emit, rec, format, esp + 1);
+  if (rec->len > KLOG_TEXT_MAX) {
+    rec->len = KLOG_TEXT_MAX;
+    klog_stats.truncated++;
+  }
+  asm volatile("" : : : "memory");
+  rec->seq = seq + 1;
+  klog_stats.logged++;
+  if (klog_ready) {
+    queue_work(&klog_work);
+  }
+}
+
+/*
+ *	Function: klog_copy
+ *	Description: take a consistent copy of a record, it may be rewritten
+ *	             by a writer that lapped the ring meanwhile
+ *	input: seq -- sequence number, rec -- destination
+ *	output: 0, -1 if the record is still being written or was overwritten
+ *	side-effect: none
+ */
+int32_t klog_copy(uint32_t seq, klog_rec_t* rec) {
+  klog_rec_t* slot = &klog_ring[seq & (KLOG_RECORDS - 1)];
+
+  if (slot->seq != seq + 1) {
+    return -1;
+  }
+  asm volatile("" : : : "memory");
+  memcpy(rec, slot, sizeof(klog_rec_t));
+  asm volatile("" : : : "memory");
+  return (slot->seq == seq + 1 && rec->seq == seq + 1) ? 0 : -1;
+}
+
+/*
+ *	Function: klog_pad
+ *	Description: append a number right aligned or zero filled
+ *	input: line -- destination, value -- number, width -- at least this
+ *	       many characters, fill -- ' ' or '0'
+ *	output: characters appended
+ *	side-effect: none
+ */
+static uint32_t klog_pad(int8_t* line, uint32_t value, uint32_t width, int8_t fill) {
+  int8_t num[12];
+  uint32_t len, n = 0;
+
+  itoa(value, num, 10);
+  len = strlen(num);
+  while (len + n < width) {
+    line[n++] = fill;
+  }
+  memcpy(line + n, num, len);
+  return n + len;
+}
+
+/*
+ *	Function: klog_format
+ *	Description: a record as a line, with its time since boot
+ *	input: rec -- the record, line -- KLOG_LINE_MAX bytes
+ *	output: length of the line
+ *	side-effect: none
+ */
+uint32_t klog_format(const klog_rec_t* rec, int8_t* line) {
+  uint64_t ns = clock_tsc_ns(rec->tsc);
+  uint32_t rem = div64_32(&ns, NS_PER_SEC);
+  const int8_t* name = klog_names[rec->level];
+  uint32_t n = 0;
+
+  line[n++] = '[';
+  n += klog_pad(line + n, (uint32_t)ns, 5, ' ');
+  line[n++] = '.';
+  n += klog_pad(line + n, rem / NS_PER_US, 6, '0');
+  line[n++] = ']';
+  line[n++] = ' ';
+  while (*name != '\0') {
+    line[n++] = *name++;
+  }
+  line[n++] = ':';
+  line[n++] = ' ';
+  memcpy(line + n, rec->text, rec->len);
+  n += rec->len;
+  line[n++] = '\n';
+  return n;
+}
+
+/*
+ *	Function: klog_flush
+ *	Description: kworker's side, copy the new records to the serial port
+ *	             and the important ones to the screen. A record still
+ *	             being written stops it; its writer queues the work again.
+ *	input: unused
+ *	output: None
+ *	side-effect: takes term_lock for the screen
+ */
+static void klog_flush(void* unused) {
+  klog_rec_t rec;
+  int8_t line[KLOG_LINE_MAX + 1];
+  uint32_t seq, len, flags;
+
+  while ((seq = klog_flushed) != klog_next) {
+    if (klog_next - seq > KLOG_RECORDS) {
+      klog_stats.lost += klog_next - KLOG_RECORDS - seq;
+      klog_flushed = klog_next - KLOG_RECORDS;
+      continue;
+    }
+    if (klog_copy(seq, &rec) == -1) {
+      if (klog_ring[seq & (KLOG_RECORDS - 1)].seq > seq + 1) {
+        /* lapped while we looked */
+        klog_stats.lost++;
+        klog_flushed++;
+        continue;
+      }
+      break;
+    }
+    len = klog_format(&rec, line);
+    serial_puts(line, len);
+    if (rec.level <= klog_console_level) {
+      line[len] = '\0';
+      spin_lock_irqsave(&term_lock, flags);
+      puts(line);
+      spin_unlock_irqrestore(&term_lock, flags);
+      klog_stats.console++;
+    }
+    klog_flushed = seq + 1;
+  }
+}
+
+/*
+ *	Function: klog_init
+ *	Description: let writers queue flushes from now on, and flush what
+ *	             was logged during boot
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void klog_init() {
+  klog_work.fn = klog_flush;
+  klog_work.arg = NULL;
+  klog_ready = 1;
+  queue_work(&klog_work);
+}
+
+/*
+ *	Function: klog_open
+ *	Description: open the klog device, reading starts at the oldest record
+ *	input: filename -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t klog_open(const uint8_t* filename) {
+  return 0;
+}
+
+/*
+ *	Function: klog_close
+ *	Description: close the klog device
+ *	input: fd -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t klog_close(int32_t fd) {
+  return 0;
+}
+
+/*
+ *	Function: klog_read
+ *	Description: read the ring as text, whole lines at a time. The file
+ *	             position is the next sequence number, so records that
+ *	             were overwritten since are skipped.
+ *	input: fd -- fd index, buf -- destination, nbytes -- size of buf
+ *	output: number of bytes read, 0 once the reader has caught up
+ *	side-effect: advances the file position
+ */
+int32_t klog_read(int32_t fd, void* buf, int32_t nbytes) {
+  file_des_t* file = &get_cur_pcb()->fda[fd];
+  uint32_t seq = file->file_position;
+  uint32_t next = klog_next;
+  klog_rec_t rec;
+  int8_t line[KLOG_LINE_MAX];
+  int32_t done = 0;
+  uint32_t len;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+  if (next - seq > KLOG_RECORDS) {
+    seq = next - KLOG_RECORDS;
+  }
+  for (; seq != next; seq++) {
+    if (klog_copy(seq, &rec) == -1) {
+      if (klog_ring[seq & (KLOG_RECORDS - 1)].seq == 0) {
+        break;
+      }
+      continue;
+    }
+    len = klog_format(&rec, line);
+    if (len > nbytes - done) {
+      if (done > 0) {
+        break;
+      }
+      /* a buffer shorter than one line gets its start */
+      len = nbytes;
+    }
+    memcpy((int8_t*)buf + done, line, len);
+    done += len;
+  }
+  file->file_position = seq;
+  return done;
+}
+
+/*
+ *	Function: klog_write
+ *	Description: a user message, logged at KLOG_INFO
+ *	input: fd -- unused, buf/nbytes -- the text
+ *	output: nbytes, -1 for a bad buffer
+ *	side-effect: none
+ */
+int32_t klog_write(int32_t fd, const void* buf, int32_t nbytes) {
+  int8_t text[KLOG_TEXT_MAX + 1];
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+  if (nbytes > KLOG_TEXT_MAX) {
+    nbytes = KLOG_TEXT_MAX;
+  }
+  memcpy(text, buf, nbytes);
+  text[nbytes] = '\0';
+  klog(KLOG_INFO, "%s", text);
+  return nbytes;
+}
+
+/*
+ *	Function: klog_kstat
+ *	Description: append the log counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void klog_kstat() {
+  kstat_puts("klog: logged ");
+  kstat_putu(klog_stats.logged);
+  kstat_puts(", lost ");
+  kstat_putu(klog_stats.lost);
+  kstat_puts(", on screen ");
+  kstat_putu(klog_stats.console);
+  kstat_puts(", truncated ");
+  kstat_putu(klog_stats.truncated);
+  kstat_puts("\n");
+}
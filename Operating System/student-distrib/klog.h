@@ -0,0 +1,55 @@
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include "types.h"
+
+/* kernel log: a ring of fixed-size records any context may append to
+ * without a lock. Writers only format into their record; kworker later
+ * copies new records to the serial port and, up to klog_console_level,
+ * to the screen. The "klog" device reads the ring back for dmesg. */
+#define KLOG_ERR            3
+#define KLOG_WARN           4
+#define KLOG_INFO           6
+#define KLOG_DEBUG          7
+#define KLOG_CONSOLE_LEVEL  KLOG_INFO
+#define KLOG_RECORDS        256       /* a power of two */
+#define KLOG_TEXT_MAX       108       /* a record is 128 bytes */
+#define KLOG_LINE_MAX       (KLOG_TEXT_MAX + 32)
+
+typedef struct {
+    volatile uint32_t seq;      // sequence number + 1 once written, 0 while being written
+    uint32_t level;
+    uint64_t tsc;               // when it was logged
+    uint32_t len;
+    int8_t text[KLOG_TEXT_MAX]; // without the newline, cut at KLOG_TEXT_MAX
+} klog_rec_t;
+
+typedef struct {
+    uint32_t logged;
+    uint32_t lost;              // overwritten before kworker copied them out
+    uint32_t console;           // records printed on the screen
+    uint32_t truncated;         // messages cut at KLOG_TEXT_MAX
+} klog_stats_t;
+
+extern klog_stats_t klog_stats;
+extern uint32_t klog_console_level;
+
+/* printf-style message at a level, safe from any context */
+void klog(uint32_t level, int8_t* format, ...);
+/* start flushing, needs kworker */
+void klog_init();
+/* one record as a line of text, "[   sec.usec] level: text\n" */
+uint32_t klog_format(const klog_rec_t* rec, int8_t* line);
+/* copy record seq out of the ring, -1 if it is not there (yet or any more) */
+int32_t klog_copy(uint32_t seq, klog_rec_t* rec);
+
+/* the "klog" device, read by dmesg */
+int32_t klog_open(const uint8_t* filename);
+int32_t klog_close(int32_t fd);
+int32_t klog_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t klog_write(int32_t fd, const void* buf, int32_t nbytes);
+
+/* append the log counters to the kstat report */
+void klog_kstat();
+
+#endif
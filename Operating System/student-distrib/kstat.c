@@ -0,0 +1,146 @@
+#include "kstat.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame.h"
+#include "slab.h"
+#include "thread.h"
+#include "fpu.h"
+#include "smp.h"
+#include "irqtrace.h"
+#include "sys_call.h"
+#include "text_cache.h"
+#include "spawn.h"
+#include "irq.h"
+#include "clock.h"
+#include "timer.h"
+#include "serial.h"
+#include "klog.h"
+
+static int8_t kstat_buf[KSTAT_BUF_SIZE];
+static uint32_t kstat_len;
+
+/*
+ *	Function: kstat_puts
+ *	Description: append a string to the report, truncating when full
+ *	input: s -- NULL terminated string
+ *	output: None
+ *	side-effect: none
+ */
+void kstat_puts(const int8_t* s) {
+  while (*s != '\0' && kstat_len < KSTAT_BUF_SIZE) {
+    kstat_buf[kstat_len++] = *s++;
+  }
+}
+
+/*
+ *	Function: kstat_putu
+ *	Description: append an unsigned decimal number to the report
+ *	input: value -- number to print
+ *	output: None
+ *	side-effect: none
+ */
+void kstat_putu(uint32_t value) {
+  int8_t num[KSTAT_NUM_BUF];
+  kstat_puts(itoa(value, num, 10));
+}
+
+/*
+ *	Function: kstat_report
+ *	Description: rebuild the report from every subsystem
+ *	input: None
+ *	output: None
+ *	side-effect: overwrites the report buffer
+ */
+static void kstat_report() {
+  clock_kstat();
+  frame_kstat();
+  paging_kstat();
+  slab_kstat();
+  sched_kstat();
+  fpu_kstat();
+  smp_kstat();
+  irq_kstat();
+  irqtrace_kstat();
+  timer_kstat();
+  serial_kstat();
+  klog_kstat();
+  text_kstat();
+  spawn_kstat();
+  exec_kstat();
+}
+
+/*
+ *	Function: kstat_open
+ *	Description: open the kstat device
+ *	input: filename -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t kstat_open(const uint8_t* filename) {
+  return 0;
+}
+
+/*
+ *	Function: kstat_close
+ *	Description: close the kstat device
+ *	input: fd -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t kstat_close(int32_t fd) {
+  return 0;
+}
+
+/*
+ *	Function: kstat_read_report
+ *	Description: read a text report like a file; reading from offset 0
+ *	             builds it afresh into the shared buffer
+ *	input: fd -- fd index, buf -- destination, nbytes -- size of buf,
+ *	       report -- appends the report with kstat_puts/kstat_putu
+ *	output: number of bytes read, 0 at the end of the report
+ *	side-effect: advances the file position
+ */
+int32_t kstat_read_report(int32_t fd, void* buf, int32_t nbytes, void (*report)()) {
+  file_des_t* file = &get_cur_pcb()->fda[fd];
+  uint32_t pos = file->file_position;
+
+  if (nbytes < 0) {
+    return -1;
+  }
+  if (pos == 0) {
+    kstat_len = 0;
+    report();
+  }
+  if (pos >= kstat_len) {
+    return 0;
+  }
+  if (nbytes > kstat_len - pos) {
+    nbytes = kstat_len - pos;
+  }
+  memcpy(buf, kstat_buf + pos, nbytes);
+  file->file_position += nbytes;
+  return nbytes;
+}
+
+/*
+ *	Function: kstat_read
+ *	Description: read the report like a file; reading from offset 0 takes
+ *	             a fresh snapshot of the counters
+ *	input: fd -- fd index, buf -- destination, nbytes -- size of buf
+ *	output: number of bytes read, 0 at the end of the report
+ *	side-effect: advances the file position
+ */
+int32_t kstat_read(int32_t fd, void* buf, int32_t nbytes) {
+  return kstat_read_report(fd, buf, nbytes, kstat_report);
+}
+
+/*
+ *	Function: kstat_write
+ *	Description: the report is read only
+ *	input: fd, buf, nbytes -- unused
+ *	output: returns -1
+ *	side-effect: none
+ */
+int32_t kstat_write(int32_t fd, const void* buf, int32_t nbytes) {
+  return -1;
+}
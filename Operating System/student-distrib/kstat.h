@@ -0,0 +1,22 @@
+#ifndef _KSTAT_H
+#define _KSTAT_H
+
+#include "types.h"
+
+#define KSTAT_BUF_SIZE 4096
+#define KSTAT_NUM_BUF  12
+
+/* helpers for the *_kstat reporters to append to the report */
+void kstat_puts(const int8_t* s);
+void kstat_putu(uint32_t value);
+/* read for a device whose text report is built by report(), which
+ * appends with kstat_puts; a read at offset 0 rebuilds it */
+int32_t kstat_read_report(int32_t fd, void* buf, int32_t nbytes, void (*report)());
+
+/* "kstat" device, a text report of kernel counters */
+int32_t kstat_open(const uint8_t* filename);
+int32_t kstat_close(int32_t fd);
+int32_t kstat_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t kstat_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif
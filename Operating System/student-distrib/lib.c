@@ -1,10 +1,10 @@
 /* lib.c - Some basic library functions (printf, strlen, etc.)
  * vim:ts=4 noexpandtab */
 #include "lib.h"
+#include "vga.h"
 
 static int x_display;
 static int y_display;
-static char* video_mem = (char *)VIDEO;
 
 /*
 * int get_x()
@@ -70,6 +70,7 @@ void newline(){
  * Return Value: none
  * Function: Clears video memory */
 void clear() {
+    char* video_mem = (char *)vga_screen(vga_shown);
     int32_t i;
     // clean video memory
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
@@ -78,6 +79,24 @@ void clear() {
     }
 }
 
+/* void format_putc(uint8_t c, void* arg);
+ * Inputs: c = character, arg = unused
+ * Return Value: none
+ * Function: printf's output, straight to the screen */
+static void format_putc(uint8_t c, void* arg) {
+    putc(c);
+}
+
+/* void format_puts(format_out_t out, void* arg, int8_t* s);
+ * Inputs: out/arg = where the characters go, s = string
+ * Return Value: none
+ * Function: emit a string through a vformat output */
+static void format_puts(format_out_t out, void* arg, int8_t* s) {
+    while (*s != '\0') {
+        out(*s++, arg);
+    }
+}
+
 /* Standard printf().
  * Only supports the following format strings:
  * %%  - print a literal '%' character
@@ -96,14 +115,22 @@ void clear() {
  *       Also note: %x is the only conversion specifier that can use
  *       the "#" modifier to alter output. */
 int32_t printf(int8_t *format, ...) {
+    /* Stack pointer for the other parameters */
+    int32_t* esp = (void *)&format;
+
+    return vformat(format_putc, NULL, format, esp + 1);
+}
+
+/* int32_t vformat(format_out_t out, void* arg, int8_t* format, int32_t* esp);
+ * Inputs: out/arg = where the characters go, format = as for printf,
+ *         esp = first argument after the format on the caller's stack
+ * Return Value: length of the format string
+ * Function: the formatting behind printf, for other destinations */
+int32_t vformat(format_out_t out, void* arg, int8_t* format, int32_t* esp) {
 
     /* Pointer to the format string */
     int8_t* buf = format;
 
-    /* Stack pointer for the other parameters */
-    int32_t* esp = (void *)&format;
-    esp++;
-
     while (*buf != '\0') {
         switch (*buf) {
             case '%':
@@ -116,7 +143,7 @@ format_char_switch:
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            out('%', arg);
                             break;
 
                         /* Use alternate formatting */
@@ -134,7 +161,7 @@ format_char_switch:
                                 int8_t conv_buf[64];
                                 if (alternate == 0) {
                                     itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
+                                    format_puts(out, arg, conv_buf);
                                 } else {
                                     int32_t starting_index;
                                     int32_t i;
@@ -144,7 +171,7 @@ format_char_switch:
                                         conv_buf[i] = '0';
                                         i++;
                                     }
-                                    puts(&conv_buf[starting_index]);
+                                    format_puts(out, arg, &conv_buf[starting_index]);
                                 }
                                 esp++;
                             }
@@ -155,7 +182,7 @@ format_char_switch:
                             {
                                 int8_t conv_buf[36];
                                 itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
+                                format_puts(out, arg, conv_buf);
                                 esp++;
                             }
                             break;
@@ -171,20 +198,20 @@ format_char_switch:
                                 } else {
                                     itoa(value, conv_buf, 10);
                                 }
-                                puts(conv_buf);
+                                format_puts(out, arg, conv_buf);
                                 esp++;
                             }
                             break;
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
+                            out((uint8_t) *((int32_t *)esp), arg);
                             esp++;
                             break;
 
                         /* Print a NULL-terminated string */
                         case 's':
-                            puts(*((int8_t **)esp));
+                            format_puts(out, arg, *((int8_t **)esp));
                             esp++;
                             break;
 
@@ -196,7 +223,7 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                out(*buf, arg);
                 break;
         }
         buf++;
@@ -225,6 +252,7 @@ void putc(uint8_t c) {
     if(c == '\n' || c == '\r') {
         newline();
     } else {
+        char* video_mem = (char *)vga_screen(vga_shown);
         *(uint8_t *)(video_mem + ((NUM_COLS * y_display + x_display) << 1)) = c;
         *(uint8_t *)(video_mem + ((NUM_COLS * y_display + x_display) << 1) + 1) = ATTRIB;
         set_display_coord(x_display+1,y_display);
@@ -521,6 +549,7 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
  * Return Value: void
  * Function: increments video memory. To be used to test rtc */
 void test_interrupts() {
+    char* video_mem = (char *)vga_screen(vga_shown);
     int32_t i;
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
         video_mem[i << 1]++;
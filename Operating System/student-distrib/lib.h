@@ -14,6 +14,9 @@
 #define ATTRIB      0x7
 
 int32_t printf(int8_t *format, ...);
+/* printf's formatting, each character goes to out(c, arg) */
+typedef void (*format_out_t)(uint8_t c, void* arg);
+int32_t vformat(format_out_t out, void* arg, int8_t* format, int32_t* esp);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -42,6 +45,13 @@ int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
+/* Reads the time-stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc" : "=A"(val));
+    return val;
+}
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -116,14 +126,42 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Interrupt-off latency tracer (irqtrace.c). Every macro below that
+ * changes the interrupt flag reports it with its call site; comment
+ * IRQTRACE out to compile the hooks away. */
+#define IRQTRACE
+
+#define IRQTRACE_STR2(x)    #x
+#define IRQTRACE_STR(x)     IRQTRACE_STR2(x)
+#define IRQTRACE_SITE       (__FILE__ ":" IRQTRACE_STR(__LINE__))
+
+#ifdef IRQTRACE
+/* flags -- eflags from before the cli */
+void irqtrace_off(uint32_t flags, const int8_t* site);
+/* called just before interrupts go back on */
+void irqtrace_on(const int8_t* site);
+/* flags -- eflags about to be restored */
+void irqtrace_restore(uint32_t flags, const int8_t* site);
+#else
+#define irqtrace_off(flags, site)       do { } while (0)
+#define irqtrace_on(site)               do { } while (0)
+#define irqtrace_restore(flags, site)   do { } while (0)
+#endif
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
-    asm volatile ("cli"                 \
-            :                           \
+    uint32_t cli_flags_;                \
+    asm volatile ("                   \n\
+            pushfl                    \n\
+            popl %0                   \n\
+            cli                       \n\
+            "                           \
+            : "=r"(cli_flags_)          \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    irqtrace_off(cli_flags_, IRQTRACE_SITE); \
 } while (0)
 
 /* Save flags and then clear interrupt flag
@@ -140,11 +178,13 @@ do {                                    \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    irqtrace_off(flags, IRQTRACE_SITE); \
 } while (0)
 
 /* Set interrupt flag - enable interrupts on this processor */
 #define sti()                           \
 do {                                    \
+    irqtrace_on(IRQTRACE_SITE);         \
     asm volatile ("sti"                 \
             :                           \
             :                           \
@@ -157,6 +197,7 @@ do {                                    \
  * after a cli_and_save_flags(flags) */
 #define restore_flags(flags)            \
 do {                                    \
+    irqtrace_restore(flags, IRQTRACE_SITE); \
     asm volatile ("                   \n\
             pushl %0                  \n\
             popfl                     \n\
@@ -1,4 +1,10 @@
 #include "paging.h"
+#include "kstat.h"
+#include "smp.h"
+#include "text_cache.h"
+#include "vga.h"
+
+tlb_stats_t tlb_stats;
 
 /*
  * 	paging_init
@@ -17,7 +23,7 @@ void paging_init() {
 
 	/* set up memory from (4-8MB) as one 4MB page*/
     page_directory[1]  = KERNEL_MEM;
-    page_directory[1] |= RW_P_SIZE_SET;
+    page_directory[1] |= RW_P_SIZE_SET | PAGE_GLOBAL;
 
 	/* split memory from (0-4MB) into 4kb pages */
     page_directory[0]  = (uint32_t) page_table;
@@ -28,97 +34,244 @@ void paging_init() {
         page_table[i] = RW_SET_ONLY; /* Only R/W is set */
     }
 
-	/* assign video memory a page */
+	/* assign video memory the pages of the whole text window, the
+	 * screen scrolls through it */
     /* Shifting 12 to get the most significant bits */
-    page_table[VIDEO >> TABLE_IDX_SHIFT]  = VIDEO;
-    page_table[VIDEO >> TABLE_IDX_SHIFT] |= RW_P_SET;
-
-    // map_virt_to_phys(VIRT_VID_TERM1, BACKUP_VID1);
-    // map_virt_to_phys(VIRT_VID_TERM2, BACKUP_VID2);
-    // map_virt_to_phys(VIRT_VID_TERM3, BACKUP_VID3);
+    for (i = VIDEO >> TABLE_IDX_SHIFT; i < (VIDEO + VGA_WINDOW) >> TABLE_IDX_SHIFT; i++) {
+        page_table[i]  = i << TABLE_IDX_SHIFT;
+        page_table[i] |= RW_P_SET | PAGE_GLOBAL;
+    }
 
+	/* direct map the frames from frame.c so the kernel can fill them */
+    for (i = FRAME_LOW >> DIR_IDX_SHIFT; (i << DIR_IDX_SHIFT) < frame_top(); i++) {
+        page_directory[i]  = i << DIR_IDX_SHIFT;
+        page_directory[i] |= RW_P_SIZE_SET | PAGE_GLOBAL;
+    }
 
+    this_cpu()->page_dir = page_directory;
     enablePaging();
 }
 
+/*
+ * page_alloc
+ *   DESCRIPTION: allocate a frame and clear it through the direct map
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: zeroed 4kb page, NULL if memory is exhausted
+ *   SIDE EFFECTS: none
+ */
+void* page_alloc() {
+    void* page = (void*)frame_alloc();
+    if (page == NULL) {
+        return NULL;
+    }
+    memset(page, 0, PAGE_BYTES);
+    return page;
+}
 
+/*
+ * page_free
+ *   DESCRIPTION: give a page back to the frame allocator
+ *   INPUTS: page - page returned by page_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void page_free(void* page) {
+    if (page == NULL) {
+        return;
+    }
+    frame_free((uint32_t)page);
+}
 
 /*
- * 	repage
- *   description: repage a virtual address to physics address
- *   input: virtual_addr -- virtual Address
-             physical_addr -- physical address
- *   outputs: none
- *   side effect: none
+ * page_dir_create
+ *   DESCRIPTION: allocate a page directory for a new process. The kernel
+ *      half points at the same page tables and 4MB pages as page_directory,
+ *      the user half starts empty.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: new page directory, NULL if out of pages
+ *   SIDE EFFECTS: none
+ */
+uint32_t* page_dir_create() {
+    uint32_t* pd = (uint32_t*)page_alloc();
+    int i;
+    if (pd == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < PAGE_SIZE; i++) {
+        pd[i] = (i < USER_PDE_START) ? page_directory[i] : RW_SET_ONLY;
+    }
+    return pd;
+}
+
+/*
+ * page_dir_destroy
+ *   DESCRIPTION: free a process page directory, the page tables of its
+ *      user half and every frame the process owns. Must not be the loaded
+ *      directory.
+ *   INPUTS: pd - directory from page_dir_create
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void page_dir_destroy(uint32_t* pd) {
+    int i, j;
+    uint32_t* table;
+    if (pd == NULL || pd == page_directory) {
+        return;
+    }
+    /* a kernel thread on another cpu may still be borrowing it */
+    smp_flush_tlb(pd);
+    for (i = USER_PDE_START; i < PAGE_SIZE; i++) {
+        if ((pd[i] & PRESENT_BIT) && !(pd[i] & SIZE_BIT)) {
+            table = (uint32_t*)(pd[i] & ADDR_MASK);
+            for (j = 0; j < PAGE_SIZE; j++) {
+                if ((table[j] & PRESENT_BIT) && (table[j] & PAGE_OWNED)) {
+                    page_free((void*)(table[j] & ADDR_MASK));
+                } else if ((table[j] & PRESENT_BIT) && (table[j] & PAGE_SHARED)) {
+                    text_page_put(table[j] & ADDR_MASK);
+                }
+            }
+            page_free(table);
+        }
+    }
+    page_free(pd);
+}
+
+/*
+ * get_cur_page_dir
+ *   DESCRIPTION: page directory loaded on the calling cpu
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the directory in cr3
+ *   SIDE EFFECTS: none
+ */
+uint32_t* get_cur_page_dir() {
+    return this_cpu()->page_dir;
+}
+
+/*
+ * load_page_directory
+ *   DESCRIPTION: switch address space
+ *   INPUTS: pd - page directory to load into cr3
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: non-global TLB entries are dropped, the kernel half
+ *      is global and stays cached
  */
-void repage(uint32_t virtual_addr, uint32_t physical_addr) {
-    uint32_t pde = virtual_addr / 0x400000;
-    page_directory[pde] = physical_addr | 0x87; 			//set to user user, present, r/w, size
-    flush_tlb();
+void load_page_directory(uint32_t* pd) {
+    this_cpu()->page_dir = pd;
+    tlb_stats.cr3_loads++;
+    asm volatile(
+        "movl %0, %%cr3"
+        : /* No outputs */
+        : "r" (pd)
+        : "memory"
+    );
 }
 
 /*
  * 	set_up_map
- *   description: set up mapping from virtual address to physical address
+ *   description: map a 4kb user page in the current page directory
  *   input: virtualAddr -- virtual Address
              physicalAddr -- physical address
- *   outputs: none
+ *   outputs: 0 if success, -1 if no page table could be allocated
  *   side effect: none
  */
-void set_up_map(uint32_t virtualAddr, uint32_t physicalAddr)
+int32_t set_up_map(uint32_t virtualAddr, uint32_t physicalAddr)
 {
-    uint32_t pde = virtualAddr / 0x400000;
-    page_directory[pde] = ((unsigned int)user_page_table) | 7;
-    user_page_table[0] = physicalAddr | 7;
-    flush_tlb();
+    return map_virt_to_phys(get_cur_page_dir(), virtualAddr, physicalAddr, USER_MASK);
 }
 
 /*
- *  PageTableToPage
- *  description: map virtual address to physics address with given page
- *  inputs:  virtualAddr -- virtual address
- *           physicalAddr - physical address in stack
- *           page - the page in the page table
+ * 	unmap_user_page
+ *   description: remove a 4kb user page from the current page directory,
+ *                freeing its frame if the process owns it
+ *   input: virtual_address -- virtual address inside the page
  *   outputs: none
  *   side effect: none
  */
-void PageTableToPage(uint32_t virtualAddr, uint32_t physicalAddr, uint32_t page)
+void unmap_user_page(uint32_t virtual_address)
 {
-    uint32_t pde = virtualAddr / 0x400000;
-    page_directory[pde] = ((unsigned int)user_page_table) | 7;
-    user_page_table[page] = physicalAddr | 7;
-    flush_tlb();
+    uint32_t pde = get_cur_page_dir()[virtual_address >> DIR_IDX_SHIFT];
+    uint32_t* pte;
+
+    if (!(pde & PRESENT_BIT) || (pde & SIZE_BIT)) {
+        return;
+    }
+    pte = (uint32_t*)(pde & ADDR_MASK) + ((virtual_address & CLEAR_DIR_IDX) >> TABLE_IDX_SHIFT);
+    if ((*pte & PRESENT_BIT) && (*pte & PAGE_OWNED)) {
+        page_free((void*)(*pte & ADDR_MASK));
+    } else if ((*pte & PRESENT_BIT) && (*pte & PAGE_SHARED)) {
+        text_page_put(*pte & ADDR_MASK);
+    }
+    *pte = RW_SET_ONLY;
+    flush_tlb_page(virtual_address);
+    /* clone threads of the process may be running on other cpus */
+    smp_flush_tlb(NULL);
 }
 
 /*
- * add_process
- *   DESCRIPTION: set up paging for a new process
- *   OUTPUTS: none
- *   INPUTS: process_id - identification for new process
- *   RETURN VALUE: None
- *   SIDE EFFECTS: set up a new paging
+ *  PageTableToPage
+ *  description: map a kernel 4kb page, shared by every page directory
+ *  inputs:  virtualAddr -- virtual address of the page table
+ *           physicalAddr - physical address of the page
+ *           page - the page in the page table
+ *   outputs: 0 if success, -1 if no page table could be allocated
+ *   side effect: only reaches directories created after the page table
+ *                for virtualAddr exists, so map kernel pages before the
+ *                first execute
  */
-void add_process(uint32_t process_id) {
-    page_directory[PROCESS_IDX] = (USER_SPACE + process_id * PROCESS_SIZE_) | PROCESS_SET;
-    flush_tlb();
+int32_t PageTableToPage(uint32_t virtualAddr, uint32_t physicalAddr, uint32_t page)
+{
+    uint32_t virt = (virtualAddr & ~CLEAR_DIR_IDX) | (page << TABLE_IDX_SHIFT);
+    return map_virt_to_phys(page_directory, virt, physicalAddr, RW_P_SET | PAGE_GLOBAL);
 }
 
 /*
  * map_virt_to_phys
  *   DESCRIPTION: Shift virtual address to index page directory and page table. Map respective
- *      ones to the given physical address
+ *      ones to the given physical address, allocating the page table if needed.
+ *      A 4MB page in the way is split into a table that keeps its mappings.
  *   OUTPUTS: none
- *   INPUTS: virtual_address - address which user will use to change video memory
- *           MAP - the physical memory address that we want to map to
- *   RETURN VALUE: None
- *   SIDE EFFECTS:
+ *   INPUTS: pd - page directory to change
+ *           virtual_address - virtual address of the 4kb page
+ *           PHYS - the physical memory address that we want to map to
+ *           flags - USER_MASK for user pages, RW_P_SET | PAGE_GLOBAL for kernel pages
+ *   RETURN VALUE: 0 if success, -1 if no page table could be allocated
+ *   SIDE EFFECTS: none
  */
-void map_virt_to_phys(uint32_t virtual_address, uint32_t PHYS)
+int32_t map_virt_to_phys(uint32_t* pd, uint32_t virtual_address, uint32_t PHYS, uint32_t flags)
 {
-    // give a user a table
-    page_directory[virtual_address>>DIR_IDX_SHIFT] = (uint32_t) user_page_table | USER_MASK; // shift to find index into page directory
-    user_page_table[(virtual_address & CLEAR_DIR_IDX)>>TABLE_IDX_SHIFT] = PHYS | RW_P_SET; // map the page table
-    flush_tlb();
+    uint32_t pde = virtual_address >> DIR_IDX_SHIFT; // shift to find index into page directory
+    uint32_t* table;
+    uint32_t i, stale;
+
+    if (!(pd[pde] & PRESENT_BIT) || (pd[pde] & SIZE_BIT)) {
+        table = (uint32_t*)page_alloc();
+        if (table == NULL) {
+            return -1;
+        }
+        /* same translations as the 4MB page, so no flush is needed */
+        if (pd[pde] & PRESENT_BIT) {
+            for (i = 0; i < PAGE_SIZE; i++) {
+                table[i] = ((pd[pde] & LARGE_PAGE_MASK) + (i << TABLE_IDX_SHIFT)) | (pd[pde] & PAGE_FLAGS);
+            }
+        }
+        /* read-only pages get their own PTE bit, the table stays writable */
+        pd[pde] = (uint32_t)table | ((flags | RW_SET_ONLY) & ~(PAGE_GLOBAL | PAGE_OWNED | PAGE_SHARED));
+    }
+    table = (uint32_t*)(pd[pde] & ADDR_MASK);
+    i = (virtual_address & CLEAR_DIR_IDX) >> TABLE_IDX_SHIFT;
+    stale = table[i] & PRESENT_BIT;
+    table[i] = PHYS | flags; // map the page table
+    flush_tlb_page(virtual_address);
+    if (stale) {
+        smp_flush_tlb(NULL);
+    }
+    return 0;
 }
 
 /*
@@ -159,9 +312,49 @@ void enablePaging() {
     :	/* No inputs */
     : "%eax" /* clobbers eax */
     );
+
+    /* Sets PGE flag so the kernel's global pages outlive cr3 reloads */
+    asm volatile(
+        "movl %%cr4, %%eax;"
+        "orl  %0, %%eax;"
+        "movl %%eax, %%cr4;"
+    :	/* No outputs */
+    :	"i" (CR4_PGE)
+    :   "%eax" /* clobbers eax */
+    );
 }
 
+/*
+ * paging_kstat
+ *   DESCRIPTION: append the TLB counters to the kstat report
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void paging_kstat() {
+    kstat_puts("tlb: full flushes ");
+    kstat_putu(tlb_stats.full_flushes);
+    kstat_puts(", page flushes ");
+    kstat_putu(tlb_stats.page_flushes);
+    kstat_puts(", cr3 loads ");
+    kstat_putu(tlb_stats.cr3_loads);
+    kstat_puts(", shootdowns ");
+    kstat_putu(tlb_stats.shootdowns);
+    kstat_puts("\n");
+}
+
+/*
+ * flush_tlb
+ *   DESCRIPTION: reload cr3 to drop every non-global translation. Only for
+ *      changes too wide for flush_tlb_page.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: counted in tlb_stats.full_flushes
+ */
 void flush_tlb() {
+	tlb_stats.full_flushes++;
 	asm volatile(
      "mov %%cr3, %%eax;"
      "mov %%eax, %%cr3;"
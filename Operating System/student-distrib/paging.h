@@ -2,6 +2,7 @@
 #define _PAGING_H
 
 #include "lib.h"
+#include "frame.h"
 #define VIDEO 0xB8000
 
 #define PAGE_SIZE 1024
@@ -25,8 +26,16 @@
 #define RW_SET_ONLY   0x00000002  // Set bit 1, enables r/w
 #define RW_P_SET      (RW_SET_ONLY | 0x00000001) // Set bit 0, enables present bit
 #define RW_P_SIZE_SET (RW_P_SET    | 0x00000080) // Set bit 7, enables larger page size
+#define PAGE_GLOBAL   0x00000100  // Set bit 8, translation survives cr3 reloads (needs CR4.PGE)
+#define PAGE_OWNED    0x00000200  // Available bit 9, frame belongs to the process and is freed with it
+#define PAGE_SHARED   0x00000400  // Available bit 10, frame comes from the text cache, dropped with text_page_put
+#define PAGE_NOCACHE  0x00000018  // PWT | PCD, for device registers
+#define PAGE_FLAGS    0x0000017F  // PTE flags a split 4MB page hands down to its 4kb pages
+#define CR4_PSE       0x00000010
+#define CR4_PGE       0x00000080
 #define PROCESS_SET   0x00000087 // Set size, user, r/w, present
 #define USER_MASK     0x7		//set 4kb size, user, r/w, present
+#define USER_RO_MASK  0x5		//set 4kb size, user, present, read only
 #define USER_VIDEO_ 	 (VIDEO | USER_MASK) //set user video memory page (4kb)
 // set user video mem for back up 1, 2, and 3
 #define USER_BACK1	 (BACKUP_VID1 | USER_MASK)
@@ -37,29 +46,77 @@
 #define PROCESS_SIZE_ 0x00400000
 #define PROCESS_IDX   32
 
-/* page directory */
+/* page directories, page tables and user pages are frames from frame.c,
+ * reached through the kernel's direct map (virtual == physical) */
+#define PAGE_BYTES       FRAME_SIZE
+#define LARGE_PAGE_MASK  0xFFC00000
+
+/* PDEs from 128MB up belong to the process, everything below is kernel
+ * and shared by every page directory */
+#define USER_PDE_START   32
+#define PRESENT_BIT      0x00000001
+#define SIZE_BIT         0x00000080
+#define ADDR_MASK        0xFFFFF000
+
+/* kernel page directory, also the template for every process directory */
 uint32_t page_directory[PAGE_SIZE] __attribute__((aligned(PAGE_ALIGN)));
 
-/* page table for video memory */
+/* page table for 0-4MB (video memory) */
 uint32_t page_table[PAGE_SIZE] __attribute__((aligned(PAGE_ALIGN)));
-uint32_t user_page_table[PAGE_SIZE] __attribute__((aligned(PAGE_ALIGN)));
-uint8_t vidMemPageTable[PAGE_SIZE] __attribute__((aligned(PAGE_ALIGN)));
+
+
 /* initializes paging */
 void paging_init();
 
 /* helper function to enable paging (in-line-assembly) */
 void enablePaging();
 
-/* allocate page for a new process */
-void add_process(uint32_t process_id);
+/* allocate/free one zeroed 4kb frame, usable at its physical address */
+void* page_alloc();
+void page_free(void* page);
+
+/* create/destroy a page directory for a process, kernel half shared */
+uint32_t* page_dir_create();
+void page_dir_destroy(uint32_t* pd);
+void load_page_directory(uint32_t* pd);
+/* page directory loaded on the calling cpu */
+uint32_t* get_cur_page_dir();
+
+/* map/unmap pages in the current page directory */
+int32_t set_up_map(uint32_t virtualAddr, uint32_t physicalAddr);
+void unmap_user_page(uint32_t virtual_address);
 
-/* allocate video memory page for user */
-void map_virt_to_phys(uint32_t virtual_address, uint32_t PHYS);
-void repage(uint32_t virtual_addr, uint32_t physical_addr);
-extern void PageTableToPage(uint32_t virtualAddr, uint32_t physicalAddr, uint32_t page);
+/* map kernel pages, visible from every page directory */
+int32_t PageTableToPage(uint32_t virtualAddr, uint32_t physicalAddr, uint32_t page);
 
-/* clear the TLB */
-void set_up_map(uint32_t virtualAddr, uint32_t physicalAddr);
+/* map a 4kb page in a given page directory */
+int32_t map_virt_to_phys(uint32_t* pd, uint32_t virtual_address, uint32_t PHYS, uint32_t flags);
+
+/* TLB maintenance counters, see paging.c */
+typedef struct {
+    uint32_t full_flushes;      // flush_tlb calls (cr3 reload)
+    uint32_t page_flushes;      // flush_tlb_page calls (invlpg)
+    uint32_t cr3_loads;         // address space switches
+    uint32_t shootdowns;        // smp_flush_tlb rounds sent to other cpus
+} tlb_stats_t;
+
+extern tlb_stats_t tlb_stats;
+
+/* append the TLB counters to the kstat report */
+void paging_kstat();
+
+/* clear the TLB, global (kernel) translations are kept */
 void flush_tlb();
 
+/* drop the TLB entry for the page holding virtual_addr */
+static inline void flush_tlb_page(uint32_t virtual_addr) {
+    tlb_stats.page_flushes++;
+    asm volatile(
+        "invlpg (%0)"
+        : /* No outputs */
+        : "r" (virtual_addr)
+        : "memory"
+    );
+}
+
 #endif
@@ -0,0 +1,42 @@
+#include "pit.h"
+#include "lib.h"
+#include "i8259.h"
+#include "profile.h"
+#include "thread.h"
+#include "irq.h"
+#include "timer.h"
+
+volatile uint32_t pit_ticks = 0;
+
+/*
+ *	Function: pit_init
+ *	Description: program channel 0 of the PIT to fire at PIT_HZ
+ *	input: None
+ *	output: None
+ *	side-effect: enables IRQ0 on the PIC
+ */
+void pit_init() {
+  uint32_t divisor = PIT_BASE_FREQ / PIT_HZ;
+
+  outb(PIT_MODE3, PIT_CMD_PORT);
+  outb(divisor & PIT_LOW_MASK, PIT_CHANNEL0);                      /* low byte first */
+  outb((divisor >> PIT_HIGH_SHIFT) & PIT_LOW_MASK, PIT_CHANNEL0);  /* then high byte */
+  request_irq(PIT_IRQ, pit_handler, "timer", NULL);
+}
+
+/*
+ *	Function: pit_handler
+ *	Description: count the tick, hand the interrupted context to the profiler
+ *	             and turn the timer wheel
+ *	input: frame -- the eip/cs/eflags the CPU pushed for this interrupt,
+ *	       dev -- unused
+ *	output: None
+ *	side-effect: may record a profiling sample, ask for preemption and
+ *	             queue the timer tasklet
+ */
+void pit_handler(intr_frame_t* frame, void* dev) {
+  pit_ticks++;
+  prof_tick(frame);
+  sched_tick(frame->cs);
+  timer_tick();
+}
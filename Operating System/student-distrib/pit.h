@@ -0,0 +1,31 @@
+#ifndef _PIT_H
+#define _PIT_H
+
+#include "types.h"
+
+/* magic numbers, ports and command words for the 8253/8254 PIT */
+#define PIT_IRQ          0
+#define PIT_CHANNEL0     0x40
+#define PIT_CMD_PORT     0x43
+#define PIT_MODE3        0x36      /* channel 0, lobyte/hibyte, square wave */
+#define PIT_BASE_FREQ    1193182   /* input clock of the PIT in Hz */
+#define PIT_HZ           1000      /* timer interrupt rate */
+#define PIT_LOW_MASK     0xFF
+#define PIT_HIGH_SHIFT   8
+
+/* hardware frame pushed by the CPU on an interrupt (lowest address first) */
+typedef struct {
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+} intr_frame_t;
+
+/* number of timer interrupts since pit_init */
+extern volatile uint32_t pit_ticks;
+
+/* initialize the PIT and enable IRQ0 */
+void pit_init(void);
+/* timer interrupt handler */
+void pit_handler(intr_frame_t* frame, void* dev);
+
+#endif
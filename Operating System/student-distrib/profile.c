@@ -0,0 +1,166 @@
+#include "profile.h"
+#include "lib.h"
+#include "sys_call.h"
+
+prof_ring_t prof_rings[PROF_NUM_CPU];
+
+static volatile uint32_t prof_enabled = 0;
+static uint32_t prof_interval = 1;     /* timer ticks between samples */
+
+/*
+ *	Function: prof_cpu
+ *	Description: index of the ring owned by the running cpu
+ *	input: None
+ *	output: ring index
+ *	side-effect: none
+ */
+static inline uint32_t prof_cpu() {
+  return this_cpu()->id;
+}
+
+/*
+ *	Function: prof_push
+ *	Description: append one record to the ring of the running cpu, dropping
+ *	             it if the consumer has fallen a whole ring behind
+ *	input: eip, cs, pid, type -- the record fields
+ *	output: None
+ *	side-effect: must run with interrupts off so the cpu has one producer
+ */
+static void prof_push(uint32_t eip, uint16_t cs, uint8_t pid, uint8_t type) {
+  prof_ring_t* ring = &prof_rings[prof_cpu()];
+  uint32_t head = ring->head;
+  prof_sample_t* s;
+
+  if (head - ring->tail >= PROF_RING_SIZE) {
+    ring->dropped++;
+    return;
+  }
+  s = &ring->samples[head & PROF_RING_MASK];
+  s->eip = eip;
+  s->cs = cs;
+  s->pid = pid;
+  s->type = type;
+  /* publish the record before the new head */
+  asm volatile("" : : : "memory");
+  ring->head = head + 1;
+}
+
+/*
+ *	Function: prof_cur_pid
+ *	Description: pid owning the kernel stack we were interrupted on
+ *	input: None
+ *	output: pid, or PROF_NO_PID if that pcb is not in use
+ *	side-effect: none
+ */
+static uint8_t prof_cur_pid() {
+  pcb_t* pcb = get_cur_pcb();
+  if (pcb == NULL || pcb->process_num > MAX_PID || pid_array[pcb->process_num] == 0) {
+    return PROF_NO_PID;
+  }
+  return pcb->process_num;
+}
+
+/*
+ *	Function: prof_tick
+ *	Description: record the interrupted eip/cs/pid every prof_interval ticks
+ *	input: frame -- hardware frame of the timer interrupt
+ *	output: None
+ *	side-effect: appends to the ring of this cpu
+ */
+void prof_tick(intr_frame_t* frame) {
+  prof_ring_t* ring;
+
+  if (!prof_enabled) {
+    return;
+  }
+  ring = &prof_rings[prof_cpu()];
+  if (--ring->countdown != 0) {
+    return;
+  }
+  ring->countdown = prof_interval;
+  prof_push(frame->eip, (uint16_t)frame->cs, prof_cur_pid(), PROF_SAMPLE);
+}
+
+/*
+ *	Function: prof_note_exec
+ *	Description: tell the symbolizer which executable a pid is running
+ *	input: pid -- the new process, inode -- inode of its executable
+ *	output: None
+ *	side-effect: appends a PROF_COMM record while profiling
+ */
+void prof_note_exec(uint8_t pid, uint32_t inode) {
+  uint32_t flags;
+  if (!prof_enabled) {
+    return;
+  }
+  cli_and_save(flags);
+  prof_push(inode, 0, pid, PROF_COMM);
+  restore_flags(flags);
+}
+
+/*
+ *	Function: prof_start
+ *	Description: system call, start sampling at hz samples per second
+ *	input: hz -- sample rate, 1 to PIT_HZ
+ *	output: 0 on success, -1 on bad rate
+ *	side-effect: records which program every live pid is running
+ */
+int32_t prof_start(int32_t hz) {
+  uint32_t i;
+  if (hz <= 0 || hz > PIT_HZ) {
+    return -1;
+  }
+  prof_interval = PIT_HZ / hz;
+  for (i = 0; i < PROF_NUM_CPU; i++) {
+    prof_rings[i].countdown = prof_interval;
+  }
+  prof_enabled = 1;
+  for (i = 0; i <= MAX_PID; i++) {
+    if (pid_array[i]) {
+      prof_note_exec(i, get_cur_pcb_process(i)->exe_inode);
+    }
+  }
+  return 0;
+}
+
+/*
+ *	Function: prof_stop
+ *	Description: system call, stop sampling; recorded samples stay readable
+ *	input: None
+ *	output: 0
+ *	side-effect: none
+ */
+int32_t prof_stop() {
+  prof_enabled = 0;
+  return 0;
+}
+
+/*
+ *	Function: prof_read
+ *	Description: system call, drain recorded samples from every cpu ring
+ *	input: buf -- array of prof_sample_t, nbytes -- size of buf
+ *	output: number of bytes copied, -1 on bad buffer
+ *	side-effect: consumed samples are removed from the rings
+ */
+int32_t prof_read(void* buf, int32_t nbytes) {
+  prof_sample_t* out = (prof_sample_t*)buf;
+  int32_t max, n = 0;
+  uint32_t cpu;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+  max = nbytes / sizeof(prof_sample_t);
+  for (cpu = 0; cpu < PROF_NUM_CPU; cpu++) {
+    prof_ring_t* ring = &prof_rings[cpu];
+    uint32_t tail = ring->tail;
+    while (n < max && tail != ring->head) {
+      out[n++] = ring->samples[tail & PROF_RING_MASK];
+      tail++;
+    }
+    /* hand the slots back to the producer only after the copy */
+    asm volatile("" : : : "memory");
+    ring->tail = tail;
+  }
+  return n * sizeof(prof_sample_t);
+}
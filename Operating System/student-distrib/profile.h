@@ -0,0 +1,49 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "types.h"
+#include "pit.h"
+#include "smp.h"
+
+#define PROF_NUM_CPU     MAX_CPUS
+#define PROF_RING_SIZE   4096          /* samples per cpu, must be a power of 2 */
+#define PROF_RING_MASK   (PROF_RING_SIZE - 1)
+#define PROF_NO_PID      0xFF          /* sample taken with no process running */
+
+/* record types */
+#define PROF_SAMPLE      0             /* eip/cs of the interrupted context */
+#define PROF_COMM        1             /* pid was loaded from inode "eip" */
+
+/* one profiling record, copied out to user space as-is by prof_read */
+typedef struct {
+    uint32_t eip;
+    uint16_t cs;
+    uint8_t pid;
+    uint8_t type;
+} prof_sample_t;
+
+/* single-producer/single-consumer ring: the timer interrupt on the owning
+ * cpu only moves head, prof_read only moves tail */
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    uint32_t countdown;         // timer ticks of this cpu until its next sample
+    prof_sample_t samples[PROF_RING_SIZE];
+} prof_ring_t;
+
+/* one ring per cpu, indexed by cpu_t.id */
+extern prof_ring_t prof_rings[PROF_NUM_CPU];
+
+/* called from the timer interrupt of every cpu, the PIT on the boot cpu
+ * and the LAPIC timer on the others */
+void prof_tick(intr_frame_t* frame);
+/* called from execute once the new pcb is set up */
+void prof_note_exec(uint8_t pid, uint32_t inode);
+
+/* profiler system calls */
+int32_t prof_start(int32_t hz);
+int32_t prof_stop(void);
+int32_t prof_read(void* buf, int32_t nbytes);
+
+#endif
@@ -1,98 +1,175 @@
 
 
 #include "rtc_handler.h"
+#include "thread.h"
+#include "spinlock.h"
+#include "pit.h"
+#include "irq.h"
+#include "timer.h"
+#include "sys_call.h"
+#include "vga.h"
 
 
-volatile int lock = 0;
+volatile uint32_t rtc_ticks = 0;
+/* the CMOS index/data port pair */
+static spinlock_t rtc_lock = SPINLOCK_INIT("rtc");
+/* threads blocked in rtc_read, by tid, and the hardware tick they wait for */
+static thread_t* rtc_waiters[THREAD_MAX];
+static uint32_t rtc_due[THREAD_MAX];
 /*
  *	Function: rtc_init
  *	Description: initialize the RTC
  *	input: None
  *	output: returns 0
- *	side-effect: initialize the RTC, and set the frequency to 2
+ *	side-effect: initialize the RTC, and set the frequency to RTC_HW_FREQ
+ *	             for good
  */
 void rtc_init() {
+  uint32_t flags;
 
-  cli();
+  spin_lock_irqsave(&rtc_lock, flags);
   outb(RTC_B, RTC_PORT);    /*disable NMI*/
   unsigned char prev = inb(CMOS_PORT);   /*store the current value in B reg*/
   outb(RTC_B, RTC_PORT);
   outb((prev | BIT_MASK), CMOS_PORT);   /*turn on the PIE, by bitmask*/
 
-  unsigned char rate = 0x0F;
-  rate &= 0x0F;              /*rate must be above 2 and not over 15*/
   outb(RTC_A, RTC_PORT);
   prev = inb(CMOS_PORT);
   outb(RTC_A, RTC_PORT);    /* reset index to Reg A*/
-  outb((prev & 0xF0) | rate, CMOS_PORT);
-  enable_irq(RTC_IRQ);   /* enable PIC to accept interrupts*/
-  sti();
+  outb((prev & 0xF0) | RTC_HW_RATE, CMOS_PORT);
   outb(0x0C, RTC_PORT);
   inb(CMOS_PORT);
+  spin_unlock_irqrestore(&rtc_lock, flags);
+  request_irq(RTC_IRQ, rtc_handler, "rtc", NULL);   /* enable PIC to accept interrupts*/
 }
 /*
  *	Function: rtc_handler
- *	Description: set lock to 1 and handle the interrupt
- *	input: None
- *	output: return 0
- *	side-effect: set the lock to 1 and display things on the screen
+ *	Description: count the hardware tick, wake the readers it is due for
+ *	             and put the frames queued by vidflip on the screen
+ *	input: frame, dev -- unused
+ *	output: None
+ *	side-effect: releases the next deadline job of each reader woken
  */
-void rtc_handler() {
-  cli();   /*critical area*/
-  lock = 1;
-     /*test interrupts*/
+void rtc_handler(intr_frame_t* frame, void* dev) {
+  /* interrupts are off in the handler already */
+  uint32_t i;
 
+  spin_lock(&rtc_lock);
+  rtc_ticks++;
   outb(0x0C, RTC_PORT);   /*select register C*/
   inb(CMOS_PORT);          /*throw contents*/
-  send_eoi(RTC_IRQ);
-  sti();
+  spin_unlock(&rtc_lock);
+  if (vga_flips_queued) {
+    spin_lock(&term_lock);
+    vga_flip_tick();
+    spin_unlock(&term_lock);
+  }
+  for (i = 0; i < THREAD_MAX; i++) {
+    if (rtc_waiters[i] != NULL && (int32_t)(rtc_ticks - rtc_due[i]) >= 0) {
+      sched_edf_release(rtc_waiters[i]);
+      thread_wake(rtc_waiters[i]);
+      rtc_waiters[i] = NULL;
+    }
+  }
 }
 
 /*
- *	Function: rtc_closer()
- *	Description: function to close the RTC.
+ *	Function: rtc_opener()
+ *	Description: function to open the RTC, the hardware rate is fixed so
+ *	             there is nothing to program
  *	input: None
  *	output: returns 0
- *	side-effect: open the RTC
+ *	side-effect: none
  */
 int32_t rtc_opener(const uint8_t* filename) {
-  // set the frequency to 2HZ
-  cli();
-  // rtc_init();
-  unsigned char prev;
-  unsigned char rate = 0x0F;
-  rate &= 0x0F;
-  outb(RTC_A, RTC_PORT);
-  prev = inb(CMOS_PORT);
-  outb(RTC_A, RTC_PORT);    /* reset index to Reg A*/
-  outb((prev & 0xF0) | rate, CMOS_PORT);
-  sti();
   return 0;
 }
 /*
- *	Function: rtc_opener()
+ *	Function: rtc_fd_init
+ *	Description: give a new rtc fd the default rate of 2 Hz
+ *	input: fd -- fd index in the current process
+ *	output: None
+ *	side-effect: its first virtual tick is one period from now
+ */
+void rtc_fd_init(int32_t fd) {
+  file_des_t* file = &get_cur_pcb()->fda[fd];
+
+  file->rtc_div = RTC_HW_FREQ / RTC_FREQUENCY_2;
+  file->rtc_next = rtc_ticks + file->rtc_div;
+}
+/*
+ *	Function: rtc_closer()
  *	Description: function to close the RTC.
  *	input: None
  *	output: returns 0
- *	side-effects: closes the RTC
+ *	side-effects: closes the RTC, the caller goes back to best effort
  */
 int32_t rtc_closer(int32_t fd) {
-  // set the frequency to 2HZ
-
+  sched_set_deadline(get_cur_thread(), 0, 0);
   return 0;
 }
+/*
+ *	Function: rtc_advance
+ *	Description: count the virtual ticks of one fd up to a hardware tick
+ *	input: next -- hardware tick of the next virtual tick, moved past the
+ *	       ones counted, div -- hardware ticks per virtual tick,
+ *	       now -- current hardware tick
+ *	output: virtual ticks due, 0 if next is still ahead
+ *	side-effect: none
+ */
+uint32_t rtc_advance(uint32_t* next, uint32_t div, uint32_t now) {
+  uint32_t count;
+
+  /* the counters wrap, compare by distance */
+  if ((int32_t)(now - *next) < 0) {
+    return 0;
+  }
+  count = (now - *next) / div + 1;
+  *next += count * div;
+  return count;
+}
 /*
  *	Function: rtc_read
- *	Description: RTC read should only happen when clock is available(the handler clear it), and always return 0
- *	input: file descriptor(fd), buf to store the frequency of rtc(buf), number of bytes(nbytes)
- *	output: returns 0
- *	side-effect: closes the RTC
+ *	Description: wait for the next virtual tick of this fd
+ *	input: file descriptor(fd), buf -- receives the number of virtual
+ *	       ticks since the last read << RTC_COUNT_SHIFT | RTC_PF when
+ *	       nbytes allows, number of bytes(nbytes)
+ *	output: returns 0, -1 if the deadline of read_timeout passed first
+ *	side-effect: blocks until the next tick, which ends the caller's
+ *	             current deadline job
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
-  while (lock == 0);
-  lock = 0;
+  thread_t* cur = get_cur_thread();
+  file_des_t* file = &get_cur_pcb()->fda[fd];
+  uint32_t flags, count;
+
+  cli_and_save(flags);
+  sched_edf_complete(cur);
+  while ((count = rtc_advance(&file->rtc_next, file->rtc_div, rtc_ticks)) == 0) {
+    rtc_due[cur->tid] = file->rtc_next;
+    rtc_waiters[cur->tid] = cur;
+    if (timer_block_io() == -1) {
+      rtc_waiters[cur->tid] = NULL;
+      restore_flags(flags);
+      return -1;
+    }
+  }
+  restore_flags(flags);
+  if (nbytes >= NUM_BYTE) {
+    *(uint32_t*)buf = (count << RTC_COUNT_SHIFT) | RTC_PF;
+  }
   return 0;
 }
+/*
+ *	Function: rtc_forget
+ *	Description: a thread blocked in rtc_read is being freed
+ *	input: tid -- its slot
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+void rtc_forget(uint32_t tid) {
+  rtc_waiters[tid] = NULL;
+}
 /* rtc_stop_interrupt
  * Description: stop the rtc interupt
  * Input: None
@@ -102,50 +179,55 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
 void rtc_stop_interrupt() {
   disable_irq(RTC_IRQ);
 }
+/*
+ *	Function: rtc_set_deadline
+ *	Description: make a thread paced by the rtc a deadline thread with
+ *	             its period and the default budget of EDF_BUDGET_SHARE,
+ *	             small enough that several such programs fit
+ *	input: t -- the thread, frequency -- virtual rtc rate
+ *	output: 0, -1 if the deadline class is full
+ *	side-effect: none
+ */
+int32_t rtc_set_deadline(thread_t* t, int32_t frequency) {
+  uint32_t period, budget;
+
+  period = PIT_HZ / frequency;
+  if (period == 0) {
+    period = 1;
+  }
+  budget = period / EDF_BUDGET_SHARE;
+  if (budget == 0) {
+    budget = 1;
+  }
+  return sched_set_deadline(t, period, budget);
+}
 /*
  *	Function: rtc_write()
- *	Description: determine what value for rate according to the frequency
+ *	Description: set the virtual rate of this fd, other fds keep theirs
  *	input: file descriptor(fd), buff that store the frequency of the RTC(buf), number of bytes(nbytes)
- *	output: returns 0 if success, return -1 if fail
- *	side-effect: set the corresponding frequency
+ *	output: returns 0 if success, return -1 if the frequency is not a
+ *	        power of two from 2 to RTC_HW_FREQ
+ *	side-effect: restarts the fd's tick count, and makes the caller a
+ *	             deadline thread with that period
  */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
+  file_des_t* file = &get_cur_pcb()->fda[fd];
   int32_t frequency;
-  unsigned char prev;
-  unsigned char rate;
-  // char* buffer = (char*)buf;
+  uint32_t flags;
+
   if (buf == NULL || nbytes != NUM_BYTE) {
     return -1;
   }
   frequency = *(int32_t*)buf;
-  if (frequency == RTC_FREQUENCY_2) {
-    rate = RTC_RATE_2;
-  } else if (frequency == RTC_FREQUENCY_4) {
-    rate = RTC_RATE_4;
-  } else if (frequency == RTC_FREQUENCY_8) {
-    rate = RTC_RATE_8;
-  } else if (frequency == RTC_FREQUENCY_16) {
-    rate = RTC_RATE_16;
-  } else if (frequency == RTC_FREQUENCY_32) {
-    rate = RTC_RATE_32;
-  } else if (frequency == RTC_FREQUENCY_64) {
-    rate = RTC_RATE_64;
-  } else if (frequency == RTC_FREQUENCY_128) {
-    rate = RTC_RATE_128;
-  } else if (frequency == RTC_FREQUENCY_256) {
-    rate = RTC_RATE_256;
-  } else if (frequency == RTC_FREQUENCY_512) {
-    rate = RTC_RATE_512;
-  } else if (frequency == RTC_FREQUENCY_1024) {
-    rate = RTC_RATE_1024;
-  } else {
+  if (frequency < RTC_FREQUENCY_2 || frequency > RTC_HW_FREQ || (frequency & (frequency - 1)) != 0) {
     return -1;
   }
-  rate &= 0x0F;
-  outb(RTC_A, RTC_PORT);
-  prev = inb(CMOS_PORT);
-  outb(RTC_A, RTC_PORT);    /* reset index to Reg A*/
-  outb((prev & 0xF0) | rate, CMOS_PORT);
+  cli_and_save(flags);
+  file->rtc_div = RTC_HW_FREQ / frequency;
+  file->rtc_next = rtc_ticks + file->rtc_div;
+  restore_flags(flags);
 
+  /* stays best effort if the deadline class is full */
+  rtc_set_deadline(get_cur_thread(), frequency);
   return 0;
   }
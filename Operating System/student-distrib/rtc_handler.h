@@ -3,6 +3,8 @@
 
 #include "lib.h"
 #include "i8259.h"
+#include "pit.h"
+#include "thread.h"
 /* magic numbers, data port and registers for RTC*/
 #define RTC_PORT 0x70
 #define CMOS_PORT 0x71
@@ -33,14 +35,33 @@
 #define RTC_RATE_512 7
 #define RTC_RATE_1024 6
 #define NUM_BYTE 4
+/* the hardware always runs at RTC_HW_FREQ; each open file counts its own
+ * virtual ticks every RTC_HW_FREQ / frequency hardware ticks. The file's
+ * rtc_div holds that divisor and its rtc_next the hardware tick of its
+ * next virtual tick. */
+#define RTC_HW_FREQ RTC_FREQUENCY_1024
+#define RTC_HW_RATE RTC_RATE_1024
+/* rtc_read data as on Linux: virtual ticks since the last read above
+ * the low byte, which has the periodic interrupt flag */
+#define RTC_PF 0x40
+#define RTC_COUNT_SHIFT 8
+/* hardware ticks since rtc_init */
+extern volatile uint32_t rtc_ticks;
 /* initialize the rtc*/
 void rtc_init();
-void rtc_handler();
+void rtc_handler(intr_frame_t* frame, void* dev);
 void rtc_stop_interrupt();
 int32_t rtc_opener(const uint8_t* filename);
+/* start an open fd at RTC_FREQUENCY_2, after open filled it in */
+void rtc_fd_init(int32_t fd);
+/* virtual ticks due by hardware tick now, next moves past them */
+uint32_t rtc_advance(uint32_t* next, uint32_t div, uint32_t now);
 int32_t rtc_closer(int32_t fd);
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
-void rtc_set_freq(int32_t freq);
+/* drop a thread that is being freed from the readers */
+void rtc_forget(uint32_t tid);
+/* deadline class for a thread paced at frequency, -1 if it is full */
+int32_t rtc_set_deadline(thread_t* t, int32_t frequency);
 /*rtc handler function*/
 #endif
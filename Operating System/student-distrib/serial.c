@@ -0,0 +1,352 @@
+#include "serial.h"
+#include "lib.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "irq.h"
+#include "timer.h"
+#include "kstat.h"
+
+serial_stats_t serial_stats;
+/* the rings and the UART registers */
+static spinlock_t serial_lock = SPINLOCK_INIT("serial");
+/* free-running indices, the rings are powers of two */
+static uint8_t tx_ring[SERIAL_TX_RING];
+static uint32_t tx_head, tx_tail;
+static uint8_t rx_ring[SERIAL_RX_RING];
+static uint32_t rx_head, rx_tail;
+static uint32_t tx_busy;            // the transmit interrupt is on
+/* threads blocked in serial_read / serial_write, by tid */
+static thread_t* serial_readers[THREAD_MAX];
+static thread_t* serial_writers[THREAD_MAX];
+
+/*
+ *	Function: serial_tx
+ *	Description: hand the UART as many bytes as its fifo takes, and turn
+ *	             the transmit interrupt off once the ring is empty
+ *	input: None
+ *	output: None
+ *	side-effect: serial_lock must be held and the fifo empty
+ */
+static void serial_tx() {
+  uint32_t i;
+
+  for (i = 0; i < UART_FIFO_SIZE && tx_tail != tx_head; i++) {
+    outb(tx_ring[tx_tail++ & (SERIAL_TX_RING - 1)], COM1_PORT + UART_DATA);
+  }
+  serial_stats.tx_bytes += i;
+  if (tx_tail == tx_head && tx_busy) {
+    tx_busy = 0;
+    outb(UART_IER_RX | UART_IER_LS, COM1_PORT + UART_IER);
+  }
+}
+
+/*
+ *	Function: serial_rx
+ *	Description: empty the receive fifo into the ring
+ *	input: None
+ *	output: None
+ *	side-effect: serial_lock must be held
+ */
+static void serial_rx() {
+  uint8_t c;
+
+  while (inb(COM1_PORT + UART_LSR) & UART_LSR_DR) {
+    c = inb(COM1_PORT + UART_DATA);
+    if (rx_head - rx_tail < SERIAL_RX_RING) {
+      rx_ring[rx_head++ & (SERIAL_RX_RING - 1)] = c;
+      serial_stats.rx_bytes++;
+    } else {
+      serial_stats.rx_dropped++;
+    }
+  }
+}
+
+/*
+ *	Function: serial_queue
+ *	Description: copy what fits of buf into the transmit ring and start
+ *	             the transmitter if it is idle
+ *	input: buf/n -- the output
+ *	output: bytes queued
+ *	side-effect: serial_lock must be held
+ */
+static uint32_t serial_queue(const uint8_t* buf, uint32_t n) {
+  uint32_t room = SERIAL_TX_RING - (tx_head - tx_tail);
+  uint32_t i;
+
+  if (n > room) {
+    n = room;
+  }
+  for (i = 0; i < n; i++) {
+    tx_ring[tx_head++ & (SERIAL_TX_RING - 1)] = buf[i];
+  }
+  if (n > 0 && !tx_busy) {
+    /* an idle transmitter takes a fifo's worth now, the interrupt
+     * asks for the rest */
+    if (inb(COM1_PORT + UART_LSR) & UART_LSR_THRE) {
+      serial_tx();
+    }
+    if (tx_tail != tx_head) {
+      tx_busy = 1;
+      outb(UART_IER_RX | UART_IER_LS | UART_IER_TX, COM1_PORT + UART_IER);
+    }
+  }
+  return n;
+}
+
+/*
+ *	Function: serial_init
+ *	Description: probe COM1 through its scratch register, program it for
+ *	             115200 8N1 with both fifos on and take its interrupt
+ *	input: None
+ *	output: None
+ *	side-effect: leaves serial_stats.present 0 if there is no UART
+ */
+void serial_init() {
+  uint32_t flags;
+
+  outb(UART_PROBE, COM1_PORT + UART_SCRATCH);
+  if (inb(COM1_PORT + UART_SCRATCH) != UART_PROBE) {
+    return;
+  }
+  spin_lock_irqsave(&serial_lock, flags);
+  outb(0, COM1_PORT + UART_IER);
+  outb(UART_LCR_DLAB, COM1_PORT + UART_LCR);
+  outb(UART_DIVISOR & 0xFF, COM1_PORT + UART_DATA);
+  outb(UART_DIVISOR >> 8, COM1_PORT + UART_IER);
+  outb(UART_LCR_8N1, COM1_PORT + UART_LCR);
+  outb(UART_FCR_ENABLE, COM1_PORT + UART_FCR);
+  outb(UART_MCR_DTR | UART_MCR_RTS | UART_MCR_OUT2, COM1_PORT + UART_MCR);
+  /* drop anything pending from before */
+  inb(COM1_PORT + UART_LSR);
+  inb(COM1_PORT + UART_DATA);
+  inb(COM1_PORT + UART_IIR);
+  inb(COM1_PORT + UART_MSR);
+  outb(UART_IER_RX | UART_IER_LS, COM1_PORT + UART_IER);
+  serial_stats.present = 1;
+  spin_unlock_irqrestore(&serial_lock, flags);
+  request_irq(COM1_IRQ, serial_handler, "serial", NULL);
+}
+
+/*
+ *	Function: serial_handler
+ *	Description: serve every reason the UART has to interrupt, then wake
+ *	             the readers if input came in and the writers once half
+ *	             the transmit ring is free
+ *	input: frame, dev -- unused
+ *	output: None
+ *	side-effect: none
+ */
+void serial_handler(intr_frame_t* frame, void* dev) {
+  uint32_t iir, i, rx, room;
+
+  spin_lock(&serial_lock);
+  serial_stats.irqs++;
+  rx = rx_head;
+  while (((iir = inb(COM1_PORT + UART_IIR)) & UART_IIR_NONE) == 0) {
+    switch (iir & UART_IIR_ID) {
+      case UART_IIR_RX:
+      case UART_IIR_TIMEOUT:
+        serial_rx();
+        break;
+      case UART_IIR_TX:
+        serial_tx();
+        break;
+      case UART_IIR_LSR:
+        if (inb(COM1_PORT + UART_LSR) & UART_LSR_OE) {
+          serial_stats.rx_dropped++;
+        }
+        break;
+      default:
+        inb(COM1_PORT + UART_MSR);
+        break;
+    }
+  }
+  rx = (rx != rx_head);
+  room = SERIAL_TX_RING - (tx_head - tx_tail);
+  spin_unlock(&serial_lock);
+  for (i = 0; i < THREAD_MAX; i++) {
+    if (rx && serial_readers[i] != NULL) {
+      thread_wake(serial_readers[i]);
+      serial_readers[i] = NULL;
+    }
+    if (room >= SERIAL_TX_RING / 2 && serial_writers[i] != NULL) {
+      thread_wake(serial_writers[i]);
+      serial_writers[i] = NULL;
+    }
+  }
+}
+
+/*
+ *	Function: serial_puts
+ *	Description: queue kernel output, safe from any context
+ *	input: buf/n -- the output
+ *	output: bytes queued, the rest is dropped
+ *	side-effect: none
+ */
+uint32_t serial_puts(const int8_t* buf, uint32_t n) {
+  uint32_t flags, queued;
+
+  if (!serial_stats.present) {
+    return 0;
+  }
+  spin_lock_irqsave(&serial_lock, flags);
+  queued = serial_queue((const uint8_t*)buf, n);
+  serial_stats.tx_dropped += n - queued;
+  spin_unlock_irqrestore(&serial_lock, flags);
+  return queued;
+}
+
+/*
+ *	Function: serial_loopback
+ *	Description: route the transmitter back to the receiver inside the
+ *	             UART, nothing reaches the line meanwhile
+ *	input: on -- 1 to loop, 0 for normal operation
+ *	output: None
+ *	side-effect: none
+ */
+void serial_loopback(uint32_t on) {
+  uint32_t flags;
+  uint8_t mcr = UART_MCR_DTR | UART_MCR_RTS | UART_MCR_OUT2;
+
+  if (!serial_stats.present) {
+    return;
+  }
+  spin_lock_irqsave(&serial_lock, flags);
+  outb(on ? mcr | UART_MCR_LOOP : mcr, COM1_PORT + UART_MCR);
+  spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+/*
+ *	Function: serial_open
+ *	Description: open the serial device
+ *	input: filename -- unused
+ *	output: 0, -1 if there is no UART
+ *	side-effect: none
+ */
+int32_t serial_open(const uint8_t* filename) {
+  return serial_stats.present ? 0 : -1;
+}
+
+/*
+ *	Function: serial_close
+ *	Description: close the serial device, queued output still goes out
+ *	input: fd -- unused
+ *	output: returns 0
+ *	side-effect: none
+ */
+int32_t serial_close(int32_t fd) {
+  return 0;
+}
+
+/*
+ *	Function: serial_read
+ *	Description: wait for input and take what has arrived, up to nbytes
+ *	input: fd -- unused, buf -- destination, nbytes -- size of buf
+ *	output: bytes read, -1 if the deadline of read_timeout passed first
+ *	side-effect: blocks until at least one byte is there
+ */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes) {
+  thread_t* cur = get_cur_thread();
+  uint32_t flags, lock_flags;
+  int32_t n;
+
+  if (buf == NULL) {
+    return -1;
+  }
+  if (nbytes <= 0) {
+    return 0;
+  }
+  cli_and_save(flags);
+  while (rx_head == rx_tail) {
+    serial_readers[cur->tid] = cur;
+    if (timer_block_io() == -1) {
+      serial_readers[cur->tid] = NULL;
+      restore_flags(flags);
+      return -1;
+    }
+  }
+  restore_flags(flags);
+  spin_lock_irqsave(&serial_lock, lock_flags);
+  for (n = 0; n < nbytes && rx_tail != rx_head; n++) {
+    ((uint8_t*)buf)[n] = rx_ring[rx_tail++ & (SERIAL_RX_RING - 1)];
+  }
+  spin_unlock_irqrestore(&serial_lock, lock_flags);
+  return n;
+}
+
+/*
+ *	Function: serial_forget
+ *	Description: a thread blocked in serial_read or serial_write is
+ *	             being freed
+ *	input: tid -- its slot
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+void serial_forget(uint32_t tid) {
+  serial_readers[tid] = NULL;
+  serial_writers[tid] = NULL;
+}
+
+/*
+ *	Function: serial_write
+ *	Description: queue all of buf for transmission. The caller only
+ *	             waits when the ring is full, and then until the
+ *	             transmitter has emptied half of it.
+ *	input: fd -- unused, buf/nbytes -- the output
+ *	output: nbytes, -1 for a bad buffer
+ *	side-effect: may block
+ */
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes) {
+  thread_t* cur = get_cur_thread();
+  uint32_t flags, lock_flags;
+  int32_t done = 0;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+  while (done < nbytes) {
+    spin_lock_irqsave(&serial_lock, lock_flags);
+    done += serial_queue((const uint8_t*)buf + done, nbytes - done);
+    spin_unlock_irqrestore(&serial_lock, lock_flags);
+    if (done == nbytes) {
+      break;
+    }
+    cli_and_save(flags);
+    if (SERIAL_TX_RING - (tx_head - tx_tail) < SERIAL_TX_RING / 2) {
+      serial_writers[cur->tid] = cur;
+      serial_stats.tx_waits++;
+      thread_block();
+    }
+    restore_flags(flags);
+  }
+  return nbytes;
+}
+
+/*
+ *	Function: serial_kstat
+ *	Description: append the serial counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void serial_kstat() {
+  if (!serial_stats.present) {
+    kstat_puts("serial: no uart\n");
+    return;
+  }
+  kstat_puts("serial: irqs ");
+  kstat_putu(serial_stats.irqs);
+  kstat_puts(", tx ");
+  kstat_putu(serial_stats.tx_bytes);
+  kstat_puts(" (queued ");
+  kstat_putu(tx_head - tx_tail);
+  kstat_puts(", dropped ");
+  kstat_putu(serial_stats.tx_dropped);
+  kstat_puts(", waits ");
+  kstat_putu(serial_stats.tx_waits);
+  kstat_puts("), rx ");
+  kstat_putu(serial_stats.rx_bytes);
+  kstat_puts(" (dropped ");
+  kstat_putu(serial_stats.rx_dropped);
+  kstat_puts(")\n");
+}
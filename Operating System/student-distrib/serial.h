@@ -0,0 +1,80 @@
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+#include "pit.h"
+
+/* COM1, a 16550A. Output goes through a kernel ring the transmit
+ * interrupt drains 16 bytes at a time, so a writer only waits when the
+ * ring is full; input is collected by the receive interrupt. */
+#define COM1_PORT           0x3F8
+#define COM1_IRQ            4
+#define UART_DATA           0         /* rx/tx holding register, divisor low with DLAB */
+#define UART_IER            1         /* interrupt enable, divisor high with DLAB */
+#define UART_IIR            2         /* interrupt identification on read */
+#define UART_FCR            2         /* fifo control on write */
+#define UART_LCR            3
+#define UART_MCR            4
+#define UART_LSR            5
+#define UART_SCRATCH        7
+#define UART_IER_RX         0x01      /* data received */
+#define UART_IER_TX         0x02      /* transmit holding register empty */
+#define UART_IER_LS         0x04      /* receive line status */
+#define UART_IIR_NONE       0x01      /* no interrupt pending */
+#define UART_IIR_ID         0x0E
+#define UART_IIR_MSR        0x00
+#define UART_IIR_TX         0x02
+#define UART_IIR_RX         0x04
+#define UART_IIR_LSR        0x06
+#define UART_IIR_TIMEOUT    0x0C      /* bytes sat in the rx fifo below the trigger */
+#define UART_FCR_ENABLE     0xC7      /* fifos on and cleared, rx trigger at 14 bytes */
+#define UART_LCR_DLAB       0x80
+#define UART_LCR_8N1        0x03
+#define UART_MCR_DTR        0x01
+#define UART_MCR_RTS        0x02
+#define UART_MCR_OUT2       0x08      /* gates the interrupt line on PC boards */
+#define UART_MCR_LOOP       0x10
+#define UART_LSR_DR         0x01
+#define UART_LSR_OE         0x02
+#define UART_LSR_THRE       0x20
+#define UART_MSR            6
+#define UART_FIFO_SIZE      16
+#define UART_DIVISOR        1         /* 115200 baud */
+#define UART_PROBE          0x5A
+
+/* rings, powers of two */
+#define SERIAL_TX_RING      0x4000
+#define SERIAL_RX_RING      0x400
+
+typedef struct {
+    uint32_t present;           // the UART answered the probe
+    uint32_t irqs;
+    uint32_t tx_bytes;          // bytes handed to the UART
+    uint32_t rx_bytes;
+    uint32_t tx_dropped;        // kernel output that did not fit in the ring
+    uint32_t rx_dropped;        // input that did not fit, or that the UART overran
+    uint32_t tx_waits;          // writers that blocked on a full ring
+} serial_stats_t;
+
+extern serial_stats_t serial_stats;
+
+/* probe and program COM1, then take its interrupt */
+void serial_init();
+void serial_handler(intr_frame_t* frame, void* dev);
+/* kernel output, never blocks: what does not fit in the ring is dropped */
+uint32_t serial_puts(const int8_t* buf, uint32_t n);
+/* route the transmitter back to the receiver, for tests */
+void serial_loopback(uint32_t on);
+/* drop a thread that is being freed from the readers and writers */
+void serial_forget(uint32_t tid);
+
+/* the "serial" device */
+int32_t serial_open(const uint8_t* filename);
+int32_t serial_close(int32_t fd);
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+
+/* append the serial counters to the kstat report */
+void serial_kstat();
+
+#endif
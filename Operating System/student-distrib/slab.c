@@ -0,0 +1,310 @@
+#include "slab.h"
+#include "lib.h"
+#include "paging.h"
+#include "kstat.h"
+
+static kmem_cache_t caches[SLAB_MAX_CACHES];
+/* the cache slots; each cache's own lock covers its slabs */
+static spinlock_t caches_lock = SPINLOCK_INIT("slab caches");
+static kmem_cache_t* kmalloc_caches[KMALLOC_CLASSES];
+static const int8_t* kmalloc_names[KMALLOC_CLASSES] = {
+  "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+  "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048",
+};
+
+/* objects start after the slab header */
+#define SLAB_FIRST_OBJ ((sizeof(slab_t) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+/*
+ *	Function: slab_unlink
+ *	Description: remove a slab from one of a cache's lists
+ *	input: head -- the list, slab -- slab on that list
+ *	output: None
+ *	side-effect: none
+ */
+static void slab_unlink(slab_t** head, slab_t* slab) {
+  if (slab->prev != NULL) {
+    slab->prev->next = slab->next;
+  } else {
+    *head = slab->next;
+  }
+  if (slab->next != NULL) {
+    slab->next->prev = slab->prev;
+  }
+  slab->prev = NULL;
+  slab->next = NULL;
+}
+
+/*
+ *	Function: slab_push
+ *	Description: put a slab at the front of one of a cache's lists
+ *	input: head -- the list, slab -- slab on no list
+ *	output: None
+ *	side-effect: none
+ */
+static void slab_push(slab_t** head, slab_t* slab) {
+  slab->prev = NULL;
+  slab->next = *head;
+  if (*head != NULL) {
+    (*head)->prev = slab;
+  }
+  *head = slab;
+}
+
+/*
+ *	Function: slab_new
+ *	Description: get a page and cut it into free objects for a cache
+ *	input: cache -- the owner of the new slab
+ *	output: the slab, NULL if there is no free frame
+ *	side-effect: counted in cache->slabs
+ */
+static slab_t* slab_new(kmem_cache_t* cache) {
+  slab_t* slab = (slab_t*)page_alloc();
+  uint8_t* obj;
+  uint32_t i;
+
+  if (slab == NULL) {
+    return NULL;
+  }
+  slab->prev = NULL;
+  slab->next = NULL;
+  slab->cache = cache;
+  slab->inuse = 0;
+  slab->free = NULL;
+  /* thread the free list backwards so objects go out in address order */
+  obj = (uint8_t*)slab + SLAB_FIRST_OBJ + (cache->per_slab - 1) * cache->size;
+  for (i = 0; i < cache->per_slab; i++, obj -= cache->size) {
+    *(void**)obj = slab->free;
+    slab->free = obj;
+  }
+  cache->slabs++;
+  return slab;
+}
+
+/*
+ *	Function: slab_init
+ *	Description: create the kmalloc size classes
+ *	input: None
+ *	output: None
+ *	side-effect: must run after paging_init
+ */
+void slab_init() {
+  uint32_t i;
+
+  for (i = 0; i < KMALLOC_CLASSES; i++) {
+    kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i], 1 << (i + KMALLOC_MIN_SHIFT));
+  }
+}
+
+/*
+ *	Function: kmem_cache_create
+ *	Description: make a cache for objects of one size
+ *	input: name -- shown in the kstat report, size -- object size in bytes
+ *	output: the cache, NULL if the size does not fit a slab or every
+ *	        cache slot is taken
+ *	side-effect: no memory is taken until the first allocation
+ */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size) {
+  kmem_cache_t* cache;
+  uint32_t i;
+  uint32_t flags;
+
+  size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+  if (size == 0 || size > SLAB_SIZE - SLAB_FIRST_OBJ) {
+    return NULL;
+  }
+  spin_lock_irqsave(&caches_lock, flags);
+  for (i = 0; i < SLAB_MAX_CACHES; i++) {
+    if (caches[i].name == NULL) {
+      break;
+    }
+  }
+  if (i == SLAB_MAX_CACHES) {
+    spin_unlock_irqrestore(&caches_lock, flags);
+    return NULL;
+  }
+  cache = &caches[i];
+  memset(cache, 0, sizeof(kmem_cache_t));
+  spin_lock_init(&cache->lock, name);
+  cache->name = name;
+  cache->size = size;
+  cache->per_slab = (SLAB_SIZE - SLAB_FIRST_OBJ) / size;
+  spin_unlock_irqrestore(&caches_lock, flags);
+  return cache;
+}
+
+/*
+ *	Function: kmem_cache_destroy
+ *	Description: give back the pages of a cache and its slot
+ *	input: cache -- cache from kmem_cache_create
+ *	output: 0 on success, -1 if objects are still allocated
+ *	side-effect: none
+ */
+int32_t kmem_cache_destroy(kmem_cache_t* cache) {
+  uint32_t flags;
+
+  if (cache == NULL) {
+    return -1;
+  }
+  spin_lock_irqsave(&caches_lock, flags);
+  if (cache->active != 0) {
+    spin_unlock_irqrestore(&caches_lock, flags);
+    return -1;
+  }
+  /* with nothing active every slab but the spare has been freed */
+  page_free(cache->empty);
+  cache->name = NULL;
+  spin_unlock_irqrestore(&caches_lock, flags);
+  return 0;
+}
+
+/*
+ *	Function: kmem_cache_alloc
+ *	Description: take an object from the first slab with room, adding a
+ *	             slab when there is none
+ *	input: cache -- cache to allocate from
+ *	output: the object (contents undefined), NULL if out of memory
+ *	side-effect: updates the cache statistics
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+  slab_t* slab;
+  void* obj;
+  uint32_t flags;
+
+  if (cache == NULL) {
+    return NULL;
+  }
+  spin_lock_irqsave(&cache->lock, flags);
+  slab = cache->partial;
+  if (slab == NULL) {
+    slab = cache->empty;
+    cache->empty = NULL;
+    if (slab == NULL) {
+      slab = slab_new(cache);
+    }
+    if (slab == NULL) {
+      cache->failures++;
+      spin_unlock_irqrestore(&cache->lock, flags);
+      return NULL;
+    }
+    slab_push(&cache->partial, slab);
+  }
+  obj = slab->free;
+  slab->free = *(void**)obj;
+  slab->inuse++;
+  if (slab->free == NULL) {
+    slab_unlink(&cache->partial, slab);
+    slab_push(&cache->full, slab);
+  }
+  cache->allocs++;
+  cache->active++;
+  if (cache->active > cache->peak) {
+    cache->peak = cache->active;
+  }
+  spin_unlock_irqrestore(&cache->lock, flags);
+  return obj;
+}
+
+/*
+ *	Function: kmem_cache_free
+ *	Description: return an object to its slab; an empty slab becomes the
+ *	             cache's spare or goes back to the page allocator
+ *	input: cache -- cache the object came from, obj -- the object
+ *	output: None
+ *	side-effect: objects of another cache are ignored
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+  slab_t* slab = (slab_t*)((uint32_t)obj & SLAB_MASK);
+  uint32_t flags;
+
+  if (obj == NULL || cache == NULL || slab->cache != cache) {
+    return;
+  }
+  spin_lock_irqsave(&cache->lock, flags);
+  if (slab->free == NULL) {
+    slab_unlink(&cache->full, slab);
+    slab_push(&cache->partial, slab);
+  }
+  *(void**)obj = slab->free;
+  slab->free = obj;
+  slab->inuse--;
+  cache->frees++;
+  cache->active--;
+  if (slab->inuse == 0) {
+    slab_unlink(&cache->partial, slab);
+    if (cache->empty == NULL) {
+      cache->empty = slab;
+    } else {
+      page_free(slab);
+      cache->slabs--;
+    }
+  }
+  spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/*
+ *	Function: kmalloc
+ *	Description: allocate from the smallest size class that fits
+ *	input: size -- bytes needed, at most KMALLOC_MAX
+ *	output: the memory, NULL if size is 0, too big or memory is exhausted
+ *	side-effect: none
+ */
+void* kmalloc(uint32_t size) {
+  uint32_t i;
+
+  if (size == 0 || size > KMALLOC_MAX) {
+    return NULL;
+  }
+  for (i = 0; (1U << (i + KMALLOC_MIN_SHIFT)) < size; i++)
+    ;
+  return kmem_cache_alloc(kmalloc_caches[i]);
+}
+
+/*
+ *	Function: kfree
+ *	Description: free memory from kmalloc or any cache, the slab header
+ *	             says which cache it belongs to
+ *	input: obj -- the memory, NULL is ignored
+ *	output: None
+ *	side-effect: none
+ */
+void kfree(void* obj) {
+  if (obj == NULL) {
+    return;
+  }
+  kmem_cache_free(((slab_t*)((uint32_t)obj & SLAB_MASK))->cache, obj);
+}
+
+/*
+ *	Function: slab_kstat
+ *	Description: append one line per cache to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void slab_kstat() {
+  uint32_t i;
+
+  for (i = 0; i < SLAB_MAX_CACHES; i++) {
+    if (caches[i].name == NULL) {
+      continue;
+    }
+    kstat_puts("slab ");
+    kstat_puts(caches[i].name);
+    kstat_puts(": size ");
+    kstat_putu(caches[i].size);
+    kstat_puts(", active ");
+    kstat_putu(caches[i].active);
+    kstat_puts(", peak ");
+    kstat_putu(caches[i].peak);
+    kstat_puts(", slabs ");
+    kstat_putu(caches[i].slabs);
+    kstat_puts(", allocs ");
+    kstat_putu(caches[i].allocs);
+    kstat_puts(", frees ");
+    kstat_putu(caches[i].frees);
+    kstat_puts(", failures ");
+    kstat_putu(caches[i].failures);
+    kstat_puts("\n");
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "spinlock.h"
+
+/* every slab is one 4kb frame from page_alloc with its header at the start */
+#define SLAB_SIZE        0x1000
+#define SLAB_MASK        0xFFFFF000
+#define SLAB_ALIGN       16         /* enough for FXSAVE areas */
+#define SLAB_MAX_CACHES  24
+
+/* kmalloc size classes, powers of two from KMALLOC_MIN to KMALLOC_MAX */
+#define KMALLOC_MIN_SHIFT 4
+#define KMALLOC_MAX_SHIFT 11
+#define KMALLOC_CLASSES   (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+#define KMALLOC_MAX       (1 << KMALLOC_MAX_SHIFT)
+
+struct kmem_cache;
+
+/* header at the start of every slab page */
+typedef struct slab {
+    struct slab* prev;
+    struct slab* next;
+    struct kmem_cache* cache;
+    void* free;                 // free objects, linked through their first word
+    uint32_t inuse;
+} slab_t;
+
+/* a cache of equally sized objects */
+typedef struct kmem_cache {
+    spinlock_t lock;            // the slab lists and counters
+    const int8_t* name;
+    uint32_t size;              // object size rounded to SLAB_ALIGN
+    uint32_t per_slab;          // objects that fit in one slab
+    slab_t* partial;            // slabs with at least one free object
+    slab_t* full;               // slabs with none
+    slab_t* empty;              // one spare slab kept to avoid page churn
+    uint32_t allocs;            // successful allocations
+    uint32_t frees;
+    uint32_t active;            // objects handed out right now
+    uint32_t peak;              // highest active
+    uint32_t slabs;             // pages held, including the spare
+    uint32_t failures;          // allocations that found no memory
+} kmem_cache_t;
+
+/* set up the kmalloc caches, needs paging */
+void slab_init();
+
+/* named caches for one kind of object */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size);
+int32_t kmem_cache_destroy(kmem_cache_t* cache);
+void* kmem_cache_alloc(kmem_cache_t* cache);
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+/* general purpose allocation up to KMALLOC_MAX bytes */
+void* kmalloc(uint32_t size);
+void kfree(void* obj);
+
+/* append per-cache statistics to the kstat report */
+void slab_kstat();
+
+#endif
@@ -0,0 +1,655 @@
+#include "smp.h"
+#include "apic.h"
+#include "lib.h"
+#include "paging.h"
+#include "fpu.h"
+#include "kstat.h"
+#include "klog.h"
+#include "profile.h"
+
+cpu_t cpus[MAX_CPUS];
+uint32_t smp_ncpus = 1;
+volatile uint32_t smp_active;
+
+/* MP floating pointer structure */
+typedef struct __attribute__((packed)) {
+    uint32_t signature;
+    uint32_t config;            // physical address of the configuration table
+    uint8_t length;             // in 16 byte units
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t features[5];
+} mp_float_t;
+
+/* MP configuration table header, the entries follow it */
+typedef struct __attribute__((packed)) {
+    uint32_t signature;
+    uint16_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t oem[20];
+    uint32_t oem_table;
+    uint16_t oem_length;
+    uint16_t entries;
+    uint32_t lapic;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+#define MP_BUS_MAX    256
+#define MP_INT_FIXED  0
+
+/* kernel lock word and the cpu holding it, -1 while free */
+static volatile uint32_t klock;
+static volatile int32_t klock_owner = -1;
+/* the directory smp_flush_tlb asks other cpus to leave */
+static uint32_t* volatile smp_dead_pd;
+/* LAPIC timer count for one PIT tick */
+static uint32_t lapic_ticks;
+/* cpu ap_main is starting */
+static cpu_t* volatile booting_cpu;
+
+/*
+ *	Function: this_cpu
+ *	Description: every cpu loads its own GDT, which is the first member of
+ *	             its cpu_t, so the GDTR base says which cpu we are on. The
+ *	             boot cpu keeps the GDT from x86_desc.S.
+ *	input: None
+ *	output: the calling cpu
+ *	side-effect: none
+ */
+cpu_t* this_cpu() {
+  struct __attribute__((packed)) {
+    uint16_t limit;
+    uint32_t base;
+  } gdtr;
+
+  asm volatile("sgdt %0" : "=m"(gdtr));
+  if (gdtr.base == (uint32_t)gdt) {
+    return &cpus[0];
+  }
+  return (cpu_t*)gdtr.base;
+}
+
+/*
+ *	Function: mp_sum
+ *	Description: byte checksum of an MP structure
+ *	input: p -- start, len -- bytes
+ *	output: 0 for a valid structure
+ *	side-effect: none
+ */
+static uint8_t mp_sum(const uint8_t* p, uint32_t len) {
+  uint8_t sum = 0;
+  while (len-- > 0) {
+    sum += *p++;
+  }
+  return sum;
+}
+
+/*
+ *	Function: bios_map
+ *	Description: identity map (or unmap) a range of the first megabyte so
+ *	             the MP tables can be read
+ *	input: start, end -- physical range, on -- 0 to unmap again
+ *	output: None
+ *	side-effect: changes page_table, shared by every directory
+ */
+static void bios_map(uint32_t start, uint32_t end, uint32_t on) {
+  uint32_t page;
+
+  for (page = start; page < end; page += PAGE_BYTES) {
+    page_table[page >> TABLE_IDX_SHIFT] = on ? (page | RW_P_SET) : RW_SET_ONLY;
+    flush_tlb_page(page);
+  }
+}
+
+/*
+ *	Function: mp_scan
+ *	Description: look for the floating pointer on 16 byte boundaries
+ *	input: start, end -- mapped physical range
+ *	output: the structure, NULL if it is not there
+ *	side-effect: none
+ */
+static mp_float_t* mp_scan(uint32_t start, uint32_t end) {
+  mp_float_t* mp;
+
+  for (; start + sizeof(mp_float_t) <= end; start += MP_ALIGN) {
+    mp = (mp_float_t*)start;
+    if (mp->signature == MP_FLOAT_SIG && mp->length == 1 && mp_sum((uint8_t*)mp, MP_ALIGN) == 0) {
+      return mp;
+    }
+  }
+  return NULL;
+}
+
+/*
+ *	Function: mp_in_bios
+ *	Description: check a physical range lies in one of the mapped BIOS areas
+ *	input: start -- physical address, len -- bytes
+ *	output: 1 if it can be read
+ *	side-effect: none
+ */
+static uint32_t mp_in_bios(uint32_t start, uint32_t len) {
+  return (start >= BIOS_ROM_SCAN && start + len <= BIOS_ROM_END) ||
+         (start >= BIOS_EBDA_SCAN && start + len <= BIOS_EBDA_END);
+}
+
+/*
+ *	Function: mp_parse
+ *	Description: fill cpus[] from the processor entries and note the
+ *	             LAPIC/IOAPIC addresses and ISA irq wiring
+ *	input: lapic, ioapic -- set to the register bases
+ *	output: number of usable cpus, 0 without a valid MP table
+ *	side-effect: the boot cpu becomes cpus[0]
+ */
+static uint32_t mp_parse(uint32_t* lapic, uint32_t* ioapic) {
+  mp_float_t* mp;
+  mp_config_t* conf;
+  uint8_t* entry;
+  uint8_t isa_bus[MP_BUS_MAX];
+  uint32_t i, n = 1;
+
+  mp = mp_scan(BIOS_EBDA_SCAN, BIOS_EBDA_END);
+  if (mp == NULL) {
+    mp = mp_scan(BIOS_ROM_SCAN, BIOS_ROM_END);
+  }
+  /* no configuration table means one of the default configurations,
+   * which are all single or dual cpu boards we do not bother with */
+  if (mp == NULL || mp->config == 0 || !mp_in_bios(mp->config, sizeof(mp_config_t))) {
+    return 0;
+  }
+  conf = (mp_config_t*)mp->config;
+  if (conf->signature != MP_CONFIG_SIG || !mp_in_bios(mp->config, conf->length) ||
+      mp_sum((uint8_t*)conf, conf->length) != 0) {
+    return 0;
+  }
+  *lapic = conf->lapic;
+  *ioapic = IOAPIC_DEFAULT;
+  memset(isa_bus, 0, sizeof(isa_bus));
+
+  entry = (uint8_t*)(conf + 1);
+  for (i = 0; i < conf->entries && entry < (uint8_t*)conf + conf->length; i++) {
+    switch (entry[0]) {
+    case MP_PROC:
+      if (entry[3] & MP_PROC_ENABLED) {
+        if (entry[3] & MP_PROC_BSP) {
+          cpus[0].apic_id = entry[1];
+        } else if (n < MAX_CPUS) {
+          cpus[n++].apic_id = entry[1];
+        }
+      }
+      entry += MP_PROC_SIZE;
+      break;
+    case MP_BUS:
+      isa_bus[entry[1]] = strncmp((int8_t*)&entry[2], "ISA", 3) == 0;
+      entry += MP_ENTRY_SIZE;
+      break;
+    case MP_IOAPIC:
+      /* the first IOAPIC has the ISA irqs */
+      if (*ioapic == IOAPIC_DEFAULT) {
+        *ioapic = *(uint32_t*)&entry[4];
+      }
+      entry += MP_ENTRY_SIZE;
+      break;
+    case MP_IOINTR:
+      if (entry[1] == MP_INT_FIXED && isa_bus[entry[4]]) {
+        ioapic_set_pin(entry[5], entry[7]);
+      }
+      entry += MP_ENTRY_SIZE;
+      break;
+    default:
+      entry += MP_ENTRY_SIZE;
+      break;
+    }
+  }
+  /* the board still routes the PIC straight to the boot cpu */
+  if (mp->features[1] & MP_IMCR_PRESENT) {
+    outb(IMCR_REG, IMCR_SELECT);
+    outb(IMCR_APIC, IMCR_DATA);
+  }
+  return n;
+}
+
+/*
+ *	Function: cpu_load_gdt
+ *	Description: give an application processor its own copy of the GDT
+ *	             with a TSS descriptor for its own TSS, and load both
+ *	input: cpu -- the calling cpu
+ *	output: None
+ *	side-effect: none
+ */
+static void cpu_load_gdt(cpu_t* cpu) {
+  seg_desc_t* desc = &cpu->gdt[KERNEL_TSS >> 3];
+
+  memcpy(cpu->gdt, gdt, sizeof(cpu->gdt));
+  memset(&cpu->own_tss, 0, sizeof(tss_t));
+  cpu->own_tss.ss0 = KERNEL_DS;
+  cpu->own_tss.esp0 = sched_idle_stack(cpu->id);
+  cpu->own_tss.ldt_segment_selector = KERNEL_LDT;
+  cpu->tss = &cpu->own_tss;
+
+  desc->val[0] = 0;
+  desc->val[1] = 0;
+  desc->present = 1;
+  desc->type = 0x9;             /* available 32-bit TSS */
+  SET_TSS_PARAMS((*desc), &cpu->own_tss, TSS_SIZE - 1);
+
+  cpu->gdt_desc.size = sizeof(cpu->gdt) - 1;
+  cpu->gdt_desc.addr = (uint32_t)cpu->gdt;
+  asm volatile("lgdt %0" : : "m"(cpu->gdt_desc.size) : "memory");
+  /* the label is the limit word, like boot.S loads it */
+  asm volatile("lidt idt_desc_ptr" : : : "memory");
+  lldt(KERNEL_LDT);
+  ltr(KERNEL_TSS);
+}
+
+/*
+ *	Function: ap_main
+ *	Description: C entry of an application processor, on its idle stack
+ *	input: None
+ *	output: does not return
+ *	side-effect: runs the cpu's idle thread
+ */
+void ap_main() {
+  cpu_t* cpu = booting_cpu;
+
+  cpu_load_gdt(cpu);
+  lapic_init();
+  lapic_timer_start(lapic_ticks);
+  fpu_cpu_init();
+  load_page_directory(page_directory);
+  sched_ap_main(cpu);
+}
+
+/*
+ *	Function: ap_start
+ *	Description: INIT-SIPI-SIPI one application processor and wait for it
+ *	             to come up
+ *	input: cpu -- the cpu to start
+ *	output: 0 once it runs, -1 after AP_BOOT_TIMEOUT ticks
+ *	side-effect: interrupts must be on, the delays count PIT ticks
+ */
+static int32_t ap_start(cpu_t* cpu) {
+  uint32_t start;
+
+  booting_cpu = cpu;
+  *(uint32_t*)(AP_TRAMPOLINE + (ap_esp - ap_trampoline)) = sched_idle_stack(cpu->id);
+
+  lapic_ipi(cpu->apic_id, LAPIC_ICR_INIT);
+  start = pit_ticks;
+  while (pit_ticks - start < INIT_DELAY)
+    ;
+  lapic_ipi(cpu->apic_id, LAPIC_ICR_SIPI | (AP_TRAMPOLINE >> TABLE_IDX_SHIFT));
+  start = pit_ticks;
+  while (pit_ticks - start < SIPI_DELAY)
+    ;
+  if (!cpu->online) {
+    lapic_ipi(cpu->apic_id, LAPIC_ICR_SIPI | (AP_TRAMPOLINE >> TABLE_IDX_SHIFT));
+  }
+  start = pit_ticks;
+  while (!cpu->online && pit_ticks - start < AP_BOOT_TIMEOUT)
+    ;
+  return cpu->online ? 0 : -1;
+}
+
+/*
+ *	Function: smp_init
+ *	Description: read the MP table, move the device irqs from the PIC to
+ *	             the IOAPIC, take the kernel lock and start every other cpu
+ *	             through the real mode trampoline. Without an MP table or
+ *	             with one cpu nothing changes.
+ *	input: None
+ *	output: None
+ *	side-effect: must run after sched_init and fpu_init, before the first
+ *	             execute
+ */
+void smp_init() {
+  uint32_t lapic_phys = 0, ioapic_phys = 0;
+  uint32_t i, n, cr4;
+  uint32_t flags;
+  x86_desc_t* tramp_gdtr;
+
+  bios_map(BIOS_EBDA_SCAN, BIOS_EBDA_END, 1);
+  bios_map(BIOS_ROM_SCAN, BIOS_ROM_END, 1);
+  n = mp_parse(&lapic_phys, &ioapic_phys);
+  bios_map(BIOS_EBDA_SCAN, BIOS_EBDA_END, 0);
+  bios_map(BIOS_ROM_SCAN, BIOS_ROM_END, 0);
+  if (n < 2) {
+    return;
+  }
+
+  cli_and_save(flags);
+  apic_map(lapic_phys, ioapic_phys);
+  lapic_init();
+  cpus[0].apic_id = lapic_id();
+  ioapic_takeover(cpus[0].apic_id);
+  restore_flags(flags);
+  lapic_ticks = lapic_timer_calibrate();
+
+  /* from here on every cpu needs the lock to run kernel code */
+  cli_and_save(flags);
+  for (i = 1; i < n; i++) {
+    cpus[i].id = i;
+  }
+  smp_active = 1;
+  kernel_enter();
+  restore_flags(flags);
+
+  /* the trampoline page, with the boot cpu's GDT, cr3 and cr4 */
+  map_virt_to_phys(page_directory, AP_TRAMPOLINE, AP_TRAMPOLINE, RW_P_SET);
+  memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+  tramp_gdtr = (x86_desc_t*)(AP_TRAMPOLINE + (ap_gdtr - ap_trampoline) - 2);
+  tramp_gdtr->size = sizeof(seg_desc_t) * GDT_ENTRIES - 1;
+  tramp_gdtr->addr = (uint32_t)gdt;
+  asm volatile("movl %%cr4, %0" : "=r"(cr4));
+  *(uint32_t*)(AP_TRAMPOLINE + (ap_cr3 - ap_trampoline)) = (uint32_t)page_directory;
+  *(uint32_t*)(AP_TRAMPOLINE + (ap_cr4 - ap_trampoline)) = cr4;
+
+  for (i = 1; i < n; i++) {
+    if (ap_start(&cpus[i]) == 0) {
+      smp_ncpus++;
+    }
+  }
+  page_table[AP_TRAMPOLINE >> TABLE_IDX_SHIFT] = RW_SET_ONLY;
+  flush_tlb_page(AP_TRAMPOLINE);
+  klog(KLOG_INFO, "smp: %u of %u cpus online", smp_ncpus, n);
+}
+
+/*
+ *	Function: smp_poll
+ *	Description: do what other cpus asked of this one while it could not
+ *	             take an interrupt
+ *	input: cpu -- the calling cpu
+ *	output: None
+ *	side-effect: may reload cr3
+ */
+static void smp_poll(cpu_t* cpu) {
+  if (!cpu->tlb_req) {
+    return;
+  }
+  if (smp_dead_pd != NULL && cpu->page_dir == smp_dead_pd) {
+    load_page_directory(page_directory);
+  } else {
+    load_page_directory(cpu->page_dir);
+  }
+  cpu->tlb_req = 0;
+}
+
+/*
+ *	Function: klock_acquire
+ *	Description: spin for the kernel lock, serving TLB requests meanwhile
+ *	             since the cpu holding the lock may be waiting for them
+ *	input: cpu -- the calling cpu
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+static void klock_acquire(cpu_t* cpu) {
+  uint32_t old;
+
+  for (;;) {
+    old = 1;
+    asm volatile("xchgl %0, %1" : "+r"(old), "+m"(klock) : : "memory");
+    if (old == 0) {
+      break;
+    }
+    while (klock) {
+      smp_poll(cpu);
+      asm volatile("pause" : : : "memory");
+    }
+  }
+  klock_owner = cpu->id;
+}
+
+/*
+ *	Function: klock_free
+ *	Description: let another cpu have the kernel lock
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+static void klock_free() {
+  klock_owner = -1;
+  asm volatile("" : : : "memory");
+  klock = 0;
+}
+
+/*
+ *	Function: kernel_enter
+ *	Description: called on every entry to the kernel from an interrupt,
+ *	             exception or system call. Takes the kernel lock unless this
+ *	             cpu already holds it.
+ *	input: None
+ *	output: None
+ *	side-effect: nothing before smp_init has started other cpus
+ */
+void kernel_enter() {
+  cpu_t* cpu;
+  uint32_t flags;
+
+  if (!smp_active) {
+    return;
+  }
+  cli_and_save(flags);
+  cpu = this_cpu();
+  if (klock_owner != cpu->id) {
+    klock_acquire(cpu);
+    cpu->lock_depth = 0;
+  }
+  cpu->lock_depth++;
+  restore_flags(flags);
+}
+
+/*
+ *	Function: kernel_exit
+ *	Description: undo one kernel_enter. The outermost one drops the lock,
+ *	             and first ends a clone thread whose process is exiting.
+ *	input: None
+ *	output: None
+ *	side-effect: may not return for a killed thread
+ */
+void kernel_exit() {
+  cpu_t* cpu;
+  uint32_t flags;
+
+  if (!smp_active) {
+    return;
+  }
+  cli_and_save(flags);
+  cpu = this_cpu();
+  if (cpu->lock_depth == 1 && get_cur_thread()->killed) {
+    thread_exit(-1);
+  }
+  if (--cpu->lock_depth == 0) {
+    klock_free();
+  }
+  restore_flags(flags);
+}
+
+/*
+ *	Function: kernel_lock
+ *	Description: take the kernel lock for code that does not come in
+ *	             through kernel_enter, like the idle loop
+ *	input: None
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+void kernel_lock() {
+  cpu_t* cpu;
+
+  if (!smp_active) {
+    return;
+  }
+  cpu = this_cpu();
+  klock_acquire(cpu);
+  cpu->lock_depth = 1;
+}
+
+/*
+ *	Function: kernel_release
+ *	Description: drop the kernel lock however deep this cpu holds it, for
+ *	             the paths that enter user mode without unwinding, and idle
+ *	input: None
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+void kernel_release() {
+  cpu_t* cpu;
+
+  if (!smp_active) {
+    return;
+  }
+  cpu = this_cpu();
+  if (klock_owner == cpu->id) {
+    cpu->lock_depth = 0;
+    klock_free();
+  }
+}
+
+/*
+ *	Function: kernel_relax
+ *	Description: let other cpus into the kernel for a moment, for kernel
+ *	             code that waits without sleeping
+ *	input: None
+ *	output: None
+ *	side-effect: interrupts must be off; the caller holds the lock again,
+ *	             as deep as before, when it returns
+ */
+void kernel_relax() {
+  cpu_t* cpu;
+  uint32_t depth, i;
+
+  if (!smp_active) {
+    return;
+  }
+  cpu = this_cpu();
+  depth = cpu->lock_depth;
+  klock_free();
+  for (i = 0; i < KLOCK_RELAX_SPINS; i++) {
+    smp_poll(cpu);
+    asm volatile("pause" : : : "memory");
+  }
+  klock_acquire(cpu);
+  cpu->lock_depth = depth;
+}
+
+/*
+ *	Function: smp_flush_tlb
+ *	Description: TLB shootdown. Every other online cpu reloads cr3, and one
+ *	             that has dead_pd loaded goes to the kernel directory.
+ *	input: dead_pd -- directory about to be freed, NULL for a plain flush
+ *	output: None
+ *	side-effect: needs the kernel lock; waits until every cpu is done
+ */
+void smp_flush_tlb(uint32_t* dead_pd) {
+  cpu_t* self;
+  uint32_t i;
+
+  if (!smp_active) {
+    return;
+  }
+  self = this_cpu();
+  tlb_stats.shootdowns++;
+  smp_dead_pd = dead_pd;
+  for (i = 0; i < MAX_CPUS; i++) {
+    if (&cpus[i] != self && cpus[i].online) {
+      cpus[i].tlb_req = 1;
+      lapic_ipi(cpus[i].apic_id, LAPIC_ICR_FIXED | IPI_TLB_VEC);
+    }
+  }
+  for (i = 0; i < MAX_CPUS; i++) {
+    while (cpus[i].tlb_req) {
+      asm volatile("pause" : : : "memory");
+    }
+  }
+  smp_dead_pd = NULL;
+}
+
+/*
+ *	Function: smp_resched
+ *	Description: interrupt a cpu so it reschedules, for a thread queued on
+ *	             an idle cpu or a thread that has to die
+ *	input: cpu_id -- the cpu
+ *	output: None
+ *	side-effect: nothing for the calling cpu itself
+ */
+void smp_resched(uint32_t cpu_id) {
+  if (!smp_active || cpu_id >= MAX_CPUS || &cpus[cpu_id] == this_cpu() || !cpus[cpu_id].online) {
+    return;
+  }
+  lapic_ipi(cpus[cpu_id].apic_id, LAPIC_ICR_FIXED | IPI_RESCHED_VEC);
+}
+
+/*
+ *	Function: lapic_timer_handler
+ *	Description: scheduler and profiler tick of an application processor,
+ *	             the boot cpu gets its ticks from the PIT
+ *	input: frame -- the interrupted eip/cs/eflags
+ *	output: None
+ *	side-effect: may record a profiling sample and switch threads
+ */
+void lapic_timer_handler(intr_frame_t* frame) {
+  this_cpu()->ticks++;
+  lapic_eoi();
+  prof_tick(frame);
+  sched_tick(frame->cs);
+  sched_preempt(frame->cs);
+}
+
+/*
+ *	Function: smp_resched_handler
+ *	Description: the idle loop or kernel_exit does the work, the interrupt
+ *	             only has to arrive
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void smp_resched_handler() {
+  this_cpu()->ipis++;
+  lapic_eoi();
+}
+
+/*
+ *	Function: smp_tlb_handler
+ *	Description: serve a TLB shootdown without the kernel lock, the cpu
+ *	             that sent it holds the lock and waits for us
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void smp_tlb_handler() {
+  smp_poll(this_cpu());
+  lapic_eoi();
+}
+
+/*
+ *	Function: smp_kstat
+ *	Description: append one line per online cpu to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void smp_kstat() {
+  uint32_t i;
+
+  for (i = 0; i < MAX_CPUS; i++) {
+    if (i != 0 && !cpus[i].online) {
+      continue;
+    }
+    kstat_puts("cpu ");
+    kstat_putu(i);
+    kstat_puts(": apic ");
+    kstat_putu(cpus[i].apic_id);
+    kstat_puts(", switches ");
+    kstat_putu(cpus[i].switches);
+    kstat_puts(", ticks ");
+    kstat_putu(i == 0 ? pit_ticks : cpus[i].ticks);
+    kstat_puts(", idle halts ");
+    kstat_putu(cpus[i].idle_halts);
+    kstat_puts(", steals ");
+    kstat_putu(cpus[i].steals);
+    kstat_puts(", queued ");
+    kstat_putu(cpus[i].nr_queued);
+    kstat_puts("\n");
+  }
+}
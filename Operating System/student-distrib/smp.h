@@ -0,0 +1,111 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "x86_desc.h"
+#include "thread.h"
+#include "pit.h"
+
+#define MAX_CPUS          8
+
+/* MP floating pointer and configuration table (Intel MP spec 1.4) */
+#define MP_FLOAT_SIG      0x5F504D5F  /* "_MP_" */
+#define MP_CONFIG_SIG     0x504D4350  /* "PCMP" */
+#define MP_PROC           0
+#define MP_BUS            1
+#define MP_IOAPIC         2
+#define MP_IOINTR         3
+#define MP_LINTR          4
+#define MP_PROC_SIZE      20
+#define MP_ENTRY_SIZE     8
+#define MP_PROC_ENABLED   0x01
+#define MP_PROC_BSP       0x02
+#define MP_IMCR_PRESENT   0x80        /* feature byte 2: PIC mode, IMCR has to be switched */
+#define IMCR_SELECT       0x22
+#define IMCR_DATA         0x23
+#define IMCR_REG          0x70
+#define IMCR_APIC         0x01
+
+/* where the BIOS may keep the floating pointer */
+#define BIOS_EBDA_SCAN    0x0009F000
+#define BIOS_EBDA_END     0x000A0000
+#define BIOS_ROM_SCAN     0x000F0000
+#define BIOS_ROM_END      0x00100000
+#define MP_ALIGN          16
+
+/* real mode entry of the application processors, SIPI vector page */
+#define AP_TRAMPOLINE     0x00007000
+#define AP_BOOT_TIMEOUT   100         /* PIT ticks to wait for an AP */
+#define INIT_DELAY        10          /* PIT ticks between INIT and SIPI */
+#define SIPI_DELAY        1
+
+/* ticks of the kernel lock spin between dropping and retaking it */
+#define KLOCK_RELAX_SPINS 64
+
+typedef struct cpu {
+    seg_desc_t gdt[GDT_ENTRIES]; // first, so the GDTR base finds this cpu
+    x86_desc_t gdt_desc;
+    tss_t own_tss;
+    tss_t* tss;                 // own_tss, or the boot tss on cpu 0
+    uint32_t id;                // index in cpus[]
+    uint32_t apic_id;
+    volatile uint32_t online;
+    uint32_t lock_depth;        // nesting of kernel_enter on this cpu
+    uint32_t* page_dir;         // loaded in cr3
+    thread_t* curr;             // running thread
+    thread_t* idle;
+    thread_t* rq_head;          // run queue, threads ready to run here
+    thread_t* rq_tail;
+    uint32_t nr_queued;
+    uint32_t sched_ticks;       // timer ticks in the current quantum
+    uint32_t need_resched;      // preempt user mode on the way out of the interrupt
+    thread_t* fpu_owner;        // thread whose state is in this FPU
+    volatile uint32_t tlb_req;  // another cpu asked for a TLB flush
+    uint32_t ticks;             // timer interrupts
+    uint32_t switches;
+    uint32_t steals;            // threads taken from another run queue
+    uint32_t idle_halts;
+    uint32_t ipis;
+} __attribute__((aligned(8))) cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t smp_ncpus;
+/* set once the application processors may run, the kernel lock is
+ * only taken from then on */
+extern volatile uint32_t smp_active;
+
+/* find the other processors and start them, needs sched_init */
+void smp_init();
+/* the cpu we are running on */
+cpu_t* this_cpu();
+
+/* big kernel lock: every entry from user mode or idle takes it, nested
+ * entries on the same cpu only count */
+void kernel_enter();
+void kernel_exit();
+void kernel_lock();
+void kernel_release();
+void kernel_relax();
+
+/* make every other cpu flush its TLB, and leave dead_pd if it has it loaded */
+void smp_flush_tlb(uint32_t* dead_pd);
+/* poke a cpu so it looks at its run queue */
+void smp_resched(uint32_t cpu_id);
+
+/* interrupt handlers */
+void lapic_timer_handler(intr_frame_t* frame);
+void smp_resched_handler();
+void smp_tlb_handler();
+
+/* append one line per cpu to the kstat report */
+void smp_kstat();
+
+/* smp_boot.S */
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_gdtr[];
+extern uint8_t ap_cr3[];
+extern uint8_t ap_cr4[];
+extern uint8_t ap_esp[];
+
+#endif
@@ -0,0 +1,109 @@
+#include "spawn.h"
+#include "lib.h"
+#include "spinlock.h"
+#include "text_cache.h"
+#include "kstat.h"
+
+spawn_stats_t spawn_stats;
+
+static spawn_slot_t spawn_slots[SPAWN_SLOTS];
+static uint32_t spawn_clock;
+static spinlock_t spawn_lock = SPINLOCK_INIT("spawn");
+
+/*
+ *	Function: spawn_lookup
+ *	Description: find the snapshot of a program by file name
+ *	input: name -- the command, image -- filled in on a hit
+ *	output: 0 on a hit, -1 on a miss
+ *	side-effect: marks the snapshot recently used
+ */
+int32_t spawn_lookup(const int8_t* name, spawn_image_t* image) {
+  uint32_t i;
+  uint32_t flags;
+
+  spin_lock_irqsave(&spawn_lock, flags);
+  for (i = 0; i < SPAWN_SLOTS; i++) {
+    spawn_slot_t* slot = &spawn_slots[i];
+    if (slot->used && strncmp(slot->image.name, name, MAX_FILE_NAME_LEN + 1) == 0) {
+      memcpy(image, &slot->image, sizeof(spawn_image_t));
+      slot->stamp = ++spawn_clock;
+      slot->hits++;
+      spawn_stats.hits++;
+      spin_unlock_irqrestore(&spawn_lock, flags);
+      return 0;
+    }
+  }
+  spawn_stats.misses++;
+  spin_unlock_irqrestore(&spawn_lock, flags);
+  return -1;
+}
+
+/*
+ *	Function: spawn_insert
+ *	Description: keep a snapshot of a program execute just read from the
+ *	             file system, and pin its pages in the text cache
+ *	input: image -- the parsed program
+ *	output: None
+ *	side-effect: the least recently used snapshot and its pages may go
+ */
+void spawn_insert(const spawn_image_t* image) {
+  spawn_slot_t* victim = &spawn_slots[0];
+  uint32_t i, evicted = 0;
+  uint32_t flags;
+
+  spin_lock_irqsave(&spawn_lock, flags);
+  for (i = 0; i < SPAWN_SLOTS; i++) {
+    spawn_slot_t* slot = &spawn_slots[i];
+    if (slot->used && slot->image.inode == image->inode) {
+      spin_unlock_irqrestore(&spawn_lock, flags);
+      return;
+    }
+    if (!slot->used || (victim->used && slot->stamp < victim->stamp)) {
+      victim = slot;
+    }
+  }
+  if (victim->used) {
+    evicted = victim->image.inode;
+    spawn_stats.evictions++;
+  }
+  memcpy(&victim->image, image, sizeof(spawn_image_t));
+  victim->used = 1;
+  victim->hits = 0;
+  victim->stamp = ++spawn_clock;
+  spin_unlock_irqrestore(&spawn_lock, flags);
+  if (evicted != 0) {
+    text_cache_unpin(evicted);
+  }
+  text_cache_pin(image->inode);
+}
+
+/*
+ *	Function: spawn_kstat
+ *	Description: append the snapshot counters and table to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void spawn_kstat() {
+  uint32_t i;
+
+  kstat_puts("spawn: hits ");
+  kstat_putu(spawn_stats.hits);
+  kstat_puts(", misses ");
+  kstat_putu(spawn_stats.misses);
+  kstat_puts(", evictions ");
+  kstat_putu(spawn_stats.evictions);
+  kstat_puts("\n");
+  for (i = 0; i < SPAWN_SLOTS; i++) {
+    if (!spawn_slots[i].used) {
+      continue;
+    }
+    kstat_puts("  snapshot ");
+    kstat_puts(spawn_slots[i].image.name);
+    kstat_puts(": inode ");
+    kstat_putu(spawn_slots[i].image.inode);
+    kstat_puts(", hits ");
+    kstat_putu(spawn_slots[i].hits);
+    kstat_puts("\n");
+  }
+}
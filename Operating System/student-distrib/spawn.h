@@ -0,0 +1,44 @@
+#ifndef _SPAWN_H
+#define _SPAWN_H
+
+#include "types.h"
+#include "sys_call.h"
+#include "file_sys.h"
+
+/* snapshots of recently launched programs. A snapshot keeps what execute
+ * read from the ELF headers, and pins the program's pages in the text
+ * cache, so a launch that hits it does not touch the file system. */
+#define SPAWN_SLOTS 4
+
+typedef struct {
+    int8_t name[MAX_FILE_NAME_LEN + 1];
+    uint32_t inode;
+    seg_t segs[MAX_SEGS];
+    uint32_t num_segs;
+    uint32_t heap_start;
+    uint32_t entry;
+} spawn_image_t;
+
+typedef struct {
+    spawn_image_t image;
+    uint32_t used;              // slot holds a snapshot
+    uint32_t stamp;             // last launch, for LRU replacement
+    uint32_t hits;
+} spawn_slot_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} spawn_stats_t;
+
+extern spawn_stats_t spawn_stats;
+
+/* copy the snapshot of a program into image, -1 if there is none */
+int32_t spawn_lookup(const int8_t* name, spawn_image_t* image);
+/* remember a freshly loaded program, replacing the least recently used */
+void spawn_insert(const spawn_image_t* image);
+/* append the snapshot table to the kstat report */
+void spawn_kstat();
+
+#endif
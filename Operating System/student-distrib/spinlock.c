@@ -0,0 +1,78 @@
+#include "spinlock.h"
+#include "lib.h"
+#include "smp.h"
+#include "kstat.h"
+#include "klog.h"
+
+/*
+ *	Function: spin_lock_init
+ *	Description: set up a lock that was not statically initialized
+ *	input: lock -- the lock, name -- shown in debug reports
+ *	output: None
+ *	side-effect: none
+ */
+void spin_lock_init(spinlock_t* lock, const int8_t* name) {
+  lock->locked = 0;
+  lock->cpu = -1;
+  lock->name = name;
+}
+
+/*
+ *	Function: spin_lock
+ *	Description: spin until the lock is ours. Waits with plain reads so
+ *	             the cache line is not bounced by xchg while it is held.
+ *	input: lock -- the lock
+ *	output: None
+ *	side-effect: not recursive, taking a lock this cpu holds never returns
+ */
+void spin_lock(spinlock_t* lock) {
+  uint32_t old;
+
+  for (;;) {
+    old = 1;
+    asm volatile("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+    if (old == 0) {
+      break;
+    }
+#ifdef SPINLOCK_DEBUG
+    if (lock->cpu == (int32_t)this_cpu()->id) {
+      klog(KLOG_ERR, "spinlock: %s taken twice on cpu %u", lock->name, this_cpu()->id);
+    }
+#endif
+    while (lock->locked) {
+      asm volatile("pause" : : : "memory");
+    }
+  }
+  lock->cpu = this_cpu()->id;
+}
+
+/*
+ *	Function: spin_unlock
+ *	Description: release a lock taken by spin_lock
+ *	input: lock -- the lock
+ *	output: None
+ *	side-effect: none
+ */
+void spin_unlock(spinlock_t* lock) {
+  lock->cpu = -1;
+  asm volatile("" : : : "memory");
+  lock->locked = 0;
+}
+
+/*
+ *	Function: spin_trylock
+ *	Description: take the lock only if it is free
+ *	input: lock -- the lock
+ *	output: 0 if taken, -1 if held by someone else
+ *	side-effect: none
+ */
+int32_t spin_trylock(spinlock_t* lock) {
+  uint32_t old = 1;
+
+  asm volatile("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+  if (old != 0) {
+    return -1;
+  }
+  lock->cpu = this_cpu()->id;
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+
+/* uncomment to catch a cpu taking a lock it already holds */
+/* #define SPINLOCK_DEBUG */
+
+#define EFLAGS_IF         0x00000200
+
+typedef struct spinlock {
+    volatile uint32_t locked;
+    int32_t cpu;                // holder, -1 while free
+    const int8_t* name;
+} spinlock_t;
+
+#define SPINLOCK_INIT(lock_name)  { 0, -1, lock_name }
+
+void spin_lock_init(spinlock_t* lock, const int8_t* name);
+/* plain lock, for data no interrupt handler touches */
+void spin_lock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+/* 0 and the lock taken, -1 if someone holds it */
+int32_t spin_trylock(spinlock_t* lock);
+
+/* lock shared with an interrupt handler: interrupts stay off on this cpu
+ * until the matching spin_unlock_irqrestore, so keep the section short.
+ * Callers need lib.h for cli_and_save/restore_flags, which also feed the
+ * interrupt-off tracer. */
+#define spin_lock_irqsave(lock, flags)      \
+do {                                        \
+    cli_and_save(flags);                    \
+    spin_lock(lock);                        \
+} while (0)
+
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    restore_flags(flags);                   \
+} while (0)
+
+#endif
@@ -1,35 +1,151 @@
 #include "sys_call.h"
+#include "profile.h"
+#include "kstat.h"
+#include "clock.h"
+#include "irqtrace.h"
+#include "serial.h"
+#include "klog.h"
+#include "fpu.h"
+#include "smp.h"
+#include "text_cache.h"
+#include "spawn.h"
 
 /* initialize file operation table for system call read/write/open/close
  */
 
 uint8_t pid_array [6] = { 0,0,0,0,0,0 };
+/* taking and giving back slots of pid_array */
+static spinlock_t pid_lock = SPINLOCK_INIT("pid");
 file_op_table stdin_table = {terminal_read, fail_func, terminal_open, terminal_close};
 file_op_table stdout_table = {fail_func, terminal_write, terminal_open, terminal_close};
 file_op_table rtc_table = {rtc_read, rtc_write, rtc_opener, rtc_closer};
 file_op_table dir_table = {directory_read, directory_write, directory_open, directory_close};
 file_op_table file_table = {file_read, file_write, file_open, file_close};
 file_op_table null_table = {fail_func, fail_func, fail_func, fail_func};
+file_op_table kstat_table = {kstat_read, kstat_write, kstat_open, kstat_close};
+file_op_table irqtrace_table = {irqtrace_read, irqtrace_write, irqtrace_open, irqtrace_close};
+file_op_table serial_table = {serial_read, serial_write, serial_open, serial_close};
+file_op_table klog_table = {klog_read, klog_write, klog_open, klog_close};
+
+/* kernel devices that have no entry in the file system image */
+typedef struct {
+	const int8_t* name;
+	file_op_table* ops;
+} device_t;
+
+static device_t devices[] = {
+	{ "kstat", &kstat_table },
+	{ "irqtrace", &irqtrace_table },
+	{ "serial", &serial_table },
+	{ "klog", &klog_table },
+};
+#define NUM_DEVICES (sizeof(devices) / sizeof(devices[0]))
+
+static exec_lat_t exec_lat[EXEC_LAT_SLOTS][EXEC_LAT_KINDS];
+static kmem_cache_t* fd_cache;
+
+/*	sys_call_init
+ * 	description: create the caches processes are built from
+ * 	input: none
+ * 	output: none
+ * 	side effect: needs slab_init
+*/
+void sys_call_init() {
+	fd_cache = kmem_cache_create("fd table", sizeof(file_des_t) * (MAX_FD + 1));
+}
 volatile uint32_t global_status;
 
-/*	system call execute
- *	description: execute the input command
+/*	exec_load
+ *	description: read the ELF headers of a program and collect its
+ *			loadable segments, demand_page fills them in on first touch
+ * 	input: name -- the file, image -- filled in
+ * 	output: 0 on success, -1 if the file is missing or not executable
+ * 	side effect: none
+ */
+static int32_t exec_load(const uint8_t* name, spawn_image_t* image) {
+	int i;
+	dentry_t dentry;
+	elf_hdr_t ehdr;
+	elf_phdr_t phdr;
+	uint8_t magic[BUFFER_SIZE] = {0x7f, 0x45, 0x4c, 0x46};
+
+	//read command
+	if (read_dentry_by_name(name, &dentry) != 0) {
+		// printf("read dentry fail in execute ");
+		global_status = -1;
+		return -1;
+	}
+	if (read_data(dentry.inode_num, 0, (char*)&ehdr, sizeof(ehdr)) != sizeof(ehdr)) {
+		return -1;
+	}
+	//check validality
+	for (i = 0; i < BUFFER_SIZE; i++) {
+		if (ehdr.ident[i] != magic[i]) {
+			// printf("file not executable ");
+			return -1;
+		}
+	}
+	if (ehdr.phnum > ELF_MAX_PHDR || ehdr.phentsize < sizeof(phdr)) {
+		return -1;
+	}
+	strncpy(image->name, (const int8_t*)name, MAX_FILE_NAME_LEN);
+	image->name[MAX_FILE_NAME_LEN] = '\0';
+	image->inode = dentry.inode_num;
+	image->num_segs = 0;
+	image->heap_start = _128MB;
+	for (i = 0; i < ehdr.phnum; i++) {
+		seg_t* seg = &image->segs[image->num_segs];
+		if (read_data(dentry.inode_num, ehdr.phoff + i * ehdr.phentsize, (char*)&phdr, sizeof(phdr)) != sizeof(phdr)) {
+			return -1;
+		}
+		if (phdr.type != PT_LOAD) {
+			continue;
+		}
+		// the segment has to fit below the heap limit
+		if (image->num_segs == MAX_SEGS || phdr.filesz > phdr.memsz || phdr.vaddr < _128MB ||
+			phdr.memsz > _4MB || phdr.vaddr + phdr.memsz > USER_HEAP_MAX) {
+			return -1;
+		}
+		seg->vaddr = phdr.vaddr;
+		seg->memsz = phdr.memsz;
+		seg->filesz = phdr.filesz;
+		seg->offset = phdr.offset;
+		seg->flags = phdr.flags;
+		image->num_segs++;
+		if (phdr.vaddr + phdr.memsz > image->heap_start) {
+			image->heap_start = phdr.vaddr + phdr.memsz;
+		}
+	}
+	image->heap_start = (image->heap_start + _4KB - 1) & ADDR_MASK;
+	//read entry point
+	image->entry = ehdr.entry;
+	if (image->num_segs == 0 || image->entry < _128MB || image->entry >= USER_END) {
+		return -1;
+	}
+	return 0;
+}
+
+/*	exec_process
+ *	description: load a program and switch to it; the caller waits in
+ *			here until it halts
  * 	input: command -- the command to be executed
+ * 			root_term -- NULL for a child of the calling process on its
+ * 			terminal, otherwise the terminal of a new root process
  * 	output: iret if successful, -1 if something goes wrong
  * 	side effect: execute the program
  */
-int32_t execute(const uint8_t* command) {
+static int32_t exec_process(const uint8_t* command, term_t* root_term) {
     // cli(); //disable interrupt
 	if (command == NULL) return -1;
 	int i;
 	uint8_t argument_buf[100];
 	uint8_t parse_cmd[10];
 	uint8_t cmd_start, cmd_end;
-	dentry_t dentry;
-	char buffer[BUFFER_SIZE];
-	uint32_t entry;
-	uint8_t magic[BUFFER_SIZE] = {0x7f, 0x45, 0x4c, 0x46};
+	spawn_image_t image;
+	uint32_t hot;
 	uint32_t v_addr = KERNEL_DSP;
+	uint64_t exec_tsc = rdtsc();
+	uint32_t flags;
 
 	// parsing the command
 	cmd_end = cmd_start = 0;
@@ -49,8 +165,8 @@ int32_t execute(const uint8_t* command) {
 	}
 	parse_cmd[cmd_end] = '\0';
 
-	// argument
-	cmd_start = cmd_end+1;
+	// argument, do not read past the end of a command without one
+	cmd_start = (command[cmd_end] == '\0') ? cmd_end : cmd_end+1;
 	cmd_end = cmd_start;
 	// argument ending position
 	while(command[cmd_end] != ' ' && command[cmd_end] != 0x0A && command[cmd_end] != '\0') {
@@ -62,42 +178,54 @@ int32_t execute(const uint8_t* command) {
 	}
 	argument_buf[cmd_end-cmd_start] = '\0';
 
-	//read command
-	if (read_dentry_by_name((uint8_t*)parse_cmd, &dentry) != 0) {
-		// printf("read dentry fail in execute ");
-		global_status = -1;
-		return -1;
-	}
-	read_data(dentry.inode_num, 0, buffer, BUFFER_SIZE);
-	//check validality
-	for (i = 0; i < BUFFER_SIZE; i++) {
-		if (buffer[i] != magic[i]) {
-			// printf("file not executable ");
+	// a snapshot of the program spares the file system entirely
+	hot = (spawn_lookup((int8_t*)parse_cmd, &image) == 0);
+	if (!hot) {
+		if (exec_load(parse_cmd, &image) != 0) {
 			return -1;
 		}
+		spawn_insert(&image);
+	}
+
+	// only a main thread may start a child, it waits for it on its stack
+	thread_t* cur_thread = get_cur_thread();
+	if (root_term == NULL && !thread_is_main(cur_thread)) {
+		return -1;
 	}
-	//read entry point
-	read_data(dentry.inode_num, 24, buffer, BUFFER_SIZE);
-	entry = *((uint32_t*)buffer);
 
-	int new_pid;
+	int new_pid = -1;
 	// find a new place to process
+	spin_lock_irqsave(&pid_lock, flags);
     for (i = 0; i <= MAX_PID; i++) {
         if (pid_array[i] == 0) {
         	pid_array[i] = 1;
         	new_pid = i;
         	break;
-        }
-		// check if too many process are activate
-        if (i == MAX_PID) {
-			printf("too many programs activate, exit before contiune ");
-        	return -1;
         }
     }
+	spin_unlock_irqrestore(&pid_lock, flags);
+	// check if too many process are activate
+	if (new_pid < 0) {
+		klog(KLOG_WARN, "too many programs activate, exit before contiune");
+		return -1;
+	}
 
     //Set pcb to correct location
     pcb_t* new_pcb = get_cur_pcb_process(new_pid);
 
+	// give the process its own address space
+	uint32_t* new_pd = page_dir_create();
+	if (new_pd == NULL) {
+		pid_array[new_pid] = 0;
+		return -1;
+	}
+	file_des_t* new_fda = (file_des_t*)kmem_cache_alloc(fd_cache);
+	if (new_fda == NULL) {
+		page_dir_destroy(new_pd);
+		pid_array[new_pid] = 0;
+		return -1;
+	}
+
     //Store current stack values
 	asm volatile("			\n\
 				movl %%ebp, %%eax 	\n\
@@ -105,24 +233,32 @@ int32_t execute(const uint8_t* command) {
 			"
 			:"=a"(new_pcb->parent_kbp_val), "=b"(new_pcb->parent_ksp_val));
 
-	// Set the new page for the process
-	repage(_128MB, _8MB + new_pid * _4MB);
-
-	// Load the program into memory
-	read_data(dentry.inode_num, 0, (char*)LOAD_ADDR, RANDOM_NUM);
+	// Switch to the new address space, its pages are mapped by demand_page
+	load_page_directory(new_pd);
 
 	// set up PCB info
 	new_pcb->process_num = new_pid;
+	new_pcb->exe_inode = image.inode;
+	new_pcb->page_dir = new_pd;
+	memcpy(new_pcb->segs, image.segs, sizeof(image.segs));
+	new_pcb->num_segs = image.num_segs;
+	new_pcb->exec_tsc = exec_tsc;
+	new_pcb->exec_hot = hot;
+	new_pcb->heap_start = image.heap_start;
+	new_pcb->brk = image.heap_start;
+	new_pcb->vidmapped = 0;
+	new_pcb->vid_back = NULL;
 	strcpy((int8_t*)(new_pcb->arg_buf), (int8_t*)argument_buf);
 
-	// set up parent info
-	if (new_pid == 0) {
-		new_pcb->parent_process_num = 0;
+	// set up parent info, a root process is its own parent
+	if (root_term != NULL) {
+		new_pcb->parent_process_num = new_pid;
 	} else {
-		new_pcb->parent_process_num = ((pcb_t*)(new_pcb->parent_ksp_val & PCB_MASK))->process_num;
+		new_pcb->parent_process_num = ((thread_t*)(new_pcb->parent_ksp_val & PCB_MASK))->pcb->process_num;
 	}
 
 	//Set up FD array
+	new_pcb->fda = new_fda;
 	for (i = 0; i <= MAX_FD; i++) {
 		new_pcb->fda[i].jumptable = null_table;
 		new_pcb->fda[i].inode = -1;
@@ -135,20 +271,59 @@ int32_t execute(const uint8_t* command) {
 	new_pcb->fda[0].flags = 1;
 	new_pcb->fda[1].flags = 1;
 
-	// set term in pcb
-	new_pcb->term = &terms[current_term_id];
+	// set term in pcb: a program runs on its parent's terminal, a root
+	// shell on the one it was started for
+	if (root_term != NULL) {
+		new_pcb->term = root_term;
+	} else {
+		new_pcb->term = get_cur_pcb_process(new_pcb->parent_process_num)->term;
+	}
 	// update term process num to be the current process num
-	terms[current_term_id].active_process_num = new_pcb->process_num;
+	new_pcb->term->active_process_num = new_pcb->process_num;
+	prof_note_exec(new_pid, image.inode);
+	// the caller sleeps in execute, the child's main thread takes over
+	cur_thread->state = THREAD_EXEC;
+	new_pcb->thread.state = THREAD_RUNNABLE;
+	new_pcb->thread.joiner = NULL;
+	new_pcb->thread.edf_jobs = 0;
+	new_pcb->thread.edf_misses = 0;
+	threads[new_pid] = &new_pcb->thread;
 	// content switch
-  	tss.ss0 = KERNEL_DS;
-  	tss.esp0 = _8MB - _8KB * (new_pid) - 4;
+	cli();
+	thread_handoff(&new_pcb->thread);
+	kernel_release();
 	sti();
 	// do the "artificial iret"
-    EXEC_TO_USER(USER_DS, v_addr, USER_CS, entry);
+    EXEC_TO_USER(USER_DS, v_addr, USER_CS, image.entry);
 	global_status = 0;
 	return global_status;
 }
 
+/*	system call execute
+ *	description: execute the input command as a child of the caller
+ * 	input: command -- the command to be executed
+ * 	output: iret if successful, -1 if something goes wrong
+ * 	side effect: execute the program
+ */
+int32_t execute(const uint8_t* command) {
+	return exec_process(command, NULL);
+}
+
+/*	execute_root
+ *	description: start the first program of a terminal. It has no parent
+ *			process; when it halts, another one takes its place.
+ * 	input: command -- the command to be executed, term -- its terminal
+ * 	output: does not return if successful, -1 if something goes wrong
+ * 	side effect: the calling thread waits in here for good, it must not
+ * 			belong to a user process
+ */
+int32_t execute_root(const uint8_t* command, term_t* term) {
+	if (term == NULL) {
+		return -1;
+	}
+	return exec_process(command, term);
+}
+
 /*	system call halt
  *	description: halt the program
  * 	input: status -- the status of the program
@@ -157,14 +332,18 @@ int32_t execute(const uint8_t* command) {
  */
 int32_t halt(uint8_t status) {
 	int i;
+	uint32_t flags;
 
-	cli();
+	// clone and kernel threads only end themselves
+	if (!thread_is_main(get_cur_thread())) {
+		thread_exit(status);
+	}
 	global_status = status + 1;
     /* Get current and parent PCB */
     pcb_t* cur_pcb = get_cur_pcb();
     pcb_t* parent_pcb = get_cur_pcb_process(cur_pcb->parent_process_num);
-	/* close it in pid */
-    pid_array[(uint8_t)cur_pcb->process_num] = 0;
+	/* the other threads share the files and address space going away */
+	thread_reap_process(cur_pcb);
     /* set all flags in PCB to not in use */
  	for (i = 0; i < MAX_FD; i++)
  	{
@@ -174,15 +353,36 @@ int32_t halt(uint8_t status) {
 		cur_pcb->fda[i].jumptable = null_table;
  		cur_pcb->fda[i].flags = 0;
  	}
+	kmem_cache_free(fd_cache, cur_pcb->fda);
+	cur_pcb->fda = NULL;
+	if (cur_pcb->vidmapped) {
+		spin_lock_irqsave(&term_lock, flags);
+		vga_flip_cancel(&cur_pcb->term->con, cur_pcb->vid_back);
+		vga_unpin(&cur_pcb->term->con);
+		spin_unlock_irqrestore(&term_lock, flags);
+	}
+	fpu_release(&cur_pcb->thread);
+	sched_set_deadline(&cur_pcb->thread, 0, 0);
+	/* leave the address space before freeing it */
+	load_page_directory(page_directory);
+	page_dir_destroy(cur_pcb->page_dir);
+	/* interrupts stay off from here until the parent's context is back */
+	cli();
+	cur_pcb->thread.state = THREAD_FREE;
+	threads[cur_pcb->process_num] = NULL;
+	/* close it in pid, the slot and this stack may be reused from now on */
+	spin_lock(&pid_lock);
+    pid_array[(uint8_t)cur_pcb->process_num] = 0;
+	spin_unlock(&pid_lock);
 	/* if halting the last program, execute shell to prevent page fault */
 	if (cur_pcb->process_num == cur_pcb->parent_process_num )
 	{
-		execute((uint8_t*)"shell");
+		execute_root((uint8_t*)"shell", cur_pcb->term);
 	}
-    /* repage */
-    repage(_128MB, _8MB + parent_pcb->process_num * _4MB);
-    /** set esp0 in tss */
-	tss.esp0 = cur_pcb->parent_ksp_val;
+    /* wake the thread waiting in execute and switch back to its address space */
+    ((thread_t*)(cur_pcb->parent_ksp_val & PCB_MASK))->state = THREAD_RUNNABLE;
+    thread_handoff((thread_t*)(cur_pcb->parent_ksp_val & PCB_MASK));
+    load_page_directory(parent_pcb->page_dir);
 	sti();
     /* Return from iret */
     asm volatile(
@@ -254,8 +454,27 @@ int32_t open(const uint8_t* filename) {
 		return -1;
 	}
 	uint16_t fd_idx;
+	uint32_t i;
 	pcb_t *pcb = get_cur_pcb();
 	dentry_t file_dir_entry;
+	// kernel devices are not in the file system
+	for (i = 0; i < NUM_DEVICES; i++) {
+		if (strncmp((int8_t*)filename, devices[i].name, MAX_FILE_NAME_LEN) != 0) {
+			continue;
+		}
+		for (fd_idx = MIN_FD; fd_idx <= MAX_FD; fd_idx++) {
+			if (pcb->fda[fd_idx].flags == 0) {
+				if (devices[i].ops->open(filename) != 0)
+					return -1;
+				pcb->fda[fd_idx].flags = 1;
+				pcb->fda[fd_idx].file_position = 0;
+				pcb->fda[fd_idx].inode = -1;
+				pcb->fda[fd_idx].jumptable = *devices[i].ops;
+				return fd_idx;
+			}
+		}
+		return -1;
+	}
 	// check file name
 	if (read_dentry_by_name(filename, &file_dir_entry) == -1)
 	{
@@ -288,8 +507,8 @@ int32_t open(const uint8_t* filename) {
 		else if(file_dir_entry.file_type == RTC_FILE_TYPE) {
 			if (0 != rtc_opener(filename))
 				return -1;
-			pcb->fda[fd_idx].inode = NULL;
 			pcb->fda[fd_idx].jumptable = rtc_table;
+			rtc_fd_init(fd_idx);
 		}
 	return fd_idx;
 }
@@ -342,19 +561,321 @@ int32_t getargs (uint8_t* buf, int32_t nbytes) {
  * 	description: maps the text-mode video memory into user spae
  * 	input: screen_start -- start address of the screen
  * 	output: 136MB always
- * 	side effect: set up a new page
+ * 	side effect: set up a new page; the screen stays at the start of the
+ * 			terminal's slot, without hardware scrolling, until the process halts
 */
 int32_t vidmap(uint8_t ** screen_start){
+	pcb_t* pcb = get_cur_pcb();
+	uint32_t flags;
+
 	/* Map Virtual Address to Physical Address */
 	if (screen_start == NULL || screen_start == (uint8_t**)_128MB)
 	{
 		return -1;
 	}
-	set_up_map((uint32_t)_136MB, (uint32_t)VIDEO);
+	/* its own terminal's slot, on the screen or not, unless vidflip
+	 * has put the back page there */
+	if (pcb->vid_back == NULL && set_up_map((uint32_t)_136MB, vga_page(&pcb->term->con)) != 0) {
+		return -1;
+	}
+	if (!pcb->vidmapped) {
+		pcb->vidmapped = 1;
+		spin_lock_irqsave(&term_lock, flags);
+		vga_pin(&pcb->term->con);
+		if (pcb->term->id == current_term_id) {
+			update_cursor(get_x(), get_y());
+		}
+		spin_unlock_irqrestore(&term_lock, flags);
+	}
 	*screen_start = (uint8_t*)_136MB;
 	return _136MB;
 }
 
+/*	system call vidflip
+ * 	description: double-buffered vidmap. The first call moves 136MB from
+ * 			the screen to a private back page holding a copy of it, so
+ * 			drawing touches cached memory only. Each later call has the
+ * 			next rtc tick copy the back page onto the screen in one go;
+ * 			the back page keeps the frame, so the program may redraw only
+ * 			what changed.
+ * 	input: none
+ * 	output: 0, -1 without vidmap, memory, or while another thread of the
+ * 			terminal has a frame queued
+ * 	side effect: blocks until the frame is on the screen, at most one rtc tick
+*/
+int32_t vidflip(void) {
+	pcb_t* pcb = get_cur_pcb();
+	thread_t* cur = get_cur_thread();
+	vga_con_t* con = &pcb->term->con;
+	uint16_t* back;
+	uint32_t flags;
+
+	if (!pcb->vidmapped) {
+		return -1;
+	}
+	if (pcb->vid_back == NULL) {
+		back = (uint16_t*)page_alloc();
+		if (back == NULL) {
+			return -1;
+		}
+		spin_lock_irqsave(&term_lock, flags);
+		memcpy(back, vga_screen(con), VGA_FRAME_BYTES);
+		spin_unlock_irqrestore(&term_lock, flags);
+		/* owned, so the frame goes with the address space */
+		if (map_virt_to_phys(pcb->page_dir, _136MB, (uint32_t)back, USER_MASK | PAGE_OWNED) != 0) {
+			page_free(back);
+			return -1;
+		}
+		pcb->vid_back = back;
+		return 0;
+	}
+	cli_and_save(flags);
+	if (vga_flip_queue(con, pcb->vid_back, cur) == -1) {
+		restore_flags(flags);
+		return -1;
+	}
+	while (con->flip_waiter == cur) {
+		thread_block();
+	}
+	restore_flags(flags);
+	return 0;
+}
+
+/*	user_addr_valid
+ * 	description: check that an address is in a segment, the heap or the
+ * 			stack of a process
+ * 	input: pcb -- the process, addr -- user address
+ * 	output: 1 if the process may touch addr, 0 otherwise
+ * 	side effect: none
+*/
+static int32_t user_addr_valid(pcb_t* pcb, uint32_t addr) {
+	uint32_t i;
+
+	if (addr >= USER_HEAP_MAX && addr < USER_END) {
+		return 1;
+	}
+	if (addr >= pcb->heap_start && addr < pcb->brk) {
+		return 1;
+	}
+	for (i = 0; i < pcb->num_segs; i++) {
+		if (addr >= pcb->segs[i].vaddr && addr < pcb->segs[i].vaddr + pcb->segs[i].memsz) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*	page_is_text
+ * 	description: whether a user page holds only read-only segments, so one
+ * 			copy can serve every process running the program
+ * 	input: pcb -- the process, page -- page aligned user address
+ * 	output: 1 if the page can be shared, 0 otherwise
+ * 	side effect: none
+*/
+static int32_t page_is_text(pcb_t* pcb, uint32_t page) {
+	uint32_t i, text = 0;
+
+	for (i = 0; i < pcb->num_segs; i++) {
+		seg_t* seg = &pcb->segs[i];
+		if (seg->vaddr >= page + _4KB || seg->vaddr + seg->memsz <= page) {
+			continue;
+		}
+		if (seg->flags & PF_W) {
+			return 0;
+		}
+		text = 1;
+	}
+	return text;
+}
+
+/*	demand_page
+ * 	description: back the page holding a faulting user address with a new
+ * 			frame. The frame starts zeroed and then gets whatever part of
+ * 			the executable's segments falls inside it, so .bss, the heap
+ * 			and the stack come out zero-filled.
+ * 	input: addr -- faulting address (cr2)
+ * 	output: 0 if the page was filled, -1 if the fault is a real error
+ * 	side effect: maps a 4kb page of the process in its page directory
+*/
+int32_t demand_page(uint32_t addr) {
+	pcb_t* pcb = get_cur_pcb();
+	uint32_t page = addr & ADDR_MASK;
+	uint32_t i, start, end;
+	int32_t shared, filled;
+	void* frame;
+
+	// only the address space of the process that owns this kernel stack
+	if (pcb == NULL || pcb->process_num > MAX_PID || pid_array[pcb->process_num] == 0 || pcb->page_dir != get_cur_page_dir()) {
+		return -1;
+	}
+	if (!user_addr_valid(pcb, addr)) {
+		return -1;
+	}
+	// read-only pages of the program are shared with its other instances
+	shared = page_is_text(pcb, page);
+	frame = shared ? (void*)text_page_get(pcb->exe_inode, page) : NULL;
+	if (frame == NULL) {
+		frame = page_alloc();
+		if (frame == NULL) {
+			return -1;
+		}
+		// fill it through the direct map, it is not visible to user mode yet.
+		// Writable pages of a program with a spawn snapshot come from its template.
+		if (shared || text_template_copy(pcb->exe_inode, page, frame) != 0) {
+			filled = 0;
+			for (i = 0; i < pcb->num_segs; i++) {
+				seg_t* seg = &pcb->segs[i];
+				start = (seg->vaddr > page) ? seg->vaddr : page;
+				end = (seg->vaddr + seg->filesz < page + _4KB) ? seg->vaddr + seg->filesz : page + _4KB;
+				if (start < end) {
+					read_data(pcb->exe_inode, seg->offset + (start - seg->vaddr), (char*)frame + (start - page), end - start);
+					filled = 1;
+				}
+			}
+			if (!shared && filled) {
+				text_template_save(pcb->exe_inode, page, frame);
+			}
+		}
+		if (shared) {
+			frame = (void*)text_page_add(pcb->exe_inode, page, (uint32_t)frame);
+			if (frame == NULL) {
+				return -1;
+			}
+		}
+	}
+	if (shared) {
+		if (map_virt_to_phys(get_cur_page_dir(), page, (uint32_t)frame, USER_RO_MASK | PAGE_SHARED) != 0) {
+			text_page_put((uint32_t)frame);
+			return -1;
+		}
+	} else if (map_virt_to_phys(get_cur_page_dir(), page, (uint32_t)frame, USER_MASK | PAGE_OWNED) != 0) {
+		page_free(frame);
+		return -1;
+	}
+	// the first fault of a new process is the fetch of its first instruction
+	if (pcb->exec_tsc != 0) {
+		uint32_t cycles = (uint32_t)(rdtsc() - pcb->exec_tsc);
+		if (pcb->exe_inode < EXEC_LAT_SLOTS) {
+			exec_lat_t* lat = &exec_lat[pcb->exe_inode][pcb->exec_hot ? EXEC_LAT_HOT : EXEC_LAT_COLD];
+			if (lat->count == 0 || cycles < lat->min) {
+				lat->min = cycles;
+			}
+			lat->last = cycles;
+			lat->count++;
+		}
+		pcb->exec_tsc = 0;
+	}
+	return 0;
+}
+
+/*	exec_kstat
+ * 	description: append the exec-to-first-instruction latency of every
+ * 			executable run so far to the kstat report, launches read
+ * 			from the file system (cold) apart from spawn snapshot hits (hot)
+ * 	input: none
+ * 	output: none
+ * 	side effect: none
+*/
+void exec_kstat() {
+	dentry_t dentry;
+	int8_t name[MAX_FILE_NAME_LEN + 1];
+	uint32_t i, kind;
+
+	for (i = 0; read_dentry_by_index(i, &dentry) == 0; i++) {
+		if (dentry.file_type != REGULAR_FILE_TYPE || dentry.inode_num >= EXEC_LAT_SLOTS) {
+			continue;
+		}
+		for (kind = 0; kind < EXEC_LAT_KINDS; kind++) {
+			exec_lat_t* lat = &exec_lat[dentry.inode_num][kind];
+			if (lat->count == 0) {
+				continue;
+			}
+			strncpy(name, dentry.file_name, MAX_FILE_NAME_LEN);
+			name[MAX_FILE_NAME_LEN] = '\0';
+			kstat_puts("exec latency ");
+			kstat_puts(name);
+			kstat_puts(kind == EXEC_LAT_HOT ? " (hot)" : " (cold)");
+			kstat_puts(": last ");
+			kstat_putu(lat->last);
+			kstat_puts(", min ");
+			kstat_putu(lat->min);
+			kstat_puts(" cycles (");
+			kstat_putu((uint32_t)cycles_to_ns(lat->min) / NS_PER_US);
+			kstat_puts(" us) over ");
+			kstat_putu(lat->count);
+			kstat_puts(" runs\n");
+		}
+	}
+}
+
+/*	system call sbrk
+ * 	description: move the end of the heap. Growing only moves the break,
+ * 			the pages are mapped when first touched; pages left entirely
+ * 			above a lowered break are freed.
+ * 	input: increment -- bytes to add to the heap, may be negative
+ * 	output: the old break, -1 if the heap can not be resized
+ * 	side effect: none
+*/
+int32_t sbrk(int32_t increment) {
+	pcb_t* pcb = get_cur_pcb();
+	uint32_t old_brk, new_brk;
+	uint32_t page;
+
+	if (pcb == NULL || pcb->process_num > MAX_PID || pid_array[pcb->process_num] == 0 || pcb->page_dir != get_cur_page_dir()) {
+		return -1;
+	}
+	old_brk = pcb->brk;
+	new_brk = old_brk + increment;
+	if ((increment > 0 && new_brk < old_brk) || (increment < 0 && new_brk > old_brk) ||
+		new_brk < pcb->heap_start || new_brk > USER_HEAP_MAX) {
+		return -1;
+	}
+	for (page = (new_brk + _4KB - 1) & ADDR_MASK; page < old_brk; page += _4KB) {
+		unmap_user_page(page);
+	}
+	pcb->brk = new_brk;
+	return (int32_t)old_brk;
+}
+
+/*	system call clone
+ * 	description: start another thread in the calling process. It shares
+ * 			the address space and open files and starts at entry as if
+ * 			called with arg, on the given user stack.
+ * 	input: entry -- thread function, it must end with halt instead of
+ * 			returning; stack -- top of the thread's user stack; arg
+ * 	output: thread id for join, -1 on failure
+ * 	side effect: writes arg and a null return address below stack
+*/
+int32_t clone(void* entry, void* stack, void* arg) {
+	pcb_t* pcb = get_cur_pcb();
+	uint32_t* sp = (uint32_t*)(((uint32_t)stack & ~0x3) - 2 * sizeof(uint32_t));
+
+	if (pcb == NULL || pcb->process_num > MAX_PID || pid_array[pcb->process_num] == 0) {
+		return -1;
+	}
+	if ((uint32_t)stack > USER_END || (uint32_t)sp < _128MB || !user_addr_valid(pcb, (uint32_t)entry) ||
+		!user_addr_valid(pcb, (uint32_t)sp) || !user_addr_valid(pcb, (uint32_t)(sp + 1))) {
+		return -1;
+	}
+	sp[0] = 0;
+	sp[1] = (uint32_t)arg;
+	return thread_clone((uint32_t)entry, (uint32_t)sp);
+}
+
+/*	system call join
+ * 	description: wait for a thread started by clone to halt
+ * 	input: tid -- value returned by clone
+ * 	output: the status the thread halted with, -1 if tid is not a thread
+ * 			of this process
+ * 	side effect: the thread id can be reused afterwards
+*/
+int32_t join(int32_t tid) {
+	if (tid < 0) {
+		return -1;
+	}
+	return thread_join(tid);
+}
+
 // for extra credit
 int32_t set_handler(int32_t signum, void* handler_address) {
 	return -1;
@@ -393,14 +914,6 @@ int32_t fail_func() {
  * 	side effect: none
  */
 pcb_t* get_cur_pcb(){
-	pcb_t* pcb;
-	//Mask the value to the correct 8KB range
-	asm volatile("				   \n\
-				andl %%esp, %%eax  \n\
-				"
-				:"=a"(pcb)
-				:"a"(PCB_MASK)
-				:"cc"
-				);
-	return pcb;
+	// the thread header at the bottom of the 8KB stack knows its process
+	return get_cur_thread()->pcb;
 };
@@ -9,6 +9,8 @@
 #include "rtc_handler.h"
 #include "paging.h"
 #include "x86_desc.h"
+#include "slab.h"
+#include "thread.h"
 #define _100MB 0x6400000
 #define _128MB 0x8000000
 #define _136MB 0x8800000
@@ -30,25 +32,83 @@
 #define MAX_FD		7
 #define FILE_START 0x0000
 #define KERNEL_DSP 0x83FFFFC
-#define RANDOM_NUM 50000
+#define ELF_MAX_PHDR 8
+#define PT_LOAD 1
+#define PF_W 0x2
+#define MAX_SEGS 4
+#define EXEC_LAT_SLOTS 64
+#define EXEC_LAT_KINDS 2
+#define EXEC_LAT_COLD 0
+#define EXEC_LAT_HOT 1
+/* user space is 128MB-132MB: program and heap from the bottom, the stack
+ * (at most USER_STACK_MAX) from the top, all 4kb pages mapped on demand */
+#define USER_END 0x8400000
+#define USER_STACK_MAX 0x100000
+#define USER_HEAP_MAX (USER_END - USER_STACK_MAX)
 #define PCB_MASK 0xFFFFE000
 /* system call functions */
 void EXEC_TO_USER(uint32_t ds,uint32_t v_addr,uint32_t cs, uint32_t ent);
 // void IRET_RETURN(uint32_t status, uint32_t parent_ksp, uint32_t parent_kbp);
 
 int32_t execute(const uint8_t* command);
+/* first program of a terminal, from the boot code or a kernel thread */
+int32_t execute_root(const uint8_t* command, term_t* term);
 int32_t halt(uint8_t status);
 int32_t read(int32_t fd, void* buf, int32_t nBytes);
 int32_t write(int32_t fd, const void* buf, int32_t nBytes);
 int32_t vidmap(uint8_t ** screen_start);
+int32_t vidflip(void);
 int32_t open(const uint8_t* filename);
 int32_t getargs (uint8_t* buf, int32_t nbytes);
 int32_t set_handler(int32_t signum, void* handler_address);
 int32_t sigreturn(void);
+int32_t sbrk(int32_t increment);
+int32_t clone(void* entry, void* stack, void* arg);
+int32_t join(int32_t tid);
 int32_t close(int32_t fd);
 int32_t fail_func();
+void sys_call_init();
 #define PCB_MASK 0xFFFFE000
 
+/* ELF file header */
+typedef struct {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} elf_hdr_t;
+
+/* ELF program header */
+typedef struct {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} elf_phdr_t;
+
+/* loadable segment, filled in page by page on first touch */
+typedef struct {
+    uint32_t vaddr;
+    uint32_t memsz;
+    uint32_t filesz;
+    uint32_t offset;
+    uint32_t flags;             // PF_* of the program header
+} seg_t;
+
 /* file operation table structure */
 typedef struct {
   int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
@@ -63,11 +123,14 @@ typedef struct {
     int32_t inode;
     int32_t file_position;
     int32_t flags;
+    uint32_t rtc_div;           // rtc: hardware ticks per virtual tick
+    uint32_t rtc_next;          // rtc: hardware tick of the next virtual tick
 } file_des_t;
 
-/* pcb structure */
-typedef struct {
-    file_des_t fda[8];          // file desc array
+/* pcb structure, the main thread's header has to come first */
+typedef struct pcb {
+    thread_t thread;            // main thread, at the bottom of its kernel stack
+    file_des_t * fda;           // file desc array, MAX_FD + 1 entries from fd_cache
     uint8_t arg_buf[100];        // arg buf
     uint32_t esp_val;           // esp reg value
     uint32_t ebp_val;           // ebp reg value
@@ -75,10 +138,29 @@ typedef struct {
 	  uint32_t parent_kbp_val;
     uint8_t process_num;
 	  uint8_t parent_process_num;
+    uint32_t exe_inode;          // inode of the running executable
+    uint32_t * page_dir;         // page directory of this process
+    seg_t segs[MAX_SEGS];        // loadable segments of the executable
+    uint32_t num_segs;
+    uint64_t exec_tsc;           // tsc at execute, 0 once the first instruction ran
+    uint32_t exec_hot;           // launched from a spawn snapshot
+    uint32_t heap_start;         // page after the last segment
+    uint32_t brk;                // end of the heap, moved by sbrk
     term_t * term;
+    uint32_t vidmapped;          // called vidmap, holds a vga_pin
+    uint16_t* vid_back;          // back page at 136MB once vidflip is used, NULL before
 } pcb_t;
 
+/* exec-to-first-instruction latency of one executable, in tsc cycles */
+typedef struct {
+    uint32_t count;
+    uint32_t last;
+    uint32_t min;
+} exec_lat_t;
+
 extern uint8_t pid_array[6];
+int32_t demand_page(uint32_t addr);
+void exec_kstat();
 pcb_t* get_cur_pcb_process(uint32_t process);
 pcb_t* get_cur_pcb();
 #endif
@@ -2,9 +2,11 @@
 #include "keyboard.h"
 #include "sys_call.h"
 #include "paging.h"
+#include "timer.h"
 
 volatile uint8_t current_term_id;
 term_t terms[TERM_COUNT];
+spinlock_t term_lock = SPINLOCK_INIT("terminal");
 
 /*
 *   term_init
@@ -15,124 +17,312 @@ term_t terms[TERM_COUNT];
 */
 void term_init() {
 	uint8_t i;
-	uint32_t j;
 	for (i = 0; i < TERM_COUNT; i++) {
 		// init all terminal
 		terms[i].activate = 0;
 		terms[i].xcopy = 0;
 		terms[i].ycopy = 0;
-		terms[i].buffer_idx = 0;
-		terms[i].return_flag = 0;
+		terms[i].edit_len = 0;
+		terms[i].in_head = 0;
+		terms[i].in_tail = 0;
+		terms[i].lines_dropped = 0;
+		memset(terms[i].readers, 0, sizeof(terms[i].readers));
 		terms[i].id = i;
 		terms[i].active_process_num = -1;
-		// init keyboard buffer to be null
-		for (j = 0; j < BUFFER_LEN; j++) {
-			terms[i].keyboard_buffer[j] = '\0';
-		}
-		// set up paging
-		PageTableToPage(_100MB, _100MB+((i+1)*_4KB), i+1);
-		terms[i].video_mem = (uint8_t *)_100MB+((i+1)*_4KB);
-		// clear video mem
-		for (j = 0; j < NUM_ROWS*NUM_COLS; j++) {
-			*(uint8_t *)(terms[i].video_mem + (j << 1)) = ' ';
-			*(uint8_t *)(terms[i].video_mem + (j << 1) + 1) = 0xf;
-		}
+		// its own slot of the text window, blank
+		vga_con_init(&terms[i].con, i);
 	}
 	// set up first terminal and execute shell
-	keyboard_buffer = terms[0].keyboard_buffer;
 	restore_term(0);
 	current_term_id = 0;
-	execute((uint8_t*)"shell");
+	terms[0].activate = 1;
+	execute_root((uint8_t*)"shell", &terms[0]);
+}
+
+/*
+*   term_shell_thread
+*   description: kernel thread that starts the first shell of a terminal,
+*                it waits in execute_root for good
+*   inputs: arg -- the terminal
+*   outputs: none
+*   side effects: none
+*/
+static void term_shell_thread(void* arg) {
+	term_t* term = (term_t*)arg;
+
+	if (execute_root((uint8_t*)"shell", term) == -1) {
+		term->activate = 0;
+	}
 }
 
 /*
 *		terminal_launch
-*   description: launch a new terminal
+*   description: switch to a terminal, a kernel thread starts its shell the
+*                first time so this works from any context, even a
+*                keyboard tasklet on an idle cpu
 *   inputs: term_id -- which terminal to be launched
-*   outputs: 0 if success
+*   outputs: 0 if success, -1 if its shell can not be started
 *		side effect: lauch a new terminal
 */
 int32_t terminal_launch(uint8_t term_id) {
-	cli();
-	// do nothing if same term
-	if (term_id == current_term_id) {
-		return 0;
-	}
+	uint32_t flags;
 	// check input
 	if (term_id >= TERM_COUNT) {
 		return -1;
 	}
+	spin_lock_irqsave(&term_lock, flags);
+	// do nothing if same term
+	if (term_id == current_term_id) {
+		spin_unlock_irqrestore(&term_lock, flags);
+		return 0;
+	}
 	// if term already active, just restore and switch the content
 	if (terms[term_id].activate == 1) {
 		if (switch_term(current_term_id, term_id) == -1) {
+			spin_unlock_irqrestore(&term_lock, flags);
 			return -1;
 		}
-		keyboard_buffer = terms[term_id].keyboard_buffer;
 		current_term_id = term_id;
-    uint8_t * screen_start;
-    vidmap(&screen_start);
+		spin_unlock_irqrestore(&term_lock, flags);
 		return 0;
 	}
-	// if term not active, need to do execute another shell
-	save_term(current_term_id);
+	// if term not active, its shell is a new root process, not a child of
+	// whatever was interrupted
+	if (kthread_create(term_shell_thread, &terms[term_id]) == -1) {
+		spin_unlock_irqrestore(&term_lock, flags);
+		return -1;
+	}
+	terms[term_id].activate = 1;
+	if (switch_term(current_term_id, term_id) == -1) {
+		spin_unlock_irqrestore(&term_lock, flags);
+		return -1;
+	}
 	current_term_id = term_id;
-	pcb_t * old_pcb = get_cur_pcb_process(terms[current_term_id].active_process_num);
-	keyboard_buffer = terms[term_id].keyboard_buffer;
-	restore_term(term_id);
-
-    asm volatile("			\n\
-                 movl %%ebp, %%eax 	\n\
-                 movl %%esp, %%ebx 	\n\
-                 "
-                 :"=a"(old_pcb->ebp_val), "=b"(old_pcb->esp_val)
-	);
-	sti();
-	// execute shell in new term
-	execute((uint8_t*)"shell");
+	spin_unlock_irqrestore(&term_lock, flags);
+	return 0;
+}
+
+/*
+* term_put_line
+* description: queue a finished line for terminal_read, all or nothing;
+*              the line becomes visible to the reader in one step
+* input : term -- the terminal, line/len -- the text without its '\n'
+* outputs: 0, -1 if the ring is too full, the line is then dropped
+* side effects: wakes the readers of the terminal
+*/
+int32_t term_put_line(term_t* term, const uint8_t* line, uint32_t len) {
+	uint32_t head = term->in_head;
+	uint32_t i, flags;
+
+	if (TERM_RING_SIZE - (head - term->in_tail) < len + 1) {
+		term->lines_dropped++;
+		return -1;
+	}
+	for (i = 0; i < len; i++) {
+		term->in_ring[(head + i) & TERM_RING_MASK] = line[i];
+	}
+	term->in_ring[(head + len) & TERM_RING_MASK] = '\n';
+	/* the bytes before the index that publishes them */
+	asm volatile("" : : : "memory");
+	term->in_head = head + len + 1;
+
+	cli_and_save(flags);
+	for (i = 0; i < THREAD_MAX; i++) {
+		if (term->readers[i] != NULL) {
+			thread_wake(term->readers[i]);
+			term->readers[i] = NULL;
+		}
+	}
+	restore_flags(flags);
 	return 0;
 }
 
+/*
+* term_forget
+* description: a thread blocked in terminal_read is being freed
+* input : tid -- its slot
+* outputs: none
+* side effects: interrupts must be off
+*/
+void term_forget(uint32_t tid) {
+	uint32_t i;
+
+	for (i = 0; i < TERM_COUNT; i++) {
+		terms[i].readers[tid] = NULL;
+	}
+}
+
+/*
+* term_take
+* description: copy out the oldest queued line, or as much of it as fits;
+*              the rest stays for the next call
+* input : term -- the terminal, buf -- destination, n -- size of buf
+* outputs: bytes copied, the last one is '\n' if the line ended; 0 if
+*          nothing is queued
+* side effects: frees the copied bytes for the producer
+*/
+int32_t term_take(term_t* term, uint8_t* buf, uint32_t n) {
+	uint32_t tail = term->in_tail;
+	uint32_t head = term->in_head;
+	uint32_t i = 0;
+
+	/* read in_head before the bytes it publishes */
+	asm volatile("" : : : "memory");
+	while (i < n && tail != head) {
+		buf[i] = term->in_ring[tail & TERM_RING_MASK];
+		tail++;
+		if (buf[i++] == '\n') {
+			break;
+		}
+	}
+	asm volatile("" : : : "memory");
+	term->in_tail = tail;
+	return i;
+}
+
 /*
 * terminal_read
-* description: terminal read function
+* description: terminal read function, returns one typed line; lines
+*              typed ahead wait in the terminal's ring
 * input : fd -- fd number
 					buf -- buffer to read
 					n_bytes -- #bytes to read
-* outputs: # bytes read
-* side effects: none
+* outputs: # bytes read, -1 if the deadline of read_timeout passed first
+* side effects: blocks until a line is queued on the caller's terminal
 */
 int32_t terminal_read(int32_t fd, void* buf, int32_t n_bytes) {
-	return_flag = 0;
-	while (return_flag == 0);
+	thread_t* cur = get_cur_thread();
+	term_t* term = get_cur_pcb()->term;
+	uint32_t flags;
+
+	if (n_bytes <= 0) {
+		return 0;
+	}
 	// clip length
 	if (n_bytes > BUFFER_LEN) {
 		n_bytes = (BUFFER_LEN);
 	}
-	// copy from buffer
-	uint32_t i;
-	int8_t * buffer = (int8_t * )buf;
-	for (i = 0; i < n_bytes; i++)	{
-		if (keyboard_buffer[i] == '\0') {
-			n_bytes = i;
-			break;
+	cli_and_save(flags);
+	while (term->in_head == term->in_tail) {
+		term->readers[cur->tid] = cur;
+		if (timer_block_io() == -1) {
+			term->readers[cur->tid] = NULL;
+			restore_flags(flags);
+			return -1;
 		}
-		else {
-			 buffer[i] = keyboard_buffer[i];
-			 }
 	}
+	restore_flags(flags);
+	return term_take(term, (uint8_t*)buf, n_bytes);
+};
 
-    for (i = 0; i < buffer_idx; i++)
-  		keyboard_buffer[i] = '\0';
+/*
+* term_rows
+* description: how many rows a run of output moves down, wrapping at the
+*              right edge like putc does
+* input : x -- starting column, buf/n -- the output
+* outputs: rows advanced
+* side effects: none
+*/
+static uint32_t term_rows(uint32_t x, const int8_t* buf, uint32_t n) {
+	uint32_t i, rows = 0;
 
-  buffer_idx = 0;								// clean idx
-	return_flag = 1;							// set flag
+	for (i = 0; i < n; i++) {
+		if (buf[i] == '\n' || buf[i] == '\r' || ++x == NUM_COLS) {
+			x = 0;
+			rows++;
+		}
+	}
+	return rows;
+}
 
-	return n_bytes;
-};
+/*
+* term_render
+* description: draw a run of output at the screen position in one pass:
+*              the screen scrolls once by however many rows the run needs,
+*              then each line is copied straight into video memory; text
+*              that would scroll off again goes straight to the scrollback
+* input : term -- the terminal, buf/n -- the output
+* outputs: none
+* side effects: moves the screen position, not the hardware cursor;
+*               term_lock must be held
+*/
+static void term_render(term_t* term, const int8_t* buf, uint32_t n) {
+	uint16_t* video;
+	uint16_t* row;
+	uint32_t shown = (term->id == current_term_id);
+	// lib.c keeps the position of the terminal on the screen
+	uint32_t x = shown ? get_x() : term->xcopy;
+	int32_t y = shown ? get_y() : term->ycopy;
+	uint32_t i, scroll, first;
+
+	scroll = y + term_rows(x, buf, n);
+	scroll = scroll < NUM_ROWS ? 0 : scroll - (NUM_ROWS - 1);
+	first = vga_scroll(&term->con, scroll);
+	video = vga_screen(&term->con);
+	/* rows above 0 are the ones that scrolled off, row -scroll is the
+	 * scrollback row first */
+	y -= scroll;
+	for (i = 0; i < n; i++) {
+		if (buf[i] == '\n' || buf[i] == '\r') {
+			x = 0;
+			y++;
+			continue;
+		}
+		if (y >= 0) {
+			video[y * NUM_COLS + x] = (ATTRIB << 8) | (uint8_t)buf[i];
+		} else if ((row = vga_history_row(&term->con, first + scroll + y)) != NULL) {
+			row[x] = (ATTRIB << 8) | (uint8_t)buf[i];
+		}
+		if (++x == NUM_COLS) {
+			x = 0;
+			y++;
+		}
+	}
+	if (shown) {
+		set_x(x);
+		set_y(y);
+	} else {
+		term->xcopy = x;
+		term->ycopy = y;
+	}
+}
+
+/*
+* term_write
+* description: draw output on a terminal a chunk at a time, into its own
+*              slot of video memory whether it is on the screen or not,
+*              and move the hardware cursor once at the end if it is
+* input : term -- the terminal, buf/n -- the output
+* outputs: n
+* side effects: none
+*/
+int32_t term_write(term_t* term, const int8_t* buf, uint32_t n) {
+	uint32_t done, chunk;
+	uint32_t flags;
+
+	// a chunk at a time, so a long write does not hold off the keyboard
+	// and timer for long
+	for (done = 0; done < n; done += chunk) {
+		chunk = n - done;
+		if (chunk > TERM_WRITE_CHUNK) {
+			chunk = TERM_WRITE_CHUNK;
+		}
+		spin_lock_irqsave(&term_lock, flags);
+		term_render(term, buf + done, chunk);
+		spin_unlock_irqrestore(&term_lock, flags);
+	}
+	spin_lock_irqsave(&term_lock, flags);
+	if (term->id == current_term_id) {
+		update_cursor(get_x(), get_y());
+	}
+	spin_unlock_irqrestore(&term_lock, flags);
+	return n;
+}
 
 /*
 * terminal_write
-* description: terminal wirte function
+* description: terminal write function, draws on the terminal of the
+*              calling process, the one on the screen for kernel threads
 * input : fd -- fd index
 					buf -- buf to write
 					n_bytes -- #bytes to write
@@ -140,35 +330,15 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t n_bytes) {
 * side effects: none
 */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t n_bytes) {
-	uint32_t i;
-	uint32_t count = 0;
-	int8_t * buffer = (int8_t * )buf;
-	for (i = 0; i < n_bytes; i++) {
-		int xcopy = get_y();
-		if (buffer_idx < BUFFER_LEN-1) {
-			// handle a new line
-			if (buffer_idx == NUM_COLS - 1) {
-				int ycopy = get_y();
-				putc(buffer[i]);  // output first
-				putc('\n');
-				if (ycopy == NUM_ROWS - 1) {	// check need for scroll
-					scroll_up();
-		            set_x(0);
-		            set_y(NUM_ROWS - 1);
-				}
-			}
-			else
-				putc(buffer[i]);
-
-			if (xcopy == NUM_COLS - 1)
-				update_cursor(get_x(), get_y() + 1);
-			else
-				update_cursor(get_x(), get_y());
-
-			count++;
-		}
+	pcb_t* pcb = get_cur_pcb();
+
+	if (buf == NULL || n_bytes < 0) {
+		return -1;
 	}
-	return count;
+	if (pcb == NULL || pcb->term == NULL) {
+		return term_write(&terms[current_term_id], (const int8_t*)buf, n_bytes);
+	}
+	return term_write(pcb->term, (const int8_t*)buf, n_bytes);
 };
 
 /*
@@ -195,7 +365,8 @@ int32_t terminal_close(int32_t fd){
 
 /*
 * int32_t switch_term
-* description: switch terms
+* description: switch terms; each has its own slot of video memory, so
+*              nothing is copied
 * Inputs : old_term_id -- old term index
 					 new_term_id -- new term index
 * Outputs: 0 if success, -1 otherwise
@@ -210,31 +381,28 @@ int32_t switch_term(uint8_t old_term_id, uint8_t new_term_id) {
 
 /*
 * int32_t save_term
-* description: save terminal content
+* description: save the position of a terminal leaving the screen, its
+*              content stays in its slot
 * Inputs : term_id -- term index
 * Outputs: 0 if success, -1 otherwise
 * side effect: none
 */
 int32_t save_term(uint8_t term_id) {
-	// save keyboard buffer, position and screen
-	terms[term_id].buffer_idx = buffer_idx;
 	terms[term_id].xcopy = get_x();
 	terms[term_id].ycopy = get_y();
-	memcpy((uint8_t *)terms[term_id].video_mem, (uint8_t *)VIDEO, 2*NUM_ROWS*NUM_COLS);
 	return 0;
 }
 
 /*
 * int32_t restore_term
-* description: restore terminal content
+* description: put a terminal on the screen by pointing the display at
+*              its slot
 * Inputs : term_id -- term index
 * Outputs: 0 if success
-* side effect: none
+* side effect: moves the cursor
 */
 int32_t restore_term(uint8_t term_id) {
-	// set up keyboard buffer, coordinate position and video mem
-	buffer_idx = terms[term_id].buffer_idx;
+	vga_show(&terms[term_id].con);
 	set_display_coord(terms[term_id].xcopy, terms[term_id].ycopy);
-	memcpy((uint8_t *)VIDEO, (uint8_t *)terms[term_id].video_mem, 2*NUM_ROWS*NUM_COLS);
 	return 0;
 }
@@ -4,9 +4,17 @@
 
 #include "lib.h"
 #include "i8259.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "vga.h"
 
 #define BUFFER_LEN         128
 #define TERM_COUNT         3
+/* typed-ahead input of a terminal, a power of two */
+#define TERM_RING_SIZE     1024
+#define TERM_RING_MASK     (TERM_RING_SIZE - 1)
+/* bytes terminal_write draws per hold of term_lock */
+#define TERM_WRITE_CHUNK   512
 
 
 extern volatile uint8_t current_term_id;
@@ -18,20 +26,29 @@ typedef struct {
 	int8_t active_process_num;
     // whether terminal has a process activate
     uint8_t activate;
-    // coord copy
+    // screen position while it is not on the screen, lib.c has it then
     uint32_t xcopy;
     uint32_t ycopy;
-    // key buffer for each terminal
-    volatile uint8_t keyboard_buffer[BUFFER_LEN];
-    volatile uint8_t buffer_idx;
-    volatile uint8_t return_flag;
-    //ptr to video memory for terminal
-    uint8_t *video_mem;
+    // line being typed, only the keyboard bottom half touches it
+    uint8_t edit_buf[BUFFER_LEN];
+    uint32_t edit_len;
+    // finished lines, each ended by '\n'. Lock free: the keyboard bottom
+    // half is the only producer and moves in_head, terminal_read the only
+    // consumer and moves in_tail.
+    volatile uint8_t in_ring[TERM_RING_SIZE];
+    volatile uint32_t in_head;
+    volatile uint32_t in_tail;
+    uint32_t lines_dropped;     // lines that did not fit in in_ring
+    thread_t* readers[THREAD_MAX]; // blocked in terminal_read, by tid
+    // its slot of video memory and scrollback, drawn on in the background too
+    vga_con_t con;
 } term_t;
 
 /* Global Variables */
 extern volatile uint8_t current_term_id;
 extern term_t terms[TERM_COUNT];
+/* the screen, cursor and terminal switching */
+extern spinlock_t term_lock;
 
 /*Function Definitions */
 void term_init(void);
@@ -40,6 +57,15 @@ int32_t save_term(uint8_t term_id);
 int32_t restore_term(uint8_t term_id);
 int32_t switch_term(uint8_t old_term_id, uint8_t new_term_id);
 
+/* producer side: queue a finished line, -1 if it does not fit */
+int32_t term_put_line(term_t* term, const uint8_t* line, uint32_t len);
+/* consumer side: take up to n bytes of the oldest line, 0 if none */
+int32_t term_take(term_t* term, uint8_t* buf, uint32_t n);
+/* drop a thread that is being freed from the readers of every terminal */
+void term_forget(uint32_t tid);
+/* draw output on a terminal, shown or not */
+int32_t term_write(term_t* term, const int8_t* buf, uint32_t n);
+
 /*Terminal System Calls */
 int32_t terminal_open(const uint8_t *filename);
 int32_t terminal_close(int32_t fd);
@@ -6,8 +6,35 @@
 #include "keyboard.h"
 #include "file_sys.h"
 #include "terminal.h"
+#include "paging.h"
+#include "sys_call.h"
+#include "slab.h"
+#include "thread.h"
+#include "fpu.h"
+#include "smp.h"
+#include "profile.h"
+#include "spinlock.h"
+#include "text_cache.h"
+#include "irq.h"
+#include "irqtrace.h"
+#include "clock.h"
+#include "timer.h"
+#include "vga.h"
+#include "serial.h"
+#include "klog.h"
 #define PASS 1
 #define FAIL 0
+#define FRAME_TEST_COUNT 64
+#define SLAB_TEST_OBJS 512
+#define SLAB_TEST_ROUNDS 8
+#define SLAB_TEST_SIZE 100
+#define LCG_MUL 1103515245
+#define LCG_INC 12345
+#define LCG_SHIFT 16
+#define KTHREAD_TEST_COUNT 4
+#define KTHREAD_TEST_YIELDS 64
+#define FPU_TEST_MAIN_VAL 0x1234
+#define FPU_TEST_KTHREAD_VAL 0x5678
 
 /* format these macros as you see fit */
 #define TEST_HEADER 	\
@@ -452,6 +479,1110 @@ void print_file_content2() {
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* Memory management tests */
+
+/* tlb_flush_test
+ * Description: map a vidmap page in a fresh address space and switch back,
+ *              neither step may cost a full TLB flush
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the TLB counters
+ * Coverage: flush_tlb_page, load_page_directory, global kernel pages
+ * Files: paging.c/h
+ */
+int tlb_flush_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t full = tlb_stats.full_flushes;
+	uint32_t pages = tlb_stats.page_flushes;
+	uint32_t* old_pd = get_cur_page_dir();
+	uint32_t* pd = page_dir_create();
+	if (pd == NULL) return FAIL;
+
+	load_page_directory(pd);
+	if (set_up_map(_136MB, VIDEO) != 0) result = FAIL;
+	/* the new translation must be visible without a full flush */
+	if (result == PASS && *(uint8_t*)_136MB != *(uint8_t*)VIDEO) result = FAIL;
+	load_page_directory(old_pd);
+	page_dir_destroy(pd);
+
+	printf("full flushes %u, page flushes %u, cr3 loads %u\n",
+		tlb_stats.full_flushes, tlb_stats.page_flushes, tlb_stats.cr3_loads);
+	if (tlb_stats.full_flushes != full || tlb_stats.page_flushes != pages + 1) result = FAIL;
+	return result;
+}
+
+/* frame_alloc_test
+ * Description: frames come out aligned, distinct and inside the direct map,
+ *              and a destroyed page directory gives back every frame it owns
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the frame counters
+ * Coverage: frame_alloc, frame_free, page_dir_destroy
+ * Files: frame.c/h, paging.c/h
+ */
+int frame_alloc_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t frames[FRAME_TEST_COUNT];
+	uint32_t free = frame_stats.free;
+	uint32_t* pd;
+	int i, j;
+
+	for (i = 0; i < FRAME_TEST_COUNT; i++) {
+		frames[i] = frame_alloc();
+		if (frames[i] < FRAME_LOW || frames[i] >= frame_top() || (frames[i] & (FRAME_SIZE - 1)))
+			result = FAIL;
+		for (j = 0; j < i; j++) {
+			if (frames[j] == frames[i]) result = FAIL;
+		}
+	}
+	if (frame_stats.free != free - FRAME_TEST_COUNT) result = FAIL;
+	for (i = 0; i < FRAME_TEST_COUNT; i++) {
+		frame_free(frames[i]);
+	}
+	if (frame_stats.free != free) result = FAIL;
+
+	/* directory, table and one owned user page all come back */
+	pd = page_dir_create();
+	if (pd == NULL) return FAIL;
+	if (map_virt_to_phys(pd, _128MB, (uint32_t)page_alloc(), USER_MASK | PAGE_OWNED) != 0) result = FAIL;
+	page_dir_destroy(pd);
+	if (frame_stats.free != free) result = FAIL;
+
+	printf("frames total %u, free %u\n", frame_stats.total, frame_stats.free);
+	return result;
+}
+
+/* slab_cache_test
+ * Description: a named cache grows a slab at a time, keeps one spare slab
+ *              when emptied and can then be destroyed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: kmem_cache_create/alloc/free/destroy, kmalloc limits
+ * Files: slab.c/h
+ */
+int slab_cache_test() {
+	TEST_HEADER;
+	int result = PASS;
+	kmem_cache_t* cache = kmem_cache_create("test", SLAB_TEST_SIZE);
+	void* objs[SLAB_TEST_OBJS];
+	uint32_t i, n;
+	if (cache == NULL) return FAIL;
+
+	n = cache->per_slab * 2 + 1;
+	if (n > SLAB_TEST_OBJS) return FAIL;
+	for (i = 0; i < n; i++) {
+		objs[i] = kmem_cache_alloc(cache);
+		if (objs[i] == NULL) result = FAIL;
+	}
+	if (cache->slabs != 3 || cache->active != n) result = FAIL;
+	for (i = 0; i < n; i++) {
+		kmem_cache_free(cache, objs[i]);
+	}
+	if (cache->slabs != 1 || cache->active != 0) result = FAIL;
+	if (kmem_cache_destroy(cache) != 0) result = FAIL;
+
+	if (kmalloc(0) != NULL || kmalloc(KMALLOC_MAX + 1) != NULL) result = FAIL;
+	return result;
+}
+
+/* slab_stress_test
+ * Description: kmalloc SLAB_TEST_OBJS blocks of pseudo random sizes, fill
+ *              and check them for overlap, then kfree them in an
+ *              interleaved order, SLAB_TEST_ROUNDS times
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the average cycles of a kmalloc/kfree pair
+ * Coverage: kmalloc, kfree, slab list handling
+ * Files: slab.c/h
+ */
+int slab_stress_test() {
+	TEST_HEADER;
+	int result = PASS;
+	static uint8_t* objs[SLAB_TEST_OBJS];
+	static uint32_t sizes[SLAB_TEST_OBJS];
+	uint32_t seed = 1, cycles = 0, free = frame_stats.free;
+	uint32_t i, j, round;
+	uint64_t start;
+
+	for (round = 0; round < SLAB_TEST_ROUNDS; round++) {
+		start = rdtsc();
+		for (i = 0; i < SLAB_TEST_OBJS; i++) {
+			seed = seed * LCG_MUL + LCG_INC;
+			sizes[i] = (seed >> LCG_SHIFT) % KMALLOC_MAX + 1;
+			objs[i] = (uint8_t*)kmalloc(sizes[i]);
+		}
+		cycles += (uint32_t)(rdtsc() - start);
+
+		for (i = 0; i < SLAB_TEST_OBJS; i++) {
+			if (objs[i] == NULL) return FAIL;
+			memset(objs[i], (uint8_t)i, sizes[i]);
+		}
+		for (i = 0; i < SLAB_TEST_OBJS; i++) {
+			for (j = 0; j < sizes[i]; j++) {
+				if (objs[i][j] != (uint8_t)i) result = FAIL;
+			}
+		}
+
+		/* odd blocks first, so slabs go full -> partial -> empty */
+		start = rdtsc();
+		for (j = 1; j <= 2; j++) {
+			for (i = j % 2; i < SLAB_TEST_OBJS; i += 2) {
+				kfree(objs[i]);
+			}
+		}
+		cycles += (uint32_t)(rdtsc() - start);
+	}
+
+	/* only the spare slab of each size class may stay allocated */
+	if (free - frame_stats.free > KMALLOC_CLASSES) result = FAIL;
+	printf("kmalloc+kfree: %u cycles per pair\n", cycles / (SLAB_TEST_ROUNDS * SLAB_TEST_OBJS));
+	return result;
+}
+
+
+/* Thread tests */
+
+static volatile uint32_t kthread_test_sum;
+static volatile uint32_t work_test_done;
+
+/* adds its argument twice with a yield in between */
+static void kthread_test_body(void* arg) {
+	kthread_test_sum += (uint32_t)arg;
+	thread_yield();
+	kthread_test_sum += (uint32_t)arg;
+}
+
+/* marks the work item as run */
+static void work_test_fn(void* arg) {
+	*(volatile uint32_t*)arg = 1;
+}
+
+/* kthread_test
+ * Description: kernel threads interleave with the caller through
+ *              thread_yield and exit by returning, queued work runs on
+ *              kworker
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the scheduler counters
+ * Coverage: kthread_create, thread_yield, thread_exit, queue_work
+ * Files: thread.c/h, exec.S
+ */
+int kthread_test() {
+	TEST_HEADER;
+	int result = PASS;
+	work_t work = { work_test_fn, (void*)&work_test_done, NULL, 0 };
+	uint32_t expected = KTHREAD_TEST_COUNT * (KTHREAD_TEST_COUNT + 1);
+	uint32_t i;
+
+	kthread_test_sum = 0;
+	work_test_done = 0;
+	for (i = 1; i <= KTHREAD_TEST_COUNT; i++) {
+		if (kthread_create(kthread_test_body, (void*)i) < 0) result = FAIL;
+	}
+	queue_work(&work);
+	for (i = 0; i < KTHREAD_TEST_YIELDS && (kthread_test_sum != expected || !work_test_done); i++) {
+		thread_yield();
+	}
+	if (kthread_test_sum != expected || !work_test_done) result = FAIL;
+	/* every test thread has returned and given back its slot */
+	for (i = THREAD_MAIN; i < THREAD_MAX; i++) {
+		if (threads[i] != NULL && threads[i]->fn == kthread_test_body) result = FAIL;
+	}
+	printf("switches %u, works %u\n", sched_stats.switches, sched_stats.works);
+	return result;
+}
+
+
+/* FPU tests */
+
+static volatile uint32_t fpu_test_seen;
+static volatile uint32_t fpu_test_done;
+
+/* keeps a value in xmm0 across a yield */
+static void fpu_test_body(void* arg) {
+	uint32_t val;
+	asm volatile("movd %0, %%xmm0" : : "r"((uint32_t)arg));
+	thread_yield();
+	asm volatile("movd %%xmm0, %0" : "=r"(val));
+	fpu_test_seen = val;
+	fpu_test_done = 1;
+}
+
+/* fpu_test
+ * Description: two threads keep different values in xmm0 across context
+ *              switches; each takes one first-use trap
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: drops the FPU state of the calling thread at the end
+ * Coverage: fpu_trap, fpu_switch, fpu_release
+ * Files: fpu.c/h, thread.c
+ */
+int fpu_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t inits = fpu_stats.inits;
+	uint32_t val;
+	uint32_t i;
+
+	fpu_test_seen = 0;
+	fpu_test_done = 0;
+	asm volatile("movd %0, %%xmm0" : : "r"(FPU_TEST_MAIN_VAL));
+	if (kthread_create(fpu_test_body, (void*)FPU_TEST_KTHREAD_VAL) < 0) result = FAIL;
+	for (i = 0; i < KTHREAD_TEST_YIELDS && !fpu_test_done; i++) {
+		thread_yield();
+	}
+	asm volatile("movd %%xmm0, %0" : "=r"(val));
+	if (!fpu_test_done || fpu_test_seen != FPU_TEST_KTHREAD_VAL) result = FAIL;
+	if (val != FPU_TEST_MAIN_VAL) result = FAIL;
+	/* the kernel thread trapped once for its first use */
+	if (fpu_stats.inits - inits < 1) result = FAIL;
+	printf("traps %u, saves %u, restores %u\n", fpu_stats.traps, fpu_stats.saves, fpu_stats.restores);
+	fpu_release(get_cur_thread());
+	return result;
+}
+
+
+/* SMP tests */
+
+/* smp_test
+ * Description: the running cpu knows its thread, every online cpu has an
+ *              idle thread, and nested kernel_enter calls only count
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the number of cpus online
+ * Coverage: this_cpu, kernel_enter, kernel_exit
+ * Files: smp.c/h, thread.c
+ */
+int smp_test() {
+	TEST_HEADER;
+	int result = PASS;
+	cpu_t* cpu;
+	uint32_t depth, online = 0;
+	uint32_t flags;
+	uint32_t i;
+
+	cli_and_save(flags);
+	cpu = this_cpu();
+	if (cpu->curr != get_cur_thread() || get_cur_thread()->cpu != cpu->id) result = FAIL;
+	depth = cpu->lock_depth;
+	kernel_enter();
+	if (smp_active && cpu->lock_depth != depth + 1) result = FAIL;
+	kernel_exit();
+	if (cpu->lock_depth != depth) result = FAIL;
+	restore_flags(flags);
+
+	for (i = 0; i < MAX_CPUS; i++) {
+		if (cpus[i].online) {
+			online++;
+			if (cpus[i].idle == NULL || cpus[i].idle->state != THREAD_IDLE) result = FAIL;
+		}
+	}
+	if (online == 0 || (smp_active && online != smp_ncpus)) result = FAIL;
+	printf("%u cpus online\n", online);
+	return result;
+}
+
+/* spinlock_test
+ * Description: a held lock can not be taken again, and the irqsave
+ *              variant turns interrupts off and puts the flag back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: spin_lock, spin_trylock, spin_lock_irqsave
+ * Files: spinlock.c/h
+ */
+int spinlock_test() {
+	TEST_HEADER;
+	int result = PASS;
+	spinlock_t lock = SPINLOCK_INIT("test");
+	uint32_t flags, eflags;
+
+	spin_lock(&lock);
+	if (spin_trylock(&lock) == 0) result = FAIL;
+	if (lock.cpu != (int32_t)this_cpu()->id) result = FAIL;
+	spin_unlock(&lock);
+	if (spin_trylock(&lock) != 0) result = FAIL;
+	spin_unlock(&lock);
+
+	sti();
+	spin_lock_irqsave(&lock, flags);
+	asm volatile("pushfl; popl %0" : "=r"(eflags));
+	if ((eflags & EFLAGS_IF) || !lock.locked) result = FAIL;
+	spin_unlock_irqrestore(&lock, flags);
+	asm volatile("pushfl; popl %0" : "=r"(eflags));
+	if (!(eflags & EFLAGS_IF) || lock.locked) result = FAIL;
+	return result;
+}
+
+/* text_cache_test
+ * Description: a cached page is handed out with a reference per user and
+ *              a second add of the same page keeps the first frame
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: text_page_get, text_page_add, text_page_put
+ * Files: text_cache.c/h
+ */
+int text_cache_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t inode = 0xFFFF;	/* not a real inode */
+	uint32_t pages = text_stats.pages;
+	uint32_t frame, other;
+
+	if (text_page_get(inode, _128MB) != 0) result = FAIL;
+	frame = text_page_add(inode, _128MB, (uint32_t)page_alloc());
+	if (frame == 0 || text_stats.pages != pages + 1) result = FAIL;
+	if (text_page_get(inode, _128MB) != frame) result = FAIL;
+	other = text_page_add(inode, _128MB, (uint32_t)page_alloc());
+	if (other != frame || text_stats.pages != pages + 1) result = FAIL;
+	text_page_put(frame);
+	text_page_put(frame);
+	if (text_stats.pages != pages + 1) result = FAIL;
+	text_page_put(frame);
+	if (text_stats.pages != pages || text_page_get(inode, _128MB) != 0) result = FAIL;
+	return result;
+}
+/* spawn_template_test
+ * Description: a pinned executable keeps its pages with no process
+ *              mapping them, and hands out copies of its templates
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: text_cache_pin, text_template_save/copy, text_cache_unpin
+ * Files: text_cache.c/h, spawn.c/h
+ */
+int spawn_template_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t inode = 0xFFFE;	/* not a real inode */
+	uint32_t pages = text_stats.pages;
+	uint32_t templates = text_stats.templates;
+	uint8_t* src = (uint8_t*)page_alloc();
+	uint8_t* dst = (uint8_t*)page_alloc();
+	uint32_t frame;
+
+	if (src == NULL || dst == NULL) {
+		page_free(src);
+		page_free(dst);
+		return FAIL;
+	}
+	if (text_cache_pin(inode) != 0) result = FAIL;
+	frame = text_page_add(inode, _128MB, (uint32_t)page_alloc());
+	text_page_put(frame);
+	if (text_stats.pages != pages + 1) result = FAIL;
+
+	src[0] = 0x5A;
+	src[PAGE_BYTES - 1] = 0xA5;
+	text_template_save(inode, _128MB + _4KB, src);
+	if (text_stats.templates != templates + 1) result = FAIL;
+	if (text_template_copy(inode, _128MB + _4KB, dst) != 0) result = FAIL;
+	if (dst[0] != 0x5A || dst[PAGE_BYTES - 1] != 0xA5) result = FAIL;
+
+	text_cache_unpin(inode);
+	if (text_stats.pages != pages || text_stats.templates != templates) result = FAIL;
+	if (text_template_copy(inode, _128MB + _4KB, dst) != -1) result = FAIL;
+	page_free(src);
+	page_free(dst);
+	return result;
+}
+static void tasklet_count(void* arg) {
+	(*(uint32_t*)arg)++;
+}
+
+/* irq_tasklet_test
+ * Description: a taken line can not be requested again, and a tasklet
+ *              scheduled twice before softirq_run runs once
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: request_irq, tasklet_schedule, softirq_run
+ * Files: irq.c/h
+ */
+int irq_tasklet_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t runs = 0;
+	uint32_t flags;
+	tasklet_t t = { tasklet_count, &runs, NULL, 0 };
+
+	if (request_irq(PIT_IRQ, pit_handler, "timer", NULL) != -1) result = FAIL;
+	if (request_irq(NR_IRQS, pit_handler, "bad", NULL) != -1) result = FAIL;
+
+	cli_and_save(flags);
+	tasklet_schedule(&t);
+	tasklet_schedule(&t);
+	softirq_run();
+	restore_flags(flags);
+	if (runs != 1 || t.pending) result = FAIL;
+	return result;
+}
+
+/* irqtrace_test
+ * Description: a section that turns interrupts off is timed to the site
+ *              that turns them on, a nested one is not, and a reset
+ *              clears the counters
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: clears the irqtrace statistics
+ * Coverage: irqtrace_off, irqtrace_on, irqtrace_reset
+ * Files: irqtrace.c/h, lib.h
+ */
+int irqtrace_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t flags, sections, i;
+	const int8_t* off = "tests.c:off";
+	const int8_t* on = "tests.c:on";
+	irqtrace_site_t* site = NULL;
+
+	cli_and_save(flags);
+	sections = irqtrace_stats.sections;
+	irqtrace_off(EFLAGS_IF, off);
+	irqtrace_on(on);
+	if (irqtrace_stats.sections != sections + 1) result = FAIL;
+	for (i = 0; i < IRQTRACE_SITES; i++) {
+		if (irqtrace_stats.sites[i].off_site == off) site = &irqtrace_stats.sites[i];
+	}
+	if (site == NULL || site->on_site != on || site->count != 1) result = FAIL;
+
+	irqtrace_off(0, off);
+	irqtrace_on(on);
+	if (irqtrace_stats.sections != sections + 1) result = FAIL;
+
+	irqtrace_reset();
+	if (irqtrace_stats.sections != 0 || irqtrace_stats.max != 0) result = FAIL;
+	restore_flags(flags);
+	return result;
+}
+
+/* clock_test
+ * Description: the calibrated clock converts one second of cycles to one
+ *              second of nanoseconds and never goes back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: div64_32, cycles_to_ns, clock_ns
+ * Files: clock.c/h
+ */
+int clock_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint64_t n = 10000000007ULL;
+	uint64_t ns, prev;
+	uint32_t i;
+
+	if (div64_32(&n, NS_PER_SEC) != 7 || n != 10) result = FAIL;
+	ns = cycles_to_ns((uint64_t)tsc_khz * 1000);
+	if (ns < NS_PER_SEC - NS_PER_MS || ns > NS_PER_SEC + NS_PER_MS) result = FAIL;
+	prev = clock_ns();
+	for (i = 0; i < 1000; i++) {
+		ns = clock_ns();
+		if (ns < prev) result = FAIL;
+		prev = ns;
+	}
+	return result;
+}
+
+#define TIMER_TEST_NUM 4096
+static timer_wheel_t test_wheel;
+static ktimer_t test_timers[TIMER_TEST_NUM];
+static uint32_t test_fired_at[TIMER_TEST_NUM];
+
+static void timer_test_fire(void* arg) {
+	test_fired_at[(ktimer_t*)arg - test_timers] = test_wheel.clk - 1;
+}
+
+/* timer_wheel_test
+ * Description: thousands of timers spread over every level of a private
+ *              wheel fire exactly at their tick unless cancelled, and
+ *              adding to a full wheel costs no more than to an empty one
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none, the kernel wheel is not touched
+ * Coverage: wheel_add, wheel_del, wheel_advance
+ * Files: timer.c/h
+ */
+int timer_wheel_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t i, x = 1, empty, full, flags;
+	uint64_t start;
+
+	wheel_init(&test_wheel, 0xFFFFF000, NULL);
+	cli_and_save(flags);
+	start = rdtsc();
+	for (i = 0; i < TIMER_TEST_NUM / 64; i++) {
+		x = x * 1103515245 + 12345;
+		timer_setup(&test_timers[i], timer_test_fire, &test_timers[i]);
+		test_timers[i].expires = test_wheel.clk + ((x >> 6) & 0x3FFFFF);
+		wheel_add(&test_wheel, &test_timers[i]);
+	}
+	empty = (uint32_t)(rdtsc() - start);
+	start = rdtsc();
+	for (; i < TIMER_TEST_NUM; i++) {
+		x = x * 1103515245 + 12345;
+		timer_setup(&test_timers[i], timer_test_fire, &test_timers[i]);
+		test_timers[i].expires = test_wheel.clk + ((x >> 6) & 0x3FFFFF);
+		wheel_add(&test_wheel, &test_timers[i]);
+	}
+	full = (uint32_t)(rdtsc() - start) / 63;
+	restore_flags(flags);
+	/* the first batch went into an emptier wheel, allow for noise */
+	if (full > 4 * empty + 1000) result = FAIL;
+
+	for (i = 0; i < TIMER_TEST_NUM; i += 3) {
+		if (wheel_del(&test_wheel, &test_timers[i]) != 1) result = FAIL;
+		if (wheel_del(&test_wheel, &test_timers[i]) != 0) result = FAIL;
+	}
+	memset(test_fired_at, 0, sizeof(test_fired_at));
+	wheel_advance(&test_wheel, test_wheel.clk + 0x400000);
+	if (test_wheel.count != 0) result = FAIL;
+	for (i = 0; i < TIMER_TEST_NUM; i++) {
+		if (i % 3 == 0 ? test_fired_at[i] != 0 : test_fired_at[i] != test_timers[i].expires) {
+			result = FAIL;
+		}
+	}
+	return result;
+}
+
+/* rtc_virtual_test
+ * Description: a virtual rtc counts one tick per divisor hardware ticks
+ *              and reports the ones a late reader missed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: rtc_advance
+ * Files: rtc_handler.c/h
+ */
+int rtc_virtual_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint32_t next = 0xFFFFFFFC;
+
+	if (rtc_advance(&next, 4, 0xFFFFFFFB) != 0 || next != 0xFFFFFFFC) result = FAIL;
+	if (rtc_advance(&next, 4, 0xFFFFFFFC) != 1 || next != 0) result = FAIL;
+	if (rtc_advance(&next, 4, 9) != 3 || next != 12) result = FAIL;
+	if (rtc_advance(&next, 4, 11) != 0) result = FAIL;
+	return result;
+}
+
+#define KBD_TEST_LINES 300
+#define KBD_TEST_BATCH 10
+
+/* keyboard_stress_test
+ * Description: replays whole lines of scancodes at full speed into the
+ *              top half; lines typed ahead queue up on the terminal and
+ *              come back out of term_take intact and in order, and keys
+ *              beyond a full scancode ring are counted as dropped
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: echoes the lines on the screen
+ * Coverage: keyboard_inject, keyboard_key, term_put_line, term_take
+ * Files: keyboard.c/h, terminal.c/h
+ */
+int keyboard_stress_test() {
+	TEST_HEADER;
+	int result = PASS;
+	static const uint8_t keys[3] = { 0x1E, 0x30, 0x2E };	/* a b c */
+	term_t* term = &terms[current_term_id];
+	uint8_t line[BUFFER_LEN];
+	uint8_t saved_keys = held_keys;
+	uint32_t flags, r, i, len, queued = 0, done = 0, dropped, lost;
+
+	cli_and_save(flags);
+	held_keys = 0;
+	while (term_take(term, line, BUFFER_LEN) > 0) {
+	}
+	term->edit_len = 0;
+	lost = term->lines_dropped;
+	for (r = 0; r < KBD_TEST_LINES; r++) {
+		len = r % 30 + 1;
+		for (i = 0; i < len; i++) {
+			keyboard_inject(keys[(r + i) % 3]);
+			queued++;
+			if (queued == KBD_RING_SIZE) {
+				softirq_run();
+				queued = 0;
+			}
+		}
+		keyboard_inject(ENTER);
+		queued++;
+		if (queued == KBD_RING_SIZE) {
+			softirq_run();
+			queued = 0;
+		}
+		if (r % KBD_TEST_BATCH != KBD_TEST_BATCH - 1) {
+			continue;
+		}
+		softirq_run();
+		queued = 0;
+		/* the lines typed ahead since the last batch */
+		for (; done <= r; done++) {
+			len = done % 30 + 1;
+			if (term_take(term, line, BUFFER_LEN) != len + 1 || line[len] != '\n') {
+				result = FAIL;
+				continue;
+			}
+			for (i = 0; i < len; i++) {
+				if (line[i] != "abc"[(done + i) % 3]) result = FAIL;
+			}
+		}
+	}
+	if (term_take(term, line, BUFFER_LEN) != 0 || term->lines_dropped != lost) result = FAIL;
+
+	dropped = kbd_dropped;
+	for (i = 0; i < KBD_RING_SIZE + 5; i++) {
+		keyboard_inject(keys[0]);
+	}
+	if (kbd_dropped != dropped + 5) result = FAIL;
+	softirq_run();
+	term->edit_len = 0;
+	held_keys = saved_keys;
+	restore_flags(flags);
+	return result;
+}
+
+/* terminal_write_test
+ * Description: one write of more lines than the screen has scrolls the
+ *              screen once and keeps the last lines, and a line longer
+ *              than the screen wraps
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: clears the screen
+ * Coverage: terminal_write
+ * Files: terminal.c/h
+ */
+int terminal_write_test() {
+	TEST_HEADER;
+	int result = PASS;
+	term_t* term = &terms[current_term_id];
+	uint16_t* video;
+	int8_t buf[30 * 4];
+	uint32_t i;
+
+	for (i = 0; i < 30; i++) {
+		buf[i * 4] = 'L';
+		buf[i * 4 + 1] = '0' + i / 10;
+		buf[i * 4 + 2] = '0' + i % 10;
+		buf[i * 4 + 3] = '\n';
+	}
+	clear();
+	set_x(0);
+	set_y(0);
+	if (term_write(term, buf, sizeof(buf)) != sizeof(buf)) result = FAIL;
+	video = vga_screen(&term->con);
+	if (get_x() != 0 || get_y() != NUM_ROWS - 1) result = FAIL;
+	/* 30 lines from row 0 scrolled the first 6 off */
+	if ((video[0] & 0xFF) != 'L' || (video[1] & 0xFF) != '0' || (video[2] & 0xFF) != '6') result = FAIL;
+	if ((video[(NUM_ROWS - 2) * NUM_COLS + 2] & 0xFF) != '9') result = FAIL;
+	if ((video[(NUM_ROWS - 1) * NUM_COLS] & 0xFF) != ' ') result = FAIL;
+
+	memset(buf, 'x', sizeof(buf));
+	clear();
+	set_x(0);
+	set_y(0);
+	term_write(term, buf, NUM_COLS + 20);
+	video = vga_screen(&term->con);
+	if (get_x() != 20 || get_y() != 1) result = FAIL;
+	if ((video[NUM_COLS + 19] & 0xFF) != 'x' || (video[NUM_COLS + 20] & 0xFF) != ' ') result = FAIL;
+	clear();
+	set_x(0);
+	set_y(0);
+	return result;
+}
+
+/* vga_lines
+ * Description: fill buf with count lines "<tag>NNN\n" numbered from 0
+ * Inputs: buf -- count * 5 bytes, tag -- first letter
+ * Outputs: bytes written
+ * Side Effects: none
+ */
+static uint32_t vga_lines(int8_t* buf, int8_t tag, uint32_t count) {
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		buf[i * 5] = tag;
+		buf[i * 5 + 1] = '0' + i / 100;
+		buf[i * 5 + 2] = '0' + i / 10 % 10;
+		buf[i * 5 + 3] = '0' + i % 10;
+		buf[i * 5 + 4] = '\n';
+	}
+	return count * 5;
+}
+
+/* vga_row_is
+ * Description: compare the text of a row with a string
+ * Inputs: row -- cells, s -- text
+ * Outputs: 1 if the row starts with s
+ * Side Effects: none
+ */
+static int vga_row_is(uint16_t* row, const int8_t* s) {
+	uint32_t i;
+
+	for (i = 0; s[i] != '\0'; i++) {
+		if (row == NULL || (row[i] & 0xFF) != (uint8_t)s[i]) return 0;
+	}
+	return 1;
+}
+
+/* vga_scroll_test
+ * Description: line feeds one at a time move the screen down its slot
+ *              of the text window and wrap, and the rows that leave it,
+ *              drawn or not, land in the scrollback in order
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: clears the screen
+ * Coverage: vga_scroll, vga_history_row, term_render
+ * Files: vga.c/h, terminal.c/h
+ */
+int vga_scroll_test() {
+	TEST_HEADER;
+	static int8_t buf[408 * 5];
+	term_t* term = &terms[current_term_id];
+	vga_con_t* con = &term->con;
+	int result = PASS;
+	uint32_t wraps = vga_stats.wraps;
+	uint32_t i, n;
+
+	clear();
+	set_x(0);
+	set_y(0);
+	con->sb.count = 0;
+	n = vga_lines(buf, 'L', 408);
+	for (i = 0; i < n; i += 5) {
+		term_write(term, buf + i, 5);
+		if (vga_origin(con) + VGA_ROWS * VGA_COLS > con->base + VGA_SLOT_CELLS) result = FAIL;
+	}
+	if (vga_stats.wraps == wraps) result = FAIL;
+	/* 408 lines, the first 384 scrolled off */
+	if (con->sb.count != 408 - (NUM_ROWS - 1)) result = FAIL;
+	if (!vga_row_is(vga_screen(con), "L384") || !vga_row_is(vga_screen(con) + (NUM_ROWS - 2) * NUM_COLS, "L407")) result = FAIL;
+	if (!vga_row_is(vga_history_row(con, con->sb.count - 1), "L383")) result = FAIL;
+
+	/* 300 lines in one write, most go straight to the scrollback */
+	n = vga_lines(buf, 'M', 300);
+	term_write(term, buf, n);
+	if (con->sb.count != 684) result = FAIL;
+	if (!vga_row_is(vga_screen(con), "M276") || !vga_row_is(vga_history_row(con, con->sb.count - 1), "M275")) result = FAIL;
+	if (!vga_row_is(vga_history_row(con, con->sb.count - 200), "M076")) result = FAIL;
+	if (!vga_row_is(vga_history_row(con, con->sb.count - VGA_SB_LINES), "M020")) result = FAIL;
+	if (vga_history_row(con, con->sb.count - VGA_SB_LINES - 1) != NULL) result = FAIL;
+
+	con->sb.count = 0;
+	clear();
+	set_x(0);
+	set_y(0);
+	update_cursor(0, 0);
+	return result;
+}
+
+/* term_switch_test
+ * Description: output to a terminal in the background lands in its own
+ *              slot and leaves the screen alone, and switching to it and
+ *              back only points the display at the slots
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: writes a line on the next terminal
+ * Coverage: term_write, switch_term, vga_show
+ * Files: terminal.c/h, vga.c/h
+ */
+int term_switch_test() {
+	TEST_HEADER;
+	static const int8_t msg[] = "background\n";
+	int result = PASS;
+	uint8_t fg_id = current_term_id;
+	uint8_t bg_id = (fg_id + 1) % TERM_COUNT;
+	term_t* bg = &terms[bg_id];
+	uint16_t* fg_screen = vga_screen(&terms[fg_id].con);
+	uint32_t sum = 0;
+	uint32_t i, flags;
+
+	for (i = 0; i < NUM_ROWS * NUM_COLS; i++) sum += fg_screen[i] * (i + 1);
+	bg->xcopy = 0;
+	bg->ycopy = 0;
+	term_write(bg, msg, sizeof(msg) - 1);
+	for (i = 0; i < NUM_ROWS * NUM_COLS; i++) sum -= fg_screen[i] * (i + 1);
+	if (sum != 0 || vga_shown != &terms[fg_id].con) result = FAIL;
+	if (!vga_row_is(vga_screen(&bg->con), "background") || bg->xcopy != 0 || bg->ycopy != 1) result = FAIL;
+	/* vidmap hands out the first page of the slot */
+	if ((vga_page(&bg->con) & (_4KB - 1)) != 0 || vga_page(&bg->con) == vga_page(&terms[fg_id].con)) result = FAIL;
+
+	spin_lock_irqsave(&term_lock, flags);
+	switch_term(fg_id, bg_id);
+	current_term_id = bg_id;
+	if (vga_shown != &bg->con || get_x() != 0 || get_y() != 1) result = FAIL;
+	switch_term(bg_id, fg_id);
+	current_term_id = fg_id;
+	spin_unlock_irqrestore(&term_lock, flags);
+	if (vga_shown != &terms[fg_id].con) result = FAIL;
+	return result;
+}
+
+static volatile uint32_t idle_key_done;
+
+/* types Alt+F2 from a thread without a process, as the keyboard tasklet
+ * sees it when the interrupt lands on a cpu's idle thread */
+static void idle_key_body(void* arg) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	keyboard_inject(LALT_PRESS);
+	keyboard_inject(F2_KEY);
+	softirq_run();
+	restore_flags(flags);
+	idle_key_done = 1;
+}
+
+/* idle_term_launch_test
+ * Description: Alt+F2 handled on a thread with no process opens the
+ *              second terminal and gives it a shell of its own
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: terminal 2 keeps its shell, the screen is switched back
+ * Coverage: keyboard_key, terminal_launch, execute_root
+ * Files: keyboard.c/h, terminal.c/h, sys_call.c/h
+ */
+int idle_term_launch_test() {
+	TEST_HEADER;
+	int result = PASS;
+	uint8_t saved_term = current_term_id;
+	uint8_t saved_keys = held_keys;
+	term_t* term = &terms[TERMINAL_TWO];
+	uint32_t fresh = !term->activate;
+	uint32_t i;
+
+	if (saved_term == TERMINAL_TWO) return PASS;
+	idle_key_done = 0;
+	held_keys = 0;
+	if (kthread_create(idle_key_body, NULL) < 0) return FAIL;
+	for (i = 0; i < KTHREAD_TEST_YIELDS && (!idle_key_done || term->active_process_num < 0); i++) {
+		thread_yield();
+	}
+	held_keys = saved_keys;
+	if (!idle_key_done || term->activate != 1 || current_term_id != TERMINAL_TWO) result = FAIL;
+	/* a new shell is a root process on that terminal */
+	if (term->active_process_num < 0) {
+		result = FAIL;
+	} else if (fresh && (get_cur_pcb_process(term->active_process_num)->parent_process_num != term->active_process_num ||
+		get_cur_pcb_process(term->active_process_num)->term != term)) {
+		result = FAIL;
+	}
+	terminal_launch(saved_term);
+	return result;
+}
+
+/* vga_flip_test
+ * Description: a queued frame lands on its screen in one copy at the
+ *              rtc tick, and a console takes one frame at a time
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none, the next terminal's screen is put back
+ * Coverage: vga_flip_queue, vga_flip_tick, vga_flip_cancel
+ * Files: vga.c/h
+ */
+int vga_flip_test() {
+	TEST_HEADER;
+	static uint16_t saved[VGA_ROWS * VGA_COLS];
+	static uint16_t frame[VGA_ROWS * VGA_COLS];
+	vga_con_t* con = &terms[(current_term_id + 1) % TERM_COUNT].con;
+	uint16_t* screen;
+	int result = PASS;
+	uint32_t flips = vga_stats.flips;
+	uint32_t i, flags;
+
+	for (i = 0; i < VGA_ROWS * VGA_COLS; i++) frame[i] = (ATTRIB << 8) | ('a' + i % 26);
+	spin_lock_irqsave(&term_lock, flags);
+	screen = vga_screen(con);
+	memcpy(saved, screen, VGA_FRAME_BYTES);
+	if (vga_flip_queue(con, frame, NULL) != 0) result = FAIL;
+	if (vga_flip_queue(con, saved, NULL) != -1) result = FAIL;
+	vga_flip_tick();
+	for (i = 0; i < VGA_ROWS * VGA_COLS; i++) {
+		if (screen[i] != frame[i]) result = FAIL;
+	}
+	if (vga_stats.flips != flips + 1) result = FAIL;
+	if (con->flip != NULL || vga_flips_queued != 0) result = FAIL;
+	/* a cancelled frame is never copied */
+	if (vga_flip_queue(con, saved, NULL) != 0) result = FAIL;
+	vga_flip_cancel(con, saved);
+	vga_flip_tick();
+	if (screen[0] != frame[0] || vga_flips_queued != 0) result = FAIL;
+	memcpy(screen, saved, VGA_FRAME_BYTES);
+	spin_unlock_irqrestore(&term_lock, flags);
+	return result;
+}
+
+/* serial_loopback_test
+ * Description: kernel output queued on COM1 comes back through the
+ *              receive interrupt in loopback mode, in order
+ * Inputs: None
+ * Outputs: PASS/FAIL, PASS without a UART
+ * Side Effects: none, nothing reaches the line
+ * Coverage: serial_puts, serial_handler, serial_read
+ * Files: serial.c/h
+ */
+int serial_loopback_test() {
+	TEST_HEADER;
+	static const int8_t msg[] = "16550 loopback";
+	int8_t buf[sizeof(msg)];
+	int result = PASS;
+	uint32_t len = sizeof(msg) - 1;
+	uint32_t rx = serial_stats.rx_bytes;
+	uint64_t deadline = clock_ns() + 50 * NS_PER_MS;
+
+	if (!serial_stats.present) return PASS;
+	serial_loopback(1);
+	if (serial_puts(msg, len) != len) result = FAIL;
+	/* the interrupts move it, 14 bytes take about 1.2ms at 115200 baud */
+	while (serial_stats.rx_bytes - rx < len && clock_ns() < deadline);
+	serial_loopback(0);
+	if (serial_stats.rx_bytes - rx != len) return FAIL;
+	if (serial_read(0, buf, sizeof(buf)) != len || strncmp(buf, msg, len) != 0) result = FAIL;
+	return result;
+}
+
+/* klog_test
+ * Description: records come back from the ring in order with their text,
+ *              long messages are cut, and a lapped record is gone
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: logs KLOG_RECORDS + 3 debug records
+ * Coverage: klog, klog_copy, klog_format
+ * Files: klog.c/h
+ */
+int klog_test() {
+	TEST_HEADER;
+	static int8_t long_msg[KLOG_TEXT_MAX + 20];
+	klog_rec_t rec;
+	int8_t line[KLOG_LINE_MAX];
+	int result = PASS;
+	uint32_t seq = klog_stats.logged;
+	uint32_t truncated = klog_stats.truncated;
+	uint32_t i, len;
+
+	memset(long_msg, 'x', sizeof(long_msg) - 1);
+	long_msg[sizeof(long_msg) - 1] = '\0';
+	klog(KLOG_DEBUG, "klog %u", 7);
+	klog(KLOG_DEBUG, "%s", long_msg);
+	if (klog_copy(seq, &rec) != 0) return FAIL;
+	if (rec.level != KLOG_DEBUG || rec.len != 6 || strncmp(rec.text, "klog 7", 6) != 0) result = FAIL;
+	len = klog_format(&rec, line);
+	if (len < 14 || line[0] != '[' || line[len - 1] != '\n') result = FAIL;
+	if (strncmp(line + len - 14, "debug: klog 7\n", 14) != 0) result = FAIL;
+	if (klog_copy(seq + 1, &rec) != 0 || rec.len != KLOG_TEXT_MAX) result = FAIL;
+	if (klog_stats.truncated != truncated + 1) result = FAIL;
+	if (klog_copy(seq + 2, &rec) != -1) result = FAIL;
+
+	for (i = 0; i < KLOG_RECORDS; i++) {
+		klog(KLOG_DEBUG, "klog_test %u", i);
+	}
+	if (klog_copy(seq, &rec) != -1) result = FAIL;
+	if (klog_copy(seq + 2, &rec) != 0 || strncmp(rec.text, "klog_test 0", 11) != 0) result = FAIL;
+	return result;
+}
+
+/* edf_test
+ * Description: the deadline class admits budgets up to EDF_UTIL_MAX and
+ *              counts a job finished after its deadline as missed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: sched_set_deadline, sched_edf_release, sched_edf_complete
+ * Files: thread.c/h
+ */
+int edf_test() {
+	TEST_HEADER;
+	int result = PASS;
+	thread_t a, b;
+	uint32_t util = sched_stats.edf_util;
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	if (sched_set_deadline(&a, 10, 11) != -1) result = FAIL;
+	if (sched_set_deadline(&a, 10, 5) != 0) result = FAIL;
+	if (sched_stats.edf_util != util + 500) result = FAIL;
+	if (util + 1000 > EDF_UTIL_MAX && sched_set_deadline(&b, 10, 5) != -1) result = FAIL;
+
+	sched_edf_release(&a);
+	sched_edf_complete(&a);
+	if (a.edf_jobs != 1 || a.edf_misses != 0) result = FAIL;
+	sched_edf_release(&a);
+	a.edf_deadline -= a.edf_period + 1;
+	sched_edf_complete(&a);
+	if (a.edf_jobs != 2 || a.edf_misses != 1) result = FAIL;
+
+	sched_set_deadline(&a, 0, 0);
+	sched_set_deadline(&b, 0, 0);
+	if (sched_stats.edf_util != util) result = FAIL;
+	return result;
+}
+
+/* prof_cpu_ring_test
+ * Description: a timer tick lands its sample in the ring of the cpu it
+ *              ran on
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: starts and stops the profiler, drains the rings
+ * Coverage: prof_start, prof_tick, prof_read
+ * Files: profile.c/h
+ */
+int prof_cpu_ring_test() {
+	TEST_HEADER;
+	static prof_sample_t out[PROF_RING_SIZE];
+	int result = PASS;
+	intr_frame_t frame;
+	prof_ring_t* ring;
+	uint32_t flags, head;
+
+	prof_read(out, sizeof(out));
+	frame.eip = 0x8048123;
+	frame.cs = USER_CS;
+	frame.eflags = 0;
+	cli_and_save(flags);
+	ring = &prof_rings[this_cpu()->id];
+	if (prof_start(PIT_HZ) != 0) result = FAIL;
+	head = ring->head;
+	prof_tick(&frame);
+	if (ring->head != head + 1 || ring->samples[head & PROF_RING_MASK].eip != frame.eip) result = FAIL;
+	prof_stop();
+	restore_flags(flags);
+	prof_read(out, sizeof(out));
+	if (ring->head != ring->tail) result = FAIL;
+	return result;
+}
+
+/* rtc_deadline_test
+ * Description: two programs paced by the rtc at fish's 32 Hz both get
+ *              into the deadline class with the default budget
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: rtc_set_deadline, sched_set_deadline
+ * Files: rtc_handler.c/h, thread.c/h
+ */
+int rtc_deadline_test() {
+	TEST_HEADER;
+	int result = PASS;
+	thread_t a, b;
+	uint32_t util = sched_stats.edf_util;
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	if (rtc_set_deadline(&a, RTC_FREQUENCY_32) != 0) result = FAIL;
+	if (rtc_set_deadline(&b, RTC_FREQUENCY_32) != 0) result = FAIL;
+	if (a.edf_period == 0 || b.edf_period == 0) result = FAIL;
+	if (a.edf_budget * EDF_BUDGET_SHARE > a.edf_period && a.edf_budget > 1) result = FAIL;
+
+	sched_set_deadline(&a, 0, 0);
+	sched_set_deadline(&b, 0, 0);
+	if (sched_stats.edf_util != util) result = FAIL;
+	return result;
+}
+
 
 /* Test suite entry point */
 void launch_tests(){
@@ -510,4 +1641,34 @@ void launch_tests(){
 	// TEST_OUTPUT("terminal_read_test", terminal_read_test());
 	// TEST_OUTPUT("terminal_overflow_test", terminal_overflow_test());
 
+	/* Memory management */
+	TEST_OUTPUT("tlb_flush_test", tlb_flush_test());
+	TEST_OUTPUT("frame_alloc_test", frame_alloc_test());
+	TEST_OUTPUT("slab_cache_test", slab_cache_test());
+	TEST_OUTPUT("slab_stress_test", slab_stress_test());
+
+	/* Threads */
+	TEST_OUTPUT("kthread_test", kthread_test());
+	TEST_OUTPUT("fpu_test", fpu_test());
+	TEST_OUTPUT("smp_test", smp_test());
+	TEST_OUTPUT("spinlock_test", spinlock_test());
+	TEST_OUTPUT("text_cache_test", text_cache_test());
+	TEST_OUTPUT("spawn_template_test", spawn_template_test());
+	TEST_OUTPUT("edf_test", edf_test());
+	TEST_OUTPUT("prof_cpu_ring_test", prof_cpu_ring_test());
+	TEST_OUTPUT("rtc_deadline_test", rtc_deadline_test());
+	TEST_OUTPUT("irq_tasklet_test", irq_tasklet_test());
+	TEST_OUTPUT("irqtrace_test", irqtrace_test());
+	TEST_OUTPUT("clock_test", clock_test());
+	TEST_OUTPUT("timer_wheel_test", timer_wheel_test());
+	TEST_OUTPUT("rtc_virtual_test", rtc_virtual_test());
+	TEST_OUTPUT("keyboard_stress_test", keyboard_stress_test());
+	TEST_OUTPUT("terminal_write_test", terminal_write_test());
+	TEST_OUTPUT("vga_scroll_test", vga_scroll_test());
+	TEST_OUTPUT("term_switch_test", term_switch_test());
+	TEST_OUTPUT("idle_term_launch_test", idle_term_launch_test());
+	TEST_OUTPUT("vga_flip_test", vga_flip_test());
+	TEST_OUTPUT("serial_loopback_test", serial_loopback_test());
+	TEST_OUTPUT("klog_test", klog_test());
+
 }
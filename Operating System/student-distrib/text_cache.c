@@ -0,0 +1,370 @@
+#include "text_cache.h"
+#include "lib.h"
+#include "slab.h"
+#include "paging.h"
+#include "kstat.h"
+
+text_stats_t text_stats;
+
+static text_page_t* text_hash[TEXT_HASH_SIZE];
+static kmem_cache_t* text_page_cache;
+static spinlock_t text_lock = SPINLOCK_INIT("text cache");
+/* inodes with a snapshot, 0 is free (inode 0 is the directory) */
+static uint32_t text_pinned[TEXT_PIN_MAX];
+
+/*
+ *	Function: text_hash_idx
+ *	Description: hash bucket of a page of an executable
+ *	input: inode -- the executable, vaddr -- user page address
+ *	output: index in text_hash
+ *	side-effect: none
+ */
+static uint32_t text_hash_idx(uint32_t inode, uint32_t vaddr) {
+  return (inode * 31 + (vaddr >> TABLE_IDX_SHIFT)) % TEXT_HASH_SIZE;
+}
+
+/*
+ *	Function: text_find
+ *	Description: look a page up in its bucket
+ *	input: inode -- the executable, vaddr -- user page address
+ *	output: the entry, NULL if not cached
+ *	side-effect: text_lock must be held
+ */
+static text_page_t* text_find(uint32_t inode, uint32_t vaddr) {
+  text_page_t* tp;
+
+  for (tp = text_hash[text_hash_idx(inode, vaddr)]; tp != NULL; tp = tp->next) {
+    if (tp->inode == inode && tp->vaddr == vaddr) {
+      return tp;
+    }
+  }
+  return NULL;
+}
+
+/*
+ *	Function: text_is_pinned
+ *	Description: whether a snapshot holds the pages of an executable
+ *	input: inode -- the executable
+ *	output: 1 if pinned, 0 otherwise
+ *	side-effect: text_lock must be held
+ */
+static int32_t text_is_pinned(uint32_t inode) {
+  uint32_t i;
+
+  for (i = 0; i < TEXT_PIN_MAX; i++) {
+    if (text_pinned[i] == inode) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ *	Function: text_unlink
+ *	Description: drop one reference of an entry
+ *	input: link -- the pointer to the entry in its chain
+ *	output: the entry if that was the last reference, to be freed after
+ *	        the lock is dropped; NULL otherwise
+ *	side-effect: text_lock must be held, unhashes the entry
+ */
+static text_page_t* text_unlink(text_page_t** link) {
+  text_page_t* tp = *link;
+
+  if (--tp->refs > 0) {
+    return NULL;
+  }
+  *link = tp->next;
+  if (tp->vaddr & TEXT_TEMPLATE) {
+    text_stats.templates--;
+  } else {
+    text_stats.pages--;
+  }
+  return tp;
+}
+
+/*
+ *	Function: text_cache_init
+ *	Description: create the slab cache the entries come from
+ *	input: None
+ *	output: None
+ *	side-effect: without it every page stays private
+ */
+void text_cache_init() {
+  text_page_cache = kmem_cache_create("text page", sizeof(text_page_t));
+}
+
+/*
+ *	Function: text_page_get
+ *	Description: find the frame another process already filled with this
+ *	             page of the executable
+ *	input: inode -- the executable, vaddr -- user page address
+ *	output: the frame with a new reference, 0 if it is not cached
+ *	side-effect: counted as a hit
+ */
+uint32_t text_page_get(uint32_t inode, uint32_t vaddr) {
+  text_page_t* tp;
+  uint32_t frame = 0;
+  uint32_t flags;
+
+  spin_lock_irqsave(&text_lock, flags);
+  tp = text_find(inode, vaddr);
+  if (tp != NULL) {
+    tp->refs++;
+    frame = tp->frame;
+    text_stats.hits++;
+  }
+  spin_unlock_irqrestore(&text_lock, flags);
+  return frame;
+}
+
+/*
+ *	Function: text_page_add
+ *	Description: share a frame just filled from the executable. If another
+ *	             fault cached the same page meanwhile, that one wins.
+ *	input: inode -- the executable, vaddr -- user page address,
+ *	       frame -- the filled frame
+ *	output: the frame to map, with one reference taken; 0 if there was no
+ *	        memory for the entry
+ *	side-effect: frees frame when it is not the one returned
+ */
+uint32_t text_page_add(uint32_t inode, uint32_t vaddr, uint32_t frame) {
+  text_page_t* tp;
+  uint32_t idx = text_hash_idx(inode, vaddr);
+  uint32_t flags;
+
+  tp = (text_page_t*)kmem_cache_alloc(text_page_cache);
+  spin_lock_irqsave(&text_lock, flags);
+  text_stats.misses++;
+  if (text_find(inode, vaddr) != NULL || tp == NULL) {
+    spin_unlock_irqrestore(&text_lock, flags);
+    kmem_cache_free(text_page_cache, tp);
+    page_free((void*)frame);
+    return text_page_get(inode, vaddr);
+  }
+  tp->inode = inode;
+  tp->vaddr = vaddr;
+  tp->frame = frame;
+  tp->refs = 1;
+  tp->pinned = text_is_pinned(inode);
+  tp->refs += tp->pinned;
+  tp->next = text_hash[idx];
+  text_hash[idx] = tp;
+  text_stats.pages++;
+  if (text_stats.pages > text_stats.peak) {
+    text_stats.peak = text_stats.pages;
+  }
+  spin_unlock_irqrestore(&text_lock, flags);
+  return frame;
+}
+
+/*
+ *	Function: text_page_put
+ *	Description: a page table entry mapping a shared frame goes away
+ *	input: frame -- the frame from the entry
+ *	output: None
+ *	side-effect: the last reference frees the frame and its entry
+ */
+void text_page_put(uint32_t frame) {
+  text_page_t** link;
+  text_page_t* tp = NULL;
+  uint32_t i;
+  uint32_t flags;
+
+  spin_lock_irqsave(&text_lock, flags);
+  for (i = 0; i < TEXT_HASH_SIZE && tp == NULL; i++) {
+    for (link = &text_hash[i]; *link != NULL; link = &(*link)->next) {
+      if ((*link)->frame == frame) {
+        tp = text_unlink(link);
+        break;
+      }
+    }
+  }
+  spin_unlock_irqrestore(&text_lock, flags);
+  if (tp != NULL) {
+    page_free((void*)frame);
+    kmem_cache_free(text_page_cache, tp);
+  }
+}
+
+/*
+ *	Function: text_cache_pin
+ *	Description: have a snapshot hold a reference to every cached page of
+ *	             an executable, now and as they are added
+ *	input: inode -- the executable
+ *	output: 0 on success, -1 if the pin table is full
+ *	side-effect: none
+ */
+int32_t text_cache_pin(uint32_t inode) {
+  text_page_t* tp;
+  uint32_t i, slot = TEXT_PIN_MAX;
+  uint32_t flags;
+
+  spin_lock_irqsave(&text_lock, flags);
+  if (text_is_pinned(inode)) {
+    spin_unlock_irqrestore(&text_lock, flags);
+    return 0;
+  }
+  for (i = 0; i < TEXT_PIN_MAX; i++) {
+    if (text_pinned[i] == 0) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot == TEXT_PIN_MAX) {
+    spin_unlock_irqrestore(&text_lock, flags);
+    return -1;
+  }
+  text_pinned[slot] = inode;
+  for (i = 0; i < TEXT_HASH_SIZE; i++) {
+    for (tp = text_hash[i]; tp != NULL; tp = tp->next) {
+      if (tp->inode == inode && !tp->pinned) {
+        tp->pinned = 1;
+        tp->refs++;
+      }
+    }
+  }
+  spin_unlock_irqrestore(&text_lock, flags);
+  return 0;
+}
+
+/*
+ *	Function: text_cache_unpin
+ *	Description: drop the snapshot's references to an executable's pages
+ *	input: inode -- the executable
+ *	output: None
+ *	side-effect: frees the templates and every page no process maps
+ */
+void text_cache_unpin(uint32_t inode) {
+  text_page_t** link;
+  text_page_t* tp;
+  text_page_t* dead = NULL;
+  uint32_t i;
+  uint32_t flags;
+
+  spin_lock_irqsave(&text_lock, flags);
+  for (i = 0; i < TEXT_PIN_MAX; i++) {
+    if (text_pinned[i] == inode) {
+      text_pinned[i] = 0;
+    }
+  }
+  for (i = 0; i < TEXT_HASH_SIZE; i++) {
+    link = &text_hash[i];
+    while (*link != NULL) {
+      tp = *link;
+      if (tp->inode != inode || !tp->pinned) {
+        link = &tp->next;
+        continue;
+      }
+      tp->pinned = 0;
+      if (text_unlink(link) == NULL) {
+        link = &tp->next;
+        continue;
+      }
+      /* freed once the lock is dropped, next is free to reuse */
+      tp->next = dead;
+      dead = tp;
+    }
+  }
+  spin_unlock_irqrestore(&text_lock, flags);
+  while (dead != NULL) {
+    tp = dead;
+    dead = tp->next;
+    page_free((void*)tp->frame);
+    kmem_cache_free(text_page_cache, tp);
+  }
+}
+
+/*
+ *	Function: text_template_copy
+ *	Description: fill a private frame with a writable page of a pinned
+ *	             executable as it was loaded
+ *	input: inode -- the executable, vaddr -- user page address,
+ *	       dst -- the frame
+ *	output: 0 if copied, -1 if there is no template
+ *	side-effect: none
+ */
+int32_t text_template_copy(uint32_t inode, uint32_t vaddr, void* dst) {
+  text_page_t* tp;
+  uint32_t flags;
+
+  spin_lock_irqsave(&text_lock, flags);
+  tp = text_find(inode, vaddr | TEXT_TEMPLATE);
+  if (tp == NULL) {
+    spin_unlock_irqrestore(&text_lock, flags);
+    return -1;
+  }
+  memcpy(dst, (void*)tp->frame, PAGE_BYTES);
+  text_stats.copies++;
+  spin_unlock_irqrestore(&text_lock, flags);
+  return 0;
+}
+
+/*
+ *	Function: text_template_save
+ *	Description: keep a copy of a writable page just read from a pinned
+ *	             executable, so later instances skip the file system
+ *	input: inode -- the executable, vaddr -- user page address,
+ *	       src -- the filled frame, not yet written by the process
+ *	output: None
+ *	side-effect: nothing for executables without a snapshot
+ */
+void text_template_save(uint32_t inode, uint32_t vaddr, const void* src) {
+  text_page_t* tp;
+  void* frame;
+  uint32_t idx = text_hash_idx(inode, vaddr | TEXT_TEMPLATE);
+  uint32_t flags;
+
+  spin_lock_irqsave(&text_lock, flags);
+  if (!text_is_pinned(inode) || text_find(inode, vaddr | TEXT_TEMPLATE) != NULL) {
+    spin_unlock_irqrestore(&text_lock, flags);
+    return;
+  }
+  spin_unlock_irqrestore(&text_lock, flags);
+  frame = page_alloc();
+  tp = (text_page_t*)kmem_cache_alloc(text_page_cache);
+  if (frame == NULL || tp == NULL) {
+    page_free(frame);
+    kmem_cache_free(text_page_cache, tp);
+    return;
+  }
+  memcpy(frame, src, PAGE_BYTES);
+  spin_lock_irqsave(&text_lock, flags);
+  if (!text_is_pinned(inode) || text_find(inode, vaddr | TEXT_TEMPLATE) != NULL) {
+    spin_unlock_irqrestore(&text_lock, flags);
+    page_free(frame);
+    kmem_cache_free(text_page_cache, tp);
+    return;
+  }
+  tp->inode = inode;
+  tp->vaddr = vaddr | TEXT_TEMPLATE;
+  tp->frame = (uint32_t)frame;
+  tp->refs = 1;
+  tp->pinned = 1;
+  tp->next = text_hash[idx];
+  text_hash[idx] = tp;
+  text_stats.templates++;
+  spin_unlock_irqrestore(&text_lock, flags);
+}
+
+/*
+ *	Function: text_kstat
+ *	Description: append the text cache counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void text_kstat() {
+  kstat_puts("text cache: pages ");
+  kstat_putu(text_stats.pages);
+  kstat_puts(" (peak ");
+  kstat_putu(text_stats.peak);
+  kstat_puts("), hits ");
+  kstat_putu(text_stats.hits);
+  kstat_puts(", misses ");
+  kstat_putu(text_stats.misses);
+  kstat_puts(", templates ");
+  kstat_putu(text_stats.templates);
+  kstat_puts(" (");
+  kstat_putu(text_stats.copies);
+  kstat_puts(" copies)\n");
+}
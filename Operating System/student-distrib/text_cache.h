@@ -0,0 +1,56 @@
+#ifndef _TEXT_CACHE_H
+#define _TEXT_CACHE_H
+
+#include "types.h"
+
+/* read-only pages of executables, shared by every process running the
+ * same program. Keyed by inode and user page address, a page lives as
+ * long as some page table maps it. */
+#define TEXT_HASH_SIZE  64
+/* executables with a spawn snapshot, whose pages stay cached while no
+ * process maps them. Writable pages are kept as templates, copied into
+ * a private frame on every fault. */
+#define TEXT_PIN_MAX    8
+#define TEXT_TEMPLATE   0x1         /* vaddr tag of a template page */
+
+typedef struct text_page {
+    struct text_page* next;     // hash chain
+    uint32_t inode;
+    uint32_t vaddr;             // user address of the page
+    uint32_t frame;
+    uint32_t refs;              // page tables mapping the frame, plus the pin
+    uint32_t pinned;            // one of the refs belongs to a snapshot
+} text_page_t;
+
+typedef struct {
+    uint32_t hits;              // faults served from the cache
+    uint32_t misses;            // pages read from the file system
+    uint32_t pages;             // frames held right now
+    uint32_t peak;
+    uint32_t templates;         // template frames held right now
+    uint32_t copies;            // private pages filled from a template
+} text_stats_t;
+
+extern text_stats_t text_stats;
+
+/* create the entry cache, needs slab_init */
+void text_cache_init();
+/* frame of a cached page with a reference taken, 0 if not cached */
+uint32_t text_page_get(uint32_t inode, uint32_t vaddr);
+/* cache a frame just filled from the file, with one reference */
+uint32_t text_page_add(uint32_t inode, uint32_t vaddr, uint32_t frame);
+/* drop the reference of a page table entry, the last one frees the frame */
+void text_page_put(uint32_t frame);
+/* keep the pages of an executable while no process maps them, -1 if
+ * TEXT_PIN_MAX executables are pinned already */
+int32_t text_cache_pin(uint32_t inode);
+/* drop the pages only a snapshot was holding */
+void text_cache_unpin(uint32_t inode);
+/* fill dst with the page as loaded, -1 if there is no template */
+int32_t text_template_copy(uint32_t inode, uint32_t vaddr, void* dst);
+/* remember a just loaded writable page of a pinned executable */
+void text_template_save(uint32_t inode, uint32_t vaddr, const void* src);
+/* append the cache counters to the kstat report */
+void text_kstat();
+
+#endif
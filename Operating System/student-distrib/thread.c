@@ -0,0 +1,932 @@
+#include "thread.h"
+#include "lib.h"
+#include "paging.h"
+#include "sys_call.h"
+#include "x86_desc.h"
+#include "kstat.h"
+#include "fpu.h"
+#include "smp.h"
+#include "timer.h"
+#include "rtc_handler.h"
+#include "serial.h"
+#include "terminal.h"
+#include "vga.h"
+
+thread_t* threads[THREAD_MAX];
+sched_stats_t sched_stats;
+
+static uint8_t thread_stacks[THREAD_POOL][THREAD_STACK_SIZE] __attribute__((aligned(THREAD_STACK_SIZE)));
+/* every cpu has an idle thread that halts while its run queue is empty */
+static uint8_t idle_stacks[MAX_CPUS][THREAD_STACK_SIZE] __attribute__((aligned(THREAD_STACK_SIZE)));
+static work_t* work_head;
+static work_t* work_tail;
+static thread_t* kworker_thread;
+
+static void kworker(void* unused);
+static void cpu_idle(void* unused);
+static void thread_start_frame(thread_t* t, uint32_t* sp, uint32_t start, uint32_t ebx);
+
+/*
+ *	Function: thread_stack_top
+ *	Description: first word below the top of a thread's kernel stack
+ *	input: t -- the thread
+ *	output: address for tss.esp0
+ *	side-effect: none
+ */
+static uint32_t thread_stack_top(thread_t* t) {
+  return (uint32_t)t + THREAD_STACK_SIZE - 4;
+}
+
+/*
+ *	Function: idle_thread_init
+ *	Description: set up the thread header of a cpu's idle thread
+ *	input: cpu -- the cpu
+ *	output: the idle thread, not on any run queue
+ *	side-effect: none
+ */
+static thread_t* idle_thread_init(cpu_t* cpu) {
+  thread_t* t = (thread_t*)idle_stacks[cpu->id];
+
+  memset(t, 0, sizeof(thread_t));
+  t->tid = THREAD_MAX + cpu->id;
+  t->state = THREAD_IDLE;
+  t->cpu = cpu->id;
+  t->fn = cpu_idle;
+  cpu->idle = t;
+  return t;
+}
+
+/*
+ *	Function: sched_init
+ *	Description: point every main thread header at its PCB, make the boot
+ *	             context (which runs on pid 0's stack) the running thread
+ *	             of cpu 0, and start cpu 0's idle thread and kworker
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void sched_init() {
+  uint32_t i;
+  pcb_t* pcb;
+  cpu_t* cpu = &cpus[0];
+  thread_t* idle;
+
+  for (i = 0; i < THREAD_MAIN; i++) {
+    pcb = get_cur_pcb_process(i);
+    memset(&pcb->thread, 0, sizeof(thread_t));
+    pcb->thread.pcb = pcb;
+    pcb->thread.tid = i;
+  }
+  threads[0] = &get_cur_pcb_process(0)->thread;
+  threads[0]->state = THREAD_RUNNABLE;
+  threads[0]->on_cpu = 1;
+  cpu->tss = &tss;
+  cpu->curr = threads[0];
+  cpu->online = 1;
+  idle = idle_thread_init(cpu);
+  thread_start_frame(idle, (uint32_t*)(thread_stack_top(idle) + 4), (uint32_t)kthread_start, 0);
+  kthread_create(kworker, NULL);
+}
+
+/*
+ *	Function: sched_idle_stack
+ *	Description: initial esp of a cpu's idle thread, where an application
+ *	             processor starts
+ *	input: cpu_id -- index in cpus[]
+ *	output: the stack pointer
+ *	side-effect: none
+ */
+uint32_t sched_idle_stack(uint32_t cpu_id) {
+  return (uint32_t)idle_stacks[cpu_id] + THREAD_STACK_SIZE - 4;
+}
+
+/*
+ *	Function: sched_ap_main
+ *	Description: turn the boot context of an application processor into
+ *	             its idle thread and start scheduling
+ *	input: cpu -- the calling cpu, already on its idle stack
+ *	output: does not return
+ *	side-effect: marks the cpu online
+ */
+void sched_ap_main(cpu_t* cpu) {
+  thread_t* idle = idle_thread_init(cpu);
+
+  idle->on_cpu = 1;
+  cpu->curr = idle;
+  cpu->online = 1;
+  kernel_lock();
+  cpu_idle(NULL);
+}
+
+/*
+ *	Function: cpu_idle
+ *	Description: body of the idle threads, run whatever the run queues
+ *	             have and halt with the kernel lock dropped otherwise
+ *	input: unused
+ *	output: does not return
+ *	side-effect: none
+ */
+static void cpu_idle(void* unused) {
+  cli();
+  for (;;) {
+    schedule();
+    this_cpu()->idle_halts++;
+    kernel_release();
+    irqtrace_on(IRQTRACE_SITE);
+    asm volatile("sti; hlt; cli" : : : "memory");
+    irqtrace_off(EFLAGS_IF, IRQTRACE_SITE);
+    kernel_lock();
+  }
+}
+
+/*
+ *	Function: rq_push
+ *	Description: append a thread to a cpu's run queue
+ *	input: cpu -- the cpu, t -- runnable thread on no queue
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+static void rq_push(cpu_t* cpu, thread_t* t) {
+  t->rq_next = NULL;
+  if (cpu->rq_tail != NULL) {
+    cpu->rq_tail->rq_next = t;
+  } else {
+    cpu->rq_head = t;
+  }
+  cpu->rq_tail = t;
+  cpu->nr_queued++;
+  t->cpu = cpu->id;
+}
+
+/*
+ *	Function: rq_pop
+ *	Description: take the first thread off a cpu's run queue
+ *	input: cpu -- the cpu
+ *	output: the thread, NULL if the queue is empty
+ *	side-effect: interrupts must be off
+ */
+static thread_t* rq_pop(cpu_t* cpu) {
+  thread_t* t = cpu->rq_head;
+
+  if (t != NULL) {
+    cpu->rq_head = t->rq_next;
+    if (cpu->rq_head == NULL) {
+      cpu->rq_tail = NULL;
+    }
+    cpu->nr_queued--;
+    t->rq_next = NULL;
+  }
+  return t;
+}
+
+/*
+ *	Function: rq_remove
+ *	Description: take a thread off whichever run queue it is on
+ *	input: t -- the thread
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+static void rq_remove(thread_t* t) {
+  cpu_t* cpu = &cpus[t->cpu];
+  thread_t** link;
+
+  for (link = &cpu->rq_head; *link != NULL; link = &(*link)->rq_next) {
+    if (*link == t) {
+      *link = t->rq_next;
+      if (cpu->rq_tail == t) {
+        cpu->rq_tail = NULL;
+        for (t = cpu->rq_head; t != NULL; t = t->rq_next) {
+          cpu->rq_tail = t;
+        }
+      }
+      cpu->nr_queued--;
+      return;
+    }
+  }
+}
+
+/*
+ *	Function: rq_steal
+ *	Description: take the first thread of the longest run queue of
+ *	             another cpu, for a cpu that has nothing to run
+ *	input: cpu -- the idle cpu
+ *	output: the thread, NULL if every queue is empty
+ *	side-effect: interrupts must be off
+ */
+static thread_t* rq_steal(cpu_t* cpu) {
+  cpu_t* victim = NULL;
+  uint32_t i;
+
+  for (i = 0; i < MAX_CPUS; i++) {
+    if (&cpus[i] != cpu && cpus[i].nr_queued > 0 &&
+        (victim == NULL || cpus[i].nr_queued > victim->nr_queued)) {
+      victim = &cpus[i];
+    }
+  }
+  if (victim == NULL) {
+    return NULL;
+  }
+  cpu->steals++;
+  return rq_pop(victim);
+}
+
+/*
+ *	Function: edf_ready
+ *	Description: whether a thread runs in the deadline class right now,
+ *	             it drops to best effort once its budget is used up
+ *	input: t -- the thread
+ *	output: 1 if it goes ahead of best-effort threads, 0 otherwise
+ *	side-effect: none
+ */
+static int32_t edf_ready(thread_t* t) {
+  return t->edf_period != 0 && t->edf_deadline != 0 && t->edf_used < t->edf_budget;
+}
+
+/*
+ *	Function: edf_before
+ *	Description: earliest deadline first order of two deadline threads
+ *	input: a, b -- the threads
+ *	output: 1 if a is due before b
+ *	side-effect: none
+ */
+static int32_t edf_before(thread_t* a, thread_t* b) {
+  return (int32_t)(a->edf_deadline - b->edf_deadline) < 0;
+}
+
+/*
+ *	Function: rq_pop_edf
+ *	Description: take the deadline thread due first off a cpu's run queue
+ *	input: cpu -- the cpu
+ *	output: the thread, NULL if only best-effort threads are queued
+ *	side-effect: interrupts must be off
+ */
+static thread_t* rq_pop_edf(cpu_t* cpu) {
+  thread_t* t;
+  thread_t* best = NULL;
+
+  for (t = cpu->rq_head; t != NULL; t = t->rq_next) {
+    if (edf_ready(t) && (best == NULL || edf_before(t, best))) {
+      best = t;
+    }
+  }
+  if (best != NULL) {
+    rq_remove(best);
+    best->rq_next = NULL;
+  }
+  return best;
+}
+
+/*
+ *	Function: rq_edf_waiting
+ *	Description: whether a queued deadline thread should preempt the
+ *	             current one
+ *	input: cpu -- the cpu, cur -- its running thread
+ *	output: 1 if some queued thread is due before cur
+ *	side-effect: interrupts must be off
+ */
+static int32_t rq_edf_waiting(cpu_t* cpu, thread_t* cur) {
+  thread_t* t;
+
+  for (t = cpu->rq_head; t != NULL; t = t->rq_next) {
+    if (edf_ready(t) && (!edf_ready(cur) || edf_before(t, cur))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ *	Function: thread_enqueue
+ *	Description: make a thread runnable on the cpu it last ran on, or on
+ *	             an idle cpu when that one is busy
+ *	input: t -- thread on no run queue
+ *	output: None
+ *	side-effect: interrupts must be off; wakes the chosen cpu
+ */
+void thread_enqueue(thread_t* t) {
+  cpu_t* cpu = &cpus[t->cpu];
+  uint32_t i;
+
+  t->state = THREAD_RUNNABLE;
+  if (cpu->curr != cpu->idle || cpu->nr_queued > 0) {
+    for (i = 0; i < MAX_CPUS; i++) {
+      if (cpus[i].online && cpus[i].curr == cpus[i].idle && cpus[i].nr_queued == 0) {
+        cpu = &cpus[i];
+        break;
+      }
+    }
+  }
+  rq_push(cpu, t);
+  smp_resched(cpu->id);
+}
+
+/*
+ *	Function: thread_handoff
+ *	Description: account for the current thread giving this cpu to next,
+ *	             for schedule and for execute/halt, which jump straight to
+ *	             the other thread's stack
+ *	input: next -- the thread that runs from now on
+ *	output: None
+ *	side-effect: interrupts must be off; sets tss.esp0 and the FPU trap,
+ *	             and carries the kernel lock depth across
+ */
+void thread_handoff(thread_t* next) {
+  cpu_t* cpu = this_cpu();
+  thread_t* cur = get_cur_thread();
+
+  cur->on_cpu = 0;
+  cur->lock_depth = cpu->lock_depth;
+  next->on_cpu = 1;
+  next->cpu = cpu->id;
+  cpu->lock_depth = next->lock_depth;
+  cpu->curr = next;
+  cpu->tss->esp0 = thread_stack_top(next);
+  fpu_switch(cur, next);
+}
+
+/*
+ *	Function: get_cur_thread
+ *	Description: the thread whose kernel stack we are on
+ *	input: None
+ *	output: current thread
+ *	side-effect: none
+ */
+thread_t* get_cur_thread() {
+  thread_t* t;
+  asm volatile("andl %%esp, %0" : "=r"(t) : "0"(THREAD_STACK_MASK) : "cc");
+  return t;
+}
+
+/*
+ *	Function: thread_is_main
+ *	Description: check whether a thread is the main thread of a process
+ *	input: t -- the thread
+ *	output: 1 for a main thread, 0 for clone and kernel threads
+ *	side-effect: none
+ */
+int32_t thread_is_main(thread_t* t) {
+  return t->pcb != NULL && t == &t->pcb->thread;
+}
+
+/*
+ *	Function: schedule
+ *	Description: run the queued deadline thread due first, otherwise round
+ *	             robin through this cpu's run queue. A still runnable
+ *	             current thread goes to the back; with the queue empty the
+ *	             cpu steals from the busiest other queue, and runs its idle
+ *	             thread if there is nothing at all.
+ *	input: None
+ *	output: None
+ *	side-effect: interrupts must be off; switches page directory and
+ *	             tss.esp0 along with the stack
+ */
+void schedule() {
+  cpu_t* cpu = this_cpu();
+  thread_t* cur = get_cur_thread();
+  thread_t* next;
+
+  if (cur->state == THREAD_RUNNABLE) {
+    rq_push(cpu, cur);
+  }
+  next = rq_pop_edf(cpu);
+  if (next == NULL) {
+    next = rq_pop(cpu);
+  }
+  if (next == NULL) {
+    next = rq_steal(cpu);
+  }
+  if (next == NULL) {
+    next = cpu->idle;
+  }
+  if (next == cur) {
+    return;
+  }
+  /* kernel threads run in whatever address space they find */
+  if (next->pcb != NULL && next->pcb->page_dir != cpu->page_dir) {
+    load_page_directory(next->pcb->page_dir);
+  }
+  thread_handoff(next);
+  cpu->switches++;
+  sched_stats.switches++;
+  thread_switch(&cur->esp, next->esp);
+}
+
+/*
+ *	Function: sched_tick
+ *	Description: ask for preemption of the current thread when its quantum
+ *	             is used up, or at once when a deadline thread due earlier
+ *	             is queued. Only user mode is preempted, kernel code runs
+ *	             until it blocks or yields.
+ *	input: cs -- code segment the timer interrupted
+ *	output: None
+ *	side-effect: called from the timer interrupt, sched_preempt switches
+ *	             once the interrupt is acknowledged
+ */
+void sched_tick(uint32_t cs) {
+  cpu_t* cpu = this_cpu();
+  thread_t* cur = cpu->curr;
+
+  if (edf_ready(cur) && ++cur->edf_used == cur->edf_budget) {
+    sched_stats.edf_overruns++;
+  }
+  if ((cs & 3) != 3) {
+    return;
+  }
+  if (rq_edf_waiting(cpu, cur) || ++cpu->sched_ticks >= SCHED_QUANTUM) {
+    cpu->sched_ticks = 0;
+    cpu->need_resched = 1;
+  }
+}
+
+/*
+ *	Function: sched_preempt
+ *	Description: switch away from the current thread if the timer asked
+ *	             for it, at the end of an interrupt from user mode
+ *	input: cs -- code segment the interrupt came from
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+void sched_preempt(uint32_t cs) {
+  cpu_t* cpu = this_cpu();
+
+  if ((cs & 3) != 3 || !cpu->need_resched) {
+    return;
+  }
+  cpu->need_resched = 0;
+  sched_stats.preemptions++;
+  schedule();
+}
+
+/*
+ *	Function: thread_yield
+ *	Description: let other runnable threads go first, for kernel wait loops
+ *	input: None
+ *	output: None
+ *	side-effect: returns at once when no other thread can run, after
+ *	             letting the other cpus into the kernel for a moment
+ */
+void thread_yield() {
+  uint32_t flags;
+  cli_and_save(flags);
+  schedule();
+  kernel_relax();
+  restore_flags(flags);
+}
+
+/*
+ *	Function: thread_block
+ *	Description: sleep until thread_wake, interrupts must be off and the
+ *	             caller must recheck its condition afterwards
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void thread_block() {
+  get_cur_thread()->state = THREAD_BLOCKED;
+  schedule();
+}
+
+/*
+ *	Function: thread_wake
+ *	Description: make a blocked thread runnable again
+ *	input: t -- the thread, NULL is ignored
+ *	output: None
+ *	side-effect: safe from interrupt handlers
+ */
+void thread_wake(thread_t* t) {
+  if (t != NULL && t->state == THREAD_BLOCKED) {
+    thread_enqueue(t);
+  }
+}
+
+/*
+ *	Function: thread_exit
+ *	Description: end the current clone or kernel thread. Clone threads
+ *	             stay as zombies for join, kernel threads free their slot.
+ *	input: status -- returned by join
+ *	output: does not return
+ *	side-effect: none
+ */
+void thread_exit(int32_t status) {
+  thread_t* cur = get_cur_thread();
+
+  cli();
+  fpu_release(cur);
+  sched_set_deadline(cur, 0, 0);
+  cur->exit_status = status;
+  if (cur->pcb == NULL) {
+    /* the stack stays ours until schedule switches away */
+    threads[cur->tid] = NULL;
+    cur->state = THREAD_FREE;
+  } else {
+    cur->state = THREAD_ZOMBIE;
+    thread_wake(cur->joiner);
+  }
+  schedule();
+}
+
+/*
+ *	Function: thread_alloc
+ *	Description: take a pool stack and set up its thread header
+ *	input: pcb -- owning process, NULL for a kernel thread
+ *	output: the thread, not yet in threads[], NULL if the pool is empty
+ *	side-effect: interrupts must be off
+ */
+static thread_t* thread_alloc(pcb_t* pcb) {
+  thread_t* t;
+  uint32_t i;
+
+  for (i = THREAD_MAIN; i < THREAD_MAX; i++) {
+    if (threads[i] == NULL) {
+      t = (thread_t*)thread_stacks[i - THREAD_MAIN];
+      memset(t, 0, sizeof(thread_t));
+      t->pcb = pcb;
+      t->tid = i;
+      t->cpu = this_cpu()->id;
+      return t;
+    }
+  }
+  return NULL;
+}
+
+/*
+ *	Function: thread_start_frame
+ *	Description: build the frame thread_switch pops to start a new thread
+ *	input: t -- the thread, sp -- stack pointer so far,
+ *	       start -- where thread_switch returns to, ebx -- initial ebx
+ *	output: None
+ *	side-effect: sets t->esp
+ */
+static void thread_start_frame(thread_t* t, uint32_t* sp, uint32_t start, uint32_t ebx) {
+  *--sp = start;
+  *--sp = 0;              /* ebp */
+  *--sp = ebx;
+  *--sp = 0;              /* esi */
+  *--sp = 0;              /* edi */
+  *--sp = THREAD_EFLAGS;
+  t->esp = (uint32_t)sp;
+}
+
+/*
+ *	Function: thread_clone
+ *	Description: start a thread of the current process in user mode; it
+ *	             shares the page directory and fd table
+ *	input: eip -- user entry point, esp -- user stack pointer
+ *	output: tid of the new thread, -1 if no thread is free
+ *	side-effect: none
+ */
+int32_t thread_clone(uint32_t eip, uint32_t esp) {
+  thread_t* t;
+  uint32_t* sp;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  t = thread_alloc(get_cur_pcb());
+  if (t == NULL) {
+    restore_flags(flags);
+    return -1;
+  }
+  /* the iret frame thread_user_start uses to enter user mode */
+  sp = (uint32_t*)(thread_stack_top(t) + 4);
+  *--sp = USER_DS;
+  *--sp = esp;
+  *--sp = USER_EFLAGS;
+  *--sp = USER_CS;
+  *--sp = eip;
+  thread_start_frame(t, sp, (uint32_t)thread_user_start, USER_DS);
+  threads[t->tid] = t;
+  thread_enqueue(t);
+  restore_flags(flags);
+  return t->tid;
+}
+
+/*
+ *	Function: thread_join
+ *	Description: wait for a clone thread of the same process to exit
+ *	input: tid -- the thread
+ *	output: its exit status, -1 if tid is not a joinable thread
+ *	side-effect: frees the thread's slot
+ */
+int32_t thread_join(uint32_t tid) {
+  thread_t* cur = get_cur_thread();
+  thread_t* t;
+  int32_t status;
+  uint32_t flags;
+
+  if (tid < THREAD_MAIN || tid >= THREAD_MAX) {
+    return -1;
+  }
+  cli_and_save(flags);
+  t = threads[tid];
+  if (t == NULL || t == cur || t->pcb == NULL || t->pcb != cur->pcb ||
+      (t->joiner != NULL && t->joiner != cur)) {
+    restore_flags(flags);
+    return -1;
+  }
+  t->joiner = cur;
+  while (t->state != THREAD_ZOMBIE) {
+    thread_block();
+  }
+  status = t->exit_status;
+  threads[tid] = NULL;
+  t->state = THREAD_FREE;
+  restore_flags(flags);
+  return status;
+}
+
+/*
+ *	Function: thread_drop_waits
+ *	Description: take a blocked thread that is about to be freed off the
+ *	             timer wheel and out of every device's waiter slots, its
+ *	             stack is reused once it is free
+ *	input: t -- the thread, not running anywhere
+ *	output: None
+ *	side-effect: interrupts must be off
+ */
+static void thread_drop_waits(thread_t* t) {
+  if (t->wait_timer != NULL) {
+    timer_cancel(t->wait_timer);
+    t->wait_timer = NULL;
+  }
+  rtc_forget(t->tid);
+  term_forget(t->tid);
+  serial_forget(t->tid);
+  vga_flip_forget(t);
+}
+
+/*
+ *	Function: thread_reap_process
+ *	Description: drop every clone thread of a process, for halt. Threads
+ *	             running on another cpu are killed and waited for first,
+ *	             they exit on their way back to user mode. Blocked ones
+ *	             are taken off whatever they wait on.
+ *	input: pcb -- the process
+ *	output: None
+ *	side-effect: must be called from the process's main thread
+ */
+void thread_reap_process(pcb_t* pcb) {
+  uint32_t i, busy;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  do {
+    busy = 0;
+    for (i = THREAD_MAIN; i < THREAD_MAX; i++) {
+      if (threads[i] != NULL && threads[i]->pcb == pcb) {
+        threads[i]->killed = 1;
+        if (threads[i]->on_cpu) {
+          busy = 1;
+          smp_resched(threads[i]->cpu);
+        }
+      }
+    }
+    if (busy) {
+      kernel_relax();
+    }
+  } while (busy);
+  for (i = THREAD_MAIN; i < THREAD_MAX; i++) {
+    if (threads[i] != NULL && threads[i]->pcb == pcb) {
+      if (threads[i]->state == THREAD_RUNNABLE) {
+        rq_remove(threads[i]);
+      }
+      thread_drop_waits(threads[i]);
+      fpu_release(threads[i]);
+      sched_set_deadline(threads[i], 0, 0);
+      threads[i]->state = THREAD_FREE;
+      threads[i] = NULL;
+    }
+  }
+  restore_flags(flags);
+}
+
+/*
+ *	Function: kthread_main
+ *	Description: first C code of a kernel thread, called by kthread_start
+ *	input: None
+ *	output: does not return
+ *	side-effect: none
+ */
+void kthread_main() {
+  thread_t* cur = get_cur_thread();
+  /* we came out of schedule, which holds the kernel lock */
+  this_cpu()->lock_depth = 1;
+  sti();
+  cur->fn(cur->arg);
+  thread_exit(0);
+}
+
+/*
+ *	Function: kthread_create
+ *	Description: start a kernel thread. Kernel threads are never preempted,
+ *	             they run until they block, yield or return.
+ *	input: fn -- body of the thread, arg -- its argument
+ *	output: tid, -1 if no thread is free
+ *	side-effect: none
+ */
+int32_t kthread_create(void (*fn)(void*), void* arg) {
+  thread_t* t;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  t = thread_alloc(NULL);
+  if (t == NULL) {
+    restore_flags(flags);
+    return -1;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  thread_start_frame(t, (uint32_t*)(thread_stack_top(t) + 4), (uint32_t)kthread_start, 0);
+  threads[t->tid] = t;
+  thread_enqueue(t);
+  if (fn == kworker) {
+    kworker_thread = t;
+  }
+  restore_flags(flags);
+  return t->tid;
+}
+
+/*
+ *	Function: queue_work
+ *	Description: have kworker call work->fn(work->arg) in thread context
+ *	input: work -- caller owned item, not queued again while pending
+ *	output: None
+ *	side-effect: safe from interrupt handlers
+ */
+void queue_work(work_t* work) {
+  uint32_t flags;
+
+  cli_and_save(flags);
+  if (!work->pending) {
+    work->pending = 1;
+    work->next = NULL;
+    if (work_tail != NULL) {
+      work_tail->next = work;
+    } else {
+      work_head = work;
+    }
+    work_tail = work;
+    thread_wake(kworker_thread);
+  }
+  restore_flags(flags);
+}
+
+/*
+ *	Function: kworker
+ *	Description: kernel thread that runs queued work in order
+ *	input: unused
+ *	output: does not return
+ *	side-effect: none
+ */
+static void kworker(void* unused) {
+  work_t* work;
+
+  for (;;) {
+    cli();
+    while (work_head == NULL) {
+      thread_block();
+    }
+    work = work_head;
+    work_head = work->next;
+    if (work_head == NULL) {
+      work_tail = NULL;
+    }
+    work->pending = 0;
+    sched_stats.works++;
+    sti();
+    work->fn(work->arg);
+  }
+}
+
+/*
+ *	Function: sched_set_deadline
+ *	Description: move a thread into the deadline class or back out of it.
+ *	             The first job starts with the next sched_edf_release.
+ *	input: t -- the thread, period -- pit ticks between releases, 0 for
+ *	       best effort, budget -- pit ticks it may use per period
+ *	output: 0 on success, -1 if the budget would push the admitted
+ *	        utilization over EDF_UTIL_MAX
+ *	side-effect: the miss counters restart when a thread enters the class
+ */
+int32_t sched_set_deadline(thread_t* t, uint32_t period, uint32_t budget) {
+  uint32_t old_util = 0, util = 0;
+  uint32_t flags;
+
+  if (period != 0 && (budget == 0 || budget > period)) {
+    return -1;
+  }
+  cli_and_save(flags);
+  if (t->edf_period != 0) {
+    old_util = t->edf_budget * EDF_PER_MILLE / t->edf_period;
+  }
+  if (period != 0) {
+    util = budget * EDF_PER_MILLE / period;
+    if (sched_stats.edf_util - old_util + util > EDF_UTIL_MAX) {
+      sched_stats.edf_rejects++;
+      restore_flags(flags);
+      return -1;
+    }
+    if (t->edf_period == 0) {
+      t->edf_jobs = 0;
+      t->edf_misses = 0;
+    }
+  }
+  sched_stats.edf_util = sched_stats.edf_util - old_util + util;
+  t->edf_period = period;
+  t->edf_budget = budget;
+  t->edf_deadline = 0;
+  t->edf_used = 0;
+  restore_flags(flags);
+  return 0;
+}
+
+/*
+ *	Function: sched_edf_release
+ *	Description: start the next job of a deadline thread, due one period
+ *	             from now with a full budget
+ *	input: t -- the thread
+ *	output: None
+ *	side-effect: safe from interrupt handlers, call before thread_wake so
+ *	             the run queue sees the new deadline
+ */
+void sched_edf_release(thread_t* t) {
+  if (t == NULL || t->edf_period == 0) {
+    return;
+  }
+  t->edf_deadline = pit_ticks + t->edf_period;
+  if (t->edf_deadline == 0) {
+    t->edf_deadline = 1;
+  }
+  t->edf_used = 0;
+}
+
+/*
+ *	Function: sched_edf_complete
+ *	Description: the current job of a deadline thread is done, it is a
+ *	             miss if its deadline has passed
+ *	input: t -- the thread
+ *	output: None
+ *	side-effect: none before the first release
+ */
+void sched_edf_complete(thread_t* t) {
+  if (t->edf_period == 0 || t->edf_deadline == 0) {
+    return;
+  }
+  t->edf_jobs++;
+  if ((int32_t)(pit_ticks - t->edf_deadline) > 0) {
+    t->edf_misses++;
+  }
+  t->edf_deadline = 0;
+}
+
+/*
+ *	Function: sched_kstat
+ *	Description: append the scheduler counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void sched_kstat() {
+  uint32_t i, n = 0;
+
+  for (i = 0; i < THREAD_MAX; i++) {
+    if (threads[i] != NULL) {
+      n++;
+    }
+  }
+  kstat_puts("sched: threads ");
+  kstat_putu(n);
+  kstat_puts(", switches ");
+  kstat_putu(sched_stats.switches);
+  kstat_puts(", preemptions ");
+  kstat_putu(sched_stats.preemptions);
+  kstat_puts(", works ");
+  kstat_putu(sched_stats.works);
+  kstat_puts("\n");
+  kstat_puts("edf: util ");
+  kstat_putu(sched_stats.edf_util);
+  kstat_puts("/1000, rejects ");
+  kstat_putu(sched_stats.edf_rejects);
+  kstat_puts(", overruns ");
+  kstat_putu(sched_stats.edf_overruns);
+  kstat_puts("\n");
+  for (i = 0; i < THREAD_MAX; i++) {
+    thread_t* t = threads[i];
+    if (t == NULL || (t->edf_period == 0 && t->edf_jobs == 0)) {
+      continue;
+    }
+    kstat_puts("  edf ");
+    kstat_puts(t->pcb != NULL ? "pid " : "kthread ");
+    kstat_putu(t->pcb != NULL ? t->pcb->process_num : t->tid);
+    kstat_puts(" tid ");
+    kstat_putu(t->tid);
+    kstat_puts(": period ");
+    kstat_putu(t->edf_period);
+    kstat_puts(", budget ");
+    kstat_putu(t->edf_budget);
+    kstat_puts(", jobs ");
+    kstat_putu(t->edf_jobs);
+    kstat_puts(", missed ");
+    kstat_putu(t->edf_misses);
+    kstat_puts("\n");
+  }
+}
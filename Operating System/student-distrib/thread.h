@@ -0,0 +1,134 @@
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include "types.h"
+
+/* every thread runs on an 8kb kernel stack with its thread_t at the bottom,
+ * so masking esp finds the current thread. Slots 0..MAX_PID of threads[]
+ * are the main threads of the processes, whose thread_t is the start of
+ * the PCB; the rest are clone and kernel threads on pool stacks. */
+#define THREAD_STACK_SIZE 0x2000
+#define THREAD_STACK_MASK 0xFFFFE000
+#define THREAD_MAIN       6          /* MAX_PID + 1 */
+#define THREAD_POOL       16
+#define THREAD_MAX        (THREAD_MAIN + THREAD_POOL)
+
+/* a thread interrupted in user mode is switched out after this many ticks */
+#define SCHED_QUANTUM     10
+/* deadline class: a periodic thread runs ahead of best-effort work for
+ * its budget in every period, earliest deadline first. The admitted
+ * budgets may add up to EDF_UTIL_MAX per mille of one cpu. */
+#define EDF_UTIL_MAX      900
+#define EDF_PER_MILLE     1000
+#define EDF_BUDGET_SHARE  8          /* default budget is an eighth of the period, at least a tick */
+#define THREAD_EFLAGS     0x00000002 /* interrupts off until the thread's own context is restored */
+#define USER_EFLAGS       0x00000202
+
+#define THREAD_FREE       0
+#define THREAD_RUNNABLE   1
+#define THREAD_BLOCKED    2          /* waiting for thread_wake */
+#define THREAD_EXEC       3          /* waiting in execute for its child to halt */
+#define THREAD_ZOMBIE     4          /* exited, waiting for join */
+#define THREAD_IDLE       5          /* a cpu's idle thread, never queued */
+
+struct pcb;
+struct cpu;
+struct ktimer;
+
+typedef struct thread {
+    struct pcb* pcb;            // owning process, NULL for kernel threads
+    uint32_t esp;               // saved kernel esp while switched out
+    uint32_t state;
+    uint32_t tid;               // slot in threads[]
+    int32_t exit_status;
+    struct thread* joiner;      // thread blocked in join on this one
+    void (*fn)(void*);          // kernel threads: body and its argument
+    void* arg;
+    void* fpu;                  // FXSAVE area, allocated on first FP use
+    struct thread* rq_next;     // next on the run queue of cpus[cpu]
+    uint32_t cpu;               // cpu it runs or last ran on
+    uint32_t on_cpu;            // its stack is in use by some cpu
+    uint32_t killed;            // exit instead of returning to user mode
+    uint32_t lock_depth;        // kernel lock depth while switched out
+    uint32_t in_softirq;        // running tasklets on this stack
+    uint32_t edf_period;        // pit ticks between releases, 0 for best effort
+    uint32_t edf_budget;        // pit ticks per period it runs ahead of best effort
+    uint32_t edf_deadline;      // pit_ticks by which the current job is due, 0 before the first release
+    uint32_t edf_used;          // ticks run in the current job
+    uint32_t edf_jobs;          // jobs finished
+    uint32_t edf_misses;        // jobs finished after their deadline
+    uint32_t io_timed;          // in read_timeout, blocking reads stop at io_deadline
+    uint32_t io_deadline;       // pit tick
+    struct ktimer* wait_timer;  // on its stack while in timer_block_until, for thread_reap_process
+} thread_t;
+
+/* deferred work run by the kworker kernel thread */
+typedef struct work {
+    void (*fn)(void*);
+    void* arg;
+    struct work* next;
+    uint32_t pending;           // queued and not yet started
+} work_t;
+
+typedef struct {
+    uint32_t switches;          // context switches
+    uint32_t preemptions;       // switches forced by the timer
+    uint32_t works;             // work items run by kworker
+    uint32_t edf_util;          // admitted budget/period, per mille
+    uint32_t edf_rejects;       // deadline requests over EDF_UTIL_MAX
+    uint32_t edf_overruns;      // jobs that used up their budget
+} sched_stats_t;
+
+extern thread_t* threads[THREAD_MAX];
+extern sched_stats_t sched_stats;
+
+/* set up the main thread headers and start kworker */
+void sched_init();
+/* idle thread stack an application processor boots on, and its entry */
+uint32_t sched_idle_stack(uint32_t cpu_id);
+void sched_ap_main(struct cpu* cpu);
+/* timer hook, preempts user mode every SCHED_QUANTUM ticks */
+void sched_tick(uint32_t cs);
+/* end of an interrupt, switch if sched_tick asked to */
+void sched_preempt(uint32_t cs);
+/* switch to the next runnable thread, interrupts must be off */
+void schedule();
+
+thread_t* get_cur_thread();
+int32_t thread_is_main(thread_t* t);
+void thread_yield();
+void thread_block();
+void thread_wake(thread_t* t);
+/* put a thread on a run queue, interrupts must be off */
+void thread_enqueue(thread_t* t);
+/* give this cpu to next, for execute/halt which switch stacks themselves */
+void thread_handoff(thread_t* next);
+void thread_exit(int32_t status);
+
+/* new user thread of the current process, iret to eip with esp */
+int32_t thread_clone(uint32_t eip, uint32_t esp);
+int32_t thread_join(uint32_t tid);
+/* free every clone thread of a process that is going away */
+void thread_reap_process(struct pcb* pcb);
+
+/* kernel threads and deferred work */
+int32_t kthread_create(void (*fn)(void*), void* arg);
+void queue_work(work_t* work);
+
+/* deadline class: period and budget in pit ticks, period 0 goes back to
+ * best effort. -1 if the budget does not fit, the thread stays best effort. */
+int32_t sched_set_deadline(thread_t* t, uint32_t period, uint32_t budget);
+/* start the next job of a periodic thread, from the interrupt that paces it */
+void sched_edf_release(thread_t* t);
+/* the current job is done, count it as met or missed */
+void sched_edf_complete(thread_t* t);
+
+/* append the scheduler counters to the kstat report */
+void sched_kstat();
+
+/* exec.S */
+extern void thread_switch(uint32_t* old_esp, uint32_t new_esp);
+extern void thread_user_start(void);
+extern void kthread_start(void);
+
+#endif
@@ -0,0 +1,424 @@
+#include "timer.h"
+#include "lib.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "irq.h"
+#include "sys_call.h"
+#include "kstat.h"
+
+static spinlock_t timer_lock = SPINLOCK_INIT("timer");
+static timer_wheel_t timer_wheel = { .lock = &timer_lock };
+static void timer_run(void* arg);
+static tasklet_t timer_tasklet = { timer_run, NULL, NULL, 0 };
+
+/*
+ *	Function: wheel_init
+ *	Description: empty wheel
+ *	input: w -- the wheel, clk -- its first tick, lock -- what serializes
+ *	       it, NULL if only one thread uses it
+ *	output: None
+ *	side-effect: none
+ */
+void wheel_init(timer_wheel_t* w, uint32_t clk, spinlock_t* lock) {
+  memset(w, 0, sizeof(timer_wheel_t));
+  w->clk = clk;
+  w->lock = lock;
+}
+
+/*
+ *	Function: wheel_slot
+ *	Description: the list a timer goes on: the root slot of its tick if
+ *	             it is due within TIMER_ROOT_SIZE ticks, or else the slot of
+ *	             the lowest level that reaches it, indexed by the bits of
+ *	             expires for that level
+ *	input: w -- the wheel, expires -- tick the timer fires at
+ *	output: head of the list
+ *	side-effect: none
+ */
+static ktimer_t** wheel_slot(timer_wheel_t* w, uint32_t expires) {
+  uint32_t delta = expires - w->clk;
+  uint32_t level, shift;
+
+  if ((int32_t)delta < 0) {
+    /* already due, run it on the next tick */
+    return &w->root[w->clk & TIMER_ROOT_MASK];
+  }
+  if (delta < TIMER_ROOT_SIZE) {
+    return &w->root[expires & TIMER_ROOT_MASK];
+  }
+  if (delta > TIMER_MAX_DELTA) {
+    expires = w->clk + TIMER_MAX_DELTA;
+    delta = TIMER_MAX_DELTA;
+  }
+  shift = TIMER_ROOT_BITS;
+  for (level = 0; level < TIMER_LEVELS - 1; level++) {
+    if (delta < 1U << (shift + TIMER_LVL_BITS)) {
+      break;
+    }
+    shift += TIMER_LVL_BITS;
+  }
+  return &w->lvl[level][(expires >> shift) & TIMER_LVL_MASK];
+}
+
+/*
+ *	Function: wheel_link
+ *	Description: put a timer at the head of a slot list
+ *	input: w -- the wheel, t -- unqueued timer
+ *	output: None
+ *	side-effect: none
+ */
+static void wheel_link(timer_wheel_t* w, ktimer_t* t) {
+  ktimer_t** head = wheel_slot(w, t->expires);
+
+  t->next = *head;
+  if (t->next != NULL) {
+    t->next->pprev = &t->next;
+  }
+  t->pprev = head;
+  *head = t;
+}
+
+/*
+ *	Function: wheel_unlink
+ *	Description: take a queued timer off its list
+ *	input: t -- the timer
+ *	output: None
+ *	side-effect: none
+ */
+static void wheel_unlink(ktimer_t* t) {
+  *t->pprev = t->next;
+  if (t->next != NULL) {
+    t->next->pprev = t->pprev;
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+/*
+ *	Function: wheel_add
+ *	Description: queue a timer at t->expires
+ *	input: w -- the wheel, t -- unqueued timer
+ *	output: None
+ *	side-effect: none
+ */
+void wheel_add(timer_wheel_t* w, ktimer_t* t) {
+  wheel_link(w, t);
+  w->count++;
+  w->stats.added++;
+  if (w->count > w->stats.max_queued) {
+    w->stats.max_queued = w->count;
+  }
+}
+
+/*
+ *	Function: wheel_del
+ *	Description: dequeue a timer if it is queued
+ *	input: w -- the wheel, t -- the timer
+ *	output: 1 if it was queued, 0 if it had fired or was never added
+ *	side-effect: none
+ */
+int32_t wheel_del(timer_wheel_t* w, ktimer_t* t) {
+  if (t->pprev == NULL) {
+    return 0;
+  }
+  wheel_unlink(t);
+  w->count--;
+  w->stats.cancelled++;
+  return 1;
+}
+
+/*
+ *	Function: wheel_cascade
+ *	Description: move every timer of one upper slot to the level it
+ *	             belongs on now
+ *	input: w -- the wheel, level -- index in lvl, index -- slot
+ *	output: the slot index, 0 means the level above has to cascade too
+ *	side-effect: none
+ */
+static uint32_t wheel_cascade(timer_wheel_t* w, uint32_t level, uint32_t index) {
+  ktimer_t* t = w->lvl[level][index];
+  ktimer_t* next;
+
+  w->lvl[level][index] = NULL;
+  for (; t != NULL; t = next) {
+    next = t->next;
+    wheel_link(w, t);
+    w->stats.cascaded++;
+  }
+  return index;
+}
+
+/*
+ *	Function: wheel_advance
+ *	Description: turn the wheel one tick at a time up to now, cascading an
+ *	             upper slot each time the level below wraps, and run the
+ *	             root slot of each tick. A timer may re-add itself.
+ *	input: w -- the wheel, now -- last tick to run
+ *	output: None
+ *	side-effect: the wheel's lock is dropped around each callback
+ */
+void wheel_advance(timer_wheel_t* w, uint32_t now) {
+  ktimer_t* t;
+  uint32_t index, level, shift;
+
+  while ((int32_t)(now - w->clk) >= 0) {
+    if (w->count == 0) {
+      /* nothing to cascade or run, skip straight there */
+      w->clk = now + 1;
+      break;
+    }
+    index = w->clk & TIMER_ROOT_MASK;
+    shift = TIMER_ROOT_BITS;
+    for (level = 0; index == 0 && level < TIMER_LEVELS; level++) {
+      index = wheel_cascade(w, level, (w->clk >> shift) & TIMER_LVL_MASK);
+      shift += TIMER_LVL_BITS;
+    }
+    index = w->clk & TIMER_ROOT_MASK;
+    w->clk++;
+    while ((t = w->root[index]) != NULL) {
+      wheel_unlink(t);
+      w->count--;
+      w->stats.expired++;
+      if (w->lock != NULL) {
+        spin_unlock(w->lock);
+      }
+      t->fn(t->arg);
+      if (w->lock != NULL) {
+        spin_lock(w->lock);
+      }
+    }
+  }
+}
+
+/*
+ *	Function: timer_setup
+ *	Description: prepare a timer before its first timer_add
+ *	input: t -- the timer, fn/arg -- what it runs
+ *	output: None
+ *	side-effect: none
+ */
+void timer_setup(ktimer_t* t, void (*fn)(void*), void* arg) {
+  t->next = NULL;
+  t->pprev = NULL;
+  t->expires = 0;
+  t->fn = fn;
+  t->arg = arg;
+}
+
+/*
+ *	Function: timer_add
+ *	Description: arm a timer, moving it if it was armed already
+ *	input: t -- the timer, expires -- tick to fire at
+ *	output: None
+ *	side-effect: none
+ */
+void timer_add(ktimer_t* t, uint32_t expires) {
+  uint32_t flags;
+
+  spin_lock_irqsave(&timer_lock, flags);
+  wheel_del(&timer_wheel, t);
+  t->expires = expires;
+  wheel_add(&timer_wheel, t);
+  spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/*
+ *	Function: timer_cancel
+ *	Description: disarm a timer
+ *	input: t -- the timer
+ *	output: 1 if it was armed, 0 if it already fired
+ *	side-effect: the callback may still be running on another cpu
+ */
+int32_t timer_cancel(ktimer_t* t) {
+  uint32_t flags;
+  int32_t armed;
+
+  spin_lock_irqsave(&timer_lock, flags);
+  armed = wheel_del(&timer_wheel, t);
+  spin_unlock_irqrestore(&timer_lock, flags);
+  return armed;
+}
+
+/*
+ *	Function: timer_run
+ *	Description: tasklet, run the timers that came due
+ *	input: arg -- unused
+ *	output: None
+ *	side-effect: callbacks run with interrupts off
+ */
+static void timer_run(void* arg) {
+  uint32_t flags;
+
+  spin_lock_irqsave(&timer_lock, flags);
+  wheel_advance(&timer_wheel, pit_ticks);
+  spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/*
+ *	Function: timer_tick
+ *	Description: PIT hook; the wheel only needs turning when it holds
+ *	             timers, an empty wheel catches up in one step
+ *	input: None
+ *	output: None
+ *	side-effect: interrupts are off
+ */
+void timer_tick() {
+  spin_lock(&timer_lock);
+  if (timer_wheel.count == 0) {
+    timer_wheel.clk = pit_ticks + 1;
+  }
+  spin_unlock(&timer_lock);
+  if (timer_wheel.count != 0) {
+    tasklet_schedule(&timer_tasklet);
+  }
+}
+
+/*
+ *	Function: timer_wake
+ *	Description: timer callback of a blocked thread
+ *	input: arg -- the thread
+ *	output: None
+ *	side-effect: none
+ */
+static void timer_wake(void* arg) {
+  thread_wake((thread_t*)arg);
+}
+
+/*
+ *	Function: timer_block_until
+ *	Description: block the current thread until something wakes it or
+ *	             the deadline passes
+ *	input: deadline -- pit tick
+ *	output: 0 if woken before the deadline, -1 once it has passed
+ *	side-effect: interrupts must be off, like thread_block
+ */
+int32_t timer_block_until(uint32_t deadline) {
+  thread_t* cur = get_cur_thread();
+  ktimer_t timer;
+
+  if ((int32_t)(pit_ticks - deadline) >= 0) {
+    return -1;
+  }
+  timer_setup(&timer, timer_wake, cur);
+  timer_add(&timer, deadline);
+  cur->wait_timer = &timer;
+  thread_block();
+  cur->wait_timer = NULL;
+  timer_cancel(&timer);
+  return (int32_t)(pit_ticks - deadline) >= 0 ? -1 : 0;
+}
+
+/*
+ *	Function: timer_block_io
+ *	Description: block a thread waiting in a device read
+ *	input: None
+ *	output: 0 if woken, -1 if the read_timeout deadline has passed
+ *	side-effect: interrupts must be off
+ */
+int32_t timer_block_io() {
+  thread_t* cur = get_cur_thread();
+
+  if (!cur->io_timed) {
+    thread_block();
+    return 0;
+  }
+  return timer_block_until(cur->io_deadline);
+}
+
+/*
+ *	Function: timer_io_expired
+ *	Description: check the read_timeout deadline of the current thread
+ *	input: None
+ *	output: 1 if it has passed, 0 if it has not or there is none
+ *	side-effect: none
+ */
+int32_t timer_io_expired() {
+  thread_t* cur = get_cur_thread();
+
+  return cur->io_timed && (int32_t)(pit_ticks - cur->io_deadline) >= 0;
+}
+
+/*
+ *	Function: ns_to_deadline
+ *	Description: round a wait up to whole ticks; a tick already under way
+ *	             does not count, so the wait is never short
+ *	input: ns -- nanoseconds
+ *	output: absolute pit tick
+ *	side-effect: none
+ */
+uint32_t ns_to_deadline(uint64_t ns) {
+  uint64_t ticks = ns + NS_PER_TICK - 1;
+
+  div64_32(&ticks, NS_PER_TICK);
+  if (ticks > TIMER_MAX_DELTA) {
+    ticks = TIMER_MAX_DELTA;
+  }
+  return pit_ticks + (uint32_t)ticks + 1;
+}
+
+/*
+ *	Function: nanosleep
+ *	Description: system call, block for at least the given time
+ *	input: req -- how long, nsec below one second
+ *	output: 0, -1 for a bad timespec
+ *	side-effect: none
+ */
+int32_t nanosleep(const timespec_t* req) {
+  thread_t* cur = get_cur_thread();
+  uint32_t deadline, flags;
+
+  if ((uint32_t)req < _128MB || (uint32_t)(req + 1) > USER_END || req->nsec >= NS_PER_SEC) {
+    return -1;
+  }
+  deadline = ns_to_deadline((uint64_t)req->sec * NS_PER_SEC + req->nsec);
+  cli_and_save(flags);
+  while (!cur->killed && timer_block_until(deadline) == 0) {
+  }
+  restore_flags(flags);
+  return 0;
+}
+
+/*
+ *	Function: read_timeout
+ *	Description: system call, read that gives up after ms milliseconds;
+ *	             the device's blocking wait checks the thread's deadline
+ *	input: fd, buf, nbytes -- as for read, ms -- longest wait, 0 only
+ *	       takes what is ready now
+ *	output: as read, -1 when the time ran out
+ *	side-effect: none
+ */
+int32_t read_timeout(int32_t fd, void* buf, int32_t nbytes, uint32_t ms) {
+  thread_t* cur = get_cur_thread();
+  int32_t ret;
+
+  cur->io_deadline = ms == 0 ? pit_ticks : ns_to_deadline((uint64_t)ms * NS_PER_MS);
+  cur->io_timed = 1;
+  ret = read(fd, buf, nbytes);
+  cur->io_timed = 0;
+  return ret;
+}
+
+/*
+ *	Function: timer_kstat
+ *	Description: append the timer counters to the kstat report
+ *	input: None
+ *	output: None
+ *	side-effect: none
+ */
+void timer_kstat() {
+  timer_stats_t* stats = &timer_wheel.stats;
+
+  kstat_puts("timers: queued ");
+  kstat_putu(timer_wheel.count);
+  kstat_puts(" (max ");
+  kstat_putu(stats->max_queued);
+  kstat_puts("), added ");
+  kstat_putu(stats->added);
+  kstat_puts(", cancelled ");
+  kstat_putu(stats->cancelled);
+  kstat_puts(", expired ");
+  kstat_putu(stats->expired);
+  kstat_puts(", cascaded ");
+  kstat_putu(stats->cascaded);
+  kstat_puts("\n");
+}
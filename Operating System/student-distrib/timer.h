@@ -0,0 +1,85 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+#include "clock.h"
+#include "pit.h"
+#include "spinlock.h"
+
+/* hierarchical timer wheel in PIT ticks. Level 0 has a slot for each of
+ * the next 256 ticks; each level above covers 64 times the span of the
+ * one below, and its slots are cascaded down as the wheel turns, so
+ * adding, cancelling and expiring a timer are all O(1). Timers further
+ * out than TIMER_MAX_DELTA fire at TIMER_MAX_DELTA. */
+#define TIMER_ROOT_BITS   8
+#define TIMER_ROOT_SIZE   (1 << TIMER_ROOT_BITS)
+#define TIMER_ROOT_MASK   (TIMER_ROOT_SIZE - 1)
+#define TIMER_LVL_BITS    6
+#define TIMER_LVL_SIZE    (1 << TIMER_LVL_BITS)
+#define TIMER_LVL_MASK    (TIMER_LVL_SIZE - 1)
+#define TIMER_LEVELS      3           /* above the root */
+#define TIMER_MAX_DELTA   ((1 << (TIMER_ROOT_BITS + TIMER_LEVELS * TIMER_LVL_BITS)) - 1)
+
+#define NS_PER_TICK       (NS_PER_SEC / PIT_HZ)
+#define MS_PER_TICK       (1000 / PIT_HZ)
+
+typedef struct ktimer {
+    struct ktimer* next;
+    struct ktimer** pprev;      // the pointer to this timer, NULL when not queued
+    uint32_t expires;           // tick it fires at
+    void (*fn)(void*);          // runs with interrupts off
+    void* arg;
+} ktimer_t;
+
+typedef struct {
+    uint32_t added;
+    uint32_t cancelled;
+    uint32_t expired;
+    uint32_t cascaded;          // timers moved down a level
+    uint32_t max_queued;
+} timer_stats_t;
+
+typedef struct {
+    uint32_t clk;               // next tick to run
+    uint32_t count;             // timers queued
+    spinlock_t* lock;           // held by the caller, dropped around callbacks
+    timer_stats_t stats;
+    ktimer_t* root[TIMER_ROOT_SIZE];
+    ktimer_t* lvl[TIMER_LEVELS][TIMER_LVL_SIZE];
+} timer_wheel_t;
+
+/* a wheel whose next tick is clk; the kernel one is driven by the PIT and
+ * keeps in step with pit_ticks on its own */
+void wheel_init(timer_wheel_t* w, uint32_t clk, spinlock_t* lock);
+void wheel_add(timer_wheel_t* w, ktimer_t* t);
+/* 1 if the timer was queued */
+int32_t wheel_del(timer_wheel_t* w, ktimer_t* t);
+/* run every timer due up to and including tick now */
+void wheel_advance(timer_wheel_t* w, uint32_t now);
+
+void timer_setup(ktimer_t* t, void (*fn)(void*), void* arg);
+/* (re)arm a timer for an absolute tick, and disarm it; 1 if it was armed */
+void timer_add(ktimer_t* t, uint32_t expires);
+int32_t timer_cancel(ktimer_t* t);
+/* PIT hook, hands expiry to a tasklet */
+void timer_tick();
+
+/* thread_block that gives up at tick deadline: 0 if woken, -1 once the
+ * deadline has passed. Interrupts must be off. */
+int32_t timer_block_until(uint32_t deadline);
+/* the blocking wait of a device read: thread_block, bounded by the
+ * deadline of read_timeout when one is running. -1 once it has passed. */
+int32_t timer_block_io();
+/* for reads that poll: 1 once the read_timeout deadline has passed */
+int32_t timer_io_expired();
+/* tick at which a wait of ns nanoseconds from now is over */
+uint32_t ns_to_deadline(uint64_t ns);
+
+/* system calls */
+int32_t nanosleep(const timespec_t* req);
+int32_t read_timeout(int32_t fd, void* buf, int32_t nbytes, uint32_t ms);
+
+/* append the timer counters to the kstat report */
+void timer_kstat();
+
+#endif
@@ -21,6 +21,9 @@ typedef unsigned short uint16_t;
 typedef char int8_t;
 typedef unsigned char uint8_t;
 
+typedef long long int64_t;
+typedef unsigned long long uint64_t;
+
 #endif /* ASM */
 
 #endif /* _TYPES_H */
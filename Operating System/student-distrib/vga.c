@@ -0,0 +1,336 @@
+#include "vga.h"
+#include "lib.h"
+#include "thread.h"
+
+vga_stats_t vga_stats;
+/* printf has a screen before the terminals exist */
+static vga_con_t vga_boot;
+vga_con_t* vga_shown = &vga_boot;
+static uint32_t vga_back;           // rows the view is scrolled back, 0 shows the live screen
+volatile uint32_t vga_flips_queued;
+static vga_con_t* vga_flip_q[VGA_SLOTS];
+
+/*
+ *	Function: vga_set_start
+ *	Description: show the window from a cell on
+ *	input: cell -- offset in cells from VIDEO
+ *	output: none
+ *	side-effect: writes the CRTC start address
+ */
+static void vga_set_start(uint32_t cell) {
+  outb(VGA_START_HIGH, VGA_CRTC_INDEX);
+  outb((cell >> 8) & 0xFF, VGA_CRTC_DATA);
+  outb(VGA_START_LOW, VGA_CRTC_INDEX);
+  outb(cell & 0xFF, VGA_CRTC_DATA);
+}
+
+/*
+ *	Function: vga_con_init
+ *	Description: set a console up at the start of a slot, blank
+ *	input: con -- the console, slot -- below VGA_VIEW_SLOT
+ *	output: none
+ *	side-effect: clears the screen in the slot
+ */
+void vga_con_init(vga_con_t* con, uint32_t slot) {
+  con->base = slot * VGA_SLOT_CELLS;
+  con->top = 0;
+  con->pins = 0;
+  con->flip = NULL;
+  con->flip_waiter = NULL;
+  con->sb.count = 0;
+  memset_word(vga_screen(con), VGA_BLANK, VGA_ROWS * VGA_COLS);
+}
+
+/*
+ *	Function: vga_screen
+ *	Description: where a console's screen is in the window
+ *	input: con -- the console
+ *	output: its first cell
+ *	side-effect: none
+ */
+uint16_t* vga_screen(vga_con_t* con) {
+  return (uint16_t*)VIDEO + vga_origin(con);
+}
+
+/*
+ *	Function: vga_origin
+ *	Description: a console's screen as a cell offset, the start address
+ *	             and the cursor are counted from the start of the window
+ *	input: con -- the console
+ *	output: the offset
+ *	side-effect: none
+ */
+uint32_t vga_origin(vga_con_t* con) {
+  return con->base + con->top * VGA_COLS;
+}
+
+/*
+ *	Function: vga_page
+ *	Description: the first page of a console's slot, where its screen
+ *	             stays while a process has it mapped
+ *	input: con -- the console
+ *	output: physical address
+ *	side-effect: none
+ */
+uint32_t vga_page(vga_con_t* con) {
+  return VIDEO + con->base * 2;
+}
+
+/*
+ *	Function: vga_scroll
+ *	Description: scroll a screen up. The rows leaving the top go to the
+ *	             scrollback, then the screen moves down its slot; it is
+ *	             only copied when it would run past the end of the slot,
+ *	             or when vidmap holds it in place. Past a screen's worth
+ *	             the extra rows are saved blank, for the caller to fill
+ *	             through vga_history_row.
+ *	input: con -- the console, rows -- rows to scroll
+ *	output: scrollback index of the first row that left the screen
+ *	side-effect: clears the new bottom rows; term_lock must be held
+ */
+uint32_t vga_scroll(vga_con_t* con, uint32_t rows) {
+  uint16_t* screen = vga_screen(con);
+  uint32_t first = con->sb.count;
+  uint32_t shown, extra, i;
+
+  if (rows == 0) {
+    return first;
+  }
+  shown = rows < VGA_ROWS ? rows : VGA_ROWS;
+  for (i = 0; i < shown; i++) {
+    memcpy(con->sb.lines[con->sb.count++ & VGA_SB_MASK], screen + i * VGA_COLS, VGA_COLS * 2);
+  }
+  /* only the last VGA_SB_LINES of the extra rows can still be seen */
+  extra = rows - shown;
+  if (extra > VGA_SB_LINES) {
+    con->sb.count += extra - VGA_SB_LINES;
+    extra = VGA_SB_LINES;
+  }
+  for (i = 0; i < extra; i++) {
+    memset_word(con->sb.lines[con->sb.count++ & VGA_SB_MASK], VGA_BLANK, VGA_COLS);
+  }
+
+  if (con->pins == 0 && con->top + VGA_ROWS + shown <= VGA_SLOT_ROWS) {
+    con->top += shown;
+  } else {
+    /* wrap, or scroll in place while pinned */
+    if (con->pins == 0) {
+      con->top = 0;
+      vga_stats.wraps++;
+    }
+    memmove(vga_screen(con), screen + shown * VGA_COLS, (VGA_ROWS - shown) * VGA_COLS * 2);
+  }
+  memset_word(vga_screen(con) + (VGA_ROWS - shown) * VGA_COLS, VGA_BLANK, shown * VGA_COLS);
+  if (con == vga_shown) {
+    vga_back = 0;
+    vga_set_start(vga_origin(con));
+  }
+  vga_stats.rows += rows;
+  return first;
+}
+
+/*
+ *	Function: vga_history_row
+ *	Description: find a row of a console's scrollback
+ *	input: con -- the console, index -- as returned by vga_scroll
+ *	output: the row, NULL if it was never saved or has been overwritten
+ *	side-effect: none
+ */
+uint16_t* vga_history_row(vga_con_t* con, uint32_t index) {
+  if (index >= con->sb.count || con->sb.count - index > VGA_SB_LINES) {
+    return NULL;
+  }
+  return con->sb.lines[index & VGA_SB_MASK];
+}
+
+/*
+ *	Function: vga_show
+ *	Description: put a console on display. Its screen is already in its
+ *	             slot, so this only moves the start address.
+ *	input: con -- the console
+ *	output: none
+ *	side-effect: leaves any scrollback view; term_lock must be held
+ */
+void vga_show(vga_con_t* con) {
+  vga_back = 0;
+  vga_shown = con;
+  vga_set_start(vga_origin(con));
+  vga_stats.shows++;
+}
+
+/*
+ *	Function: vga_view
+ *	Description: show the screen scrolled back into the scrollback. The
+ *	             view is put together in the view slot, so output carries
+ *	             on underneath it.
+ *	input: rows -- rows further back, negative to come forward
+ *	output: none
+ *	side-effect: moves the start address; term_lock must be held
+ */
+void vga_view(int32_t rows) {
+  vga_con_t* con = vga_shown;
+  uint32_t saved = con->sb.count < VGA_SB_LINES ? con->sb.count : VGA_SB_LINES;
+  int32_t back = (int32_t)vga_back + rows;
+  uint16_t* view = (uint16_t*)VIDEO + VGA_VIEW_SLOT * VGA_SLOT_CELLS;
+  uint32_t i;
+
+  if (back < 0) {
+    back = 0;
+  }
+  if (back > saved) {
+    back = saved;
+  }
+  if (back == vga_back) {
+    return;
+  }
+  vga_back = back;
+  if (back == 0) {
+    vga_set_start(vga_origin(con));
+    return;
+  }
+  for (i = 0; i < VGA_ROWS; i++) {
+    if (i < back) {
+      memcpy(view + i * VGA_COLS, con->sb.lines[(con->sb.count - back + i) & VGA_SB_MASK], VGA_COLS * 2);
+    } else {
+      memcpy(view + i * VGA_COLS, vga_screen(con) + (i - back) * VGA_COLS, VGA_COLS * 2);
+    }
+  }
+  vga_set_start(VGA_VIEW_SLOT * VGA_SLOT_CELLS);
+}
+
+/*
+ *	Function: vga_view_live
+ *	Description: leave the scrollback for the live screen
+ *	input: none
+ *	output: none
+ *	side-effect: moves the start address
+ */
+void vga_view_live() {
+  if (vga_back != 0) {
+    vga_back = 0;
+    vga_set_start(vga_origin(vga_shown));
+  }
+}
+
+/*
+ *	Function: vga_pin
+ *	Description: a process maps the first page of the slot with vidmap
+ *	             and draws there, so bring the screen back to the start
+ *	             of the slot and scroll it in place until the last such
+ *	             process ends
+ *	input: con -- the console
+ *	output: none
+ *	side-effect: the caller moves the cursor; term_lock must be held
+ */
+void vga_pin(vga_con_t* con) {
+  if (con->pins++ == 0 && con->top != 0) {
+    memmove((uint16_t*)VIDEO + con->base, vga_screen(con), VGA_ROWS * VGA_COLS * 2);
+    con->top = 0;
+    if (con == vga_shown) {
+      vga_back = 0;
+      vga_set_start(vga_origin(con));
+    }
+  }
+}
+
+/*
+ *	Function: vga_unpin
+ *	Description: a process that pinned the screen is gone
+ *	input: con -- the console
+ *	output: none
+ *	side-effect: term_lock must be held
+ */
+void vga_unpin(vga_con_t* con) {
+  if (con->pins > 0) {
+    con->pins--;
+  }
+}
+
+/*
+ *	Function: vga_flip_queue
+ *	Description: hand over a frame for a pinned screen. The program drew
+ *	             it in cached memory; the copy into text memory happens
+ *	             in one go at the next rtc tick, so the screen never shows
+ *	             half of it.
+ *	input: con -- the console, frame -- VGA_FRAME_BYTES of cells,
+ *	       waiter -- thread to wake once it is copied, or NULL
+ *	output: 0, -1 if the console has a frame queued already
+ *	side-effect: interrupts must be off until the waiter blocks
+ */
+int32_t vga_flip_queue(vga_con_t* con, const uint16_t* frame, struct thread* waiter) {
+  if (con->flip != NULL || vga_flips_queued >= VGA_SLOTS) {
+    return -1;
+  }
+  con->flip = frame;
+  con->flip_waiter = waiter;
+  vga_flip_q[vga_flips_queued++] = con;
+  return 0;
+}
+
+/*
+ *	Function: vga_flip_tick
+ *	Description: copy every queued frame onto its screen
+ *	input: none
+ *	output: none
+ *	side-effect: wakes the threads waiting for them; term_lock must be held
+ */
+void vga_flip_tick() {
+  vga_con_t* con;
+  thread_t* waiter;
+  uint32_t i;
+
+  for (i = 0; i < vga_flips_queued; i++) {
+    con = vga_flip_q[i];
+    memcpy(vga_screen(con), con->flip, VGA_FRAME_BYTES);
+    waiter = con->flip_waiter;
+    con->flip = NULL;
+    con->flip_waiter = NULL;
+    if (waiter != NULL) {
+      thread_wake(waiter);
+    }
+  }
+  vga_stats.flips += vga_flips_queued;
+  vga_flips_queued = 0;
+}
+
+/*
+ *	Function: vga_flip_forget
+ *	Description: a thread blocked in vidflip is being freed
+ *	input: waiter -- the thread
+ *	output: none
+ *	side-effect: interrupts must be off
+ */
+void vga_flip_forget(struct thread* waiter) {
+  uint32_t i;
+
+  for (i = 0; i < vga_flips_queued; i++) {
+    if (vga_flip_q[i]->flip_waiter == waiter) {
+      vga_flip_cancel(vga_flip_q[i], vga_flip_q[i]->flip);
+      return;
+    }
+  }
+}
+
+/*
+ *	Function: vga_flip_cancel
+ *	Description: a process is going away with a frame still queued by
+ *	             one of its threads
+ *	input: con -- the console, frame -- the process's back page
+ *	output: none
+ *	side-effect: term_lock must be held
+ */
+void vga_flip_cancel(vga_con_t* con, const uint16_t* frame) {
+  uint32_t i;
+
+  if (con->flip != frame || frame == NULL) {
+    return;
+  }
+  con->flip = NULL;
+  con->flip_waiter = NULL;
+  for (i = 0; i < vga_flips_queued; i++) {
+    if (vga_flip_q[i] == con) {
+      vga_flip_q[i] = vga_flip_q[--vga_flips_queued];
+      break;
+    }
+  }
+}
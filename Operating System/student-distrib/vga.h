@@ -0,0 +1,92 @@
+#ifndef _VGA_H
+#define _VGA_H
+
+#include "types.h"
+
+/* text-mode consoles in hardware: the 32kb text window at VIDEO is split
+ * into page-aligned slots, one per terminal and one to build scrollback
+ * views in. Each console's screen sits somewhere in its slot and the CRTC
+ * start address points at the one on display, so switching is a register
+ * write and a console in the background draws into its own slot. A line
+ * feed at the bottom moves the screen one row down its slot and clears
+ * the new row; only when the screen reaches the end of the slot is it
+ * copied back to the start. Rows that leave the top are kept in the
+ * console's scrollback. */
+#define VGA_CRTC_INDEX      0x3D4
+#define VGA_CRTC_DATA       0x3D5
+#define VGA_START_HIGH      0x0C
+#define VGA_START_LOW       0x0D
+#define VGA_WINDOW          0x8000    /* bytes of text memory from VIDEO */
+#define VGA_COLS            80        /* NUM_COLS, lib.h comes after terminal.h */
+#define VGA_ROWS            25
+#define VGA_SLOTS           4
+#define VGA_VIEW_SLOT       (VGA_SLOTS - 1)
+#define VGA_SLOT_CELLS      (VGA_WINDOW / 2 / VGA_SLOTS)
+#define VGA_SLOT_ROWS       (VGA_SLOT_CELLS / VGA_COLS)
+#define VGA_BLANK           0x0720    /* ' ' in ATTRIB */
+/* rows of scrollback per terminal, a power of two */
+#define VGA_SB_LINES        256
+#define VGA_SB_MASK         (VGA_SB_LINES - 1)
+#define VGA_FRAME_BYTES     (VGA_ROWS * VGA_COLS * 2)
+
+struct thread;
+
+typedef struct {
+    uint16_t lines[VGA_SB_LINES][VGA_COLS];
+    uint32_t count;             // rows ever saved, the last VGA_SB_LINES are kept
+} vga_scrollback_t;
+
+typedef struct {
+    uint32_t base;              // first cell of its slot, from VIDEO
+    uint32_t top;               // row of the slot the screen starts at
+    uint32_t pins;              // processes with the slot mapped by vidmap
+    const uint16_t* flip;       // frame to copy in at the next rtc tick, NULL if none
+    struct thread* flip_waiter; // woken once it is on the screen
+    vga_scrollback_t sb;
+} vga_con_t;
+
+typedef struct {
+    uint32_t rows;              // rows scrolled
+    uint32_t wraps;             // copies back to the start of a slot
+    uint32_t shows;             // consoles put on display
+    uint32_t flips;             // frames copied in by vga_flip_tick
+} vga_stats_t;
+
+extern vga_stats_t vga_stats;
+/* the console on display */
+extern vga_con_t* vga_shown;
+/* frames waiting for vga_flip_tick */
+extern volatile uint32_t vga_flips_queued;
+
+/* give a console a slot and clear its screen */
+void vga_con_init(vga_con_t* con, uint32_t slot);
+/* a console's screen, and its offset in cells from VIDEO for the cursor */
+uint16_t* vga_screen(vga_con_t* con);
+uint32_t vga_origin(vga_con_t* con);
+/* physical page vidmap maps for a console, its screen while pinned */
+uint32_t vga_page(vga_con_t* con);
+/* scroll a screen up by rows, more than a screen saves blank rows for the
+ * caller to fill. Returns the scrollback index of the first row that
+ * left the screen. */
+uint32_t vga_scroll(vga_con_t* con, uint32_t rows);
+/* a row of the scrollback by index, NULL once it has been overwritten */
+uint16_t* vga_history_row(vga_con_t* con, uint32_t index);
+/* put a console on display, the caller moves the cursor */
+void vga_show(vga_con_t* con);
+/* look rows further back in the shown scrollback, negative goes forward */
+void vga_view(int32_t rows);
+void vga_view_live();
+/* keep the screen at the start of its slot for a process that mapped it */
+void vga_pin(vga_con_t* con);
+void vga_unpin(vga_con_t* con);
+/* double-buffered vidmap: a whole frame for a pinned screen, copied in
+ * by the next vga_flip_tick. -1 if the console has one queued already. */
+int32_t vga_flip_queue(vga_con_t* con, const uint16_t* frame, struct thread* waiter);
+/* rtc tick, copy the queued frames in and wake their waiters */
+void vga_flip_tick();
+/* drop a queued frame whose memory is going away, without waking anyone */
+void vga_flip_cancel(vga_con_t* con, const uint16_t* frame);
+/* drop the frame a thread that is being freed waits for */
+void vga_flip_forget(struct thread* waiter);
+
+#endif
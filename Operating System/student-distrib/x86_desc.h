@@ -17,6 +17,9 @@
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
 
+/* Entries in the GDT, up to and including the LDT descriptor */
+#define GDT_ENTRIES 8
+
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
 
@@ -120,6 +123,7 @@ extern uint32_t ldt_size;
 extern seg_desc_t ldt_desc_ptr;
 extern seg_desc_t gdt_desc_ptr;
 extern seg_desc_t gdt_ptr;
+extern seg_desc_t gdt[GDT_ENTRIES];
 extern uint32_t ldt;
 
 extern uint32_t tss_size;
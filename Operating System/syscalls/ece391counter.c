@@ -7,7 +7,7 @@
 
 int main ()
 {
-    uint32_t i, cnt, max = 0;
+    uint32_t i, cnt, max = 0, start;
     uint8_t buf[BUFSIZE];
 
     ece391_fdputs(1, (uint8_t*)"Enter the Test Number: (0): 100, (1): 10000, (2): 100000\n");
@@ -34,11 +34,16 @@ int main ()
         }
     }
 
+    start = ece391_clock_us();
     for (i = 0; i < max; i++) {
         ece391_itoa(i+1, buf, 10);
         ece391_fdputs(1, buf);
         ece391_fdputs(1, (uint8_t*)"\n");
     }
+    ece391_itoa(ece391_clock_us() - start, buf, 10);
+    ece391_fdputs(1, (uint8_t*)"elapsed ");
+    ece391_fdputs(1, buf);
+    ece391_fdputs(1, (uint8_t*)" us\n");
 
     return 0;
 }
@@ -0,0 +1,34 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * Usage:
+ *   dmesg           print the kernel log, oldest record first
+ *   dmesg <text>    add a line of text to the kernel log
+ *
+ * The kernel keeps the last 256 records; older ones are gone.
+ */
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    int32_t fd, cnt;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"klog"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open klog\n");
+        return 2;
+    }
+    if (0 == ece391_getargs (buf, BUFSIZE) && '\0' != buf[0]) {
+        ece391_write (fd, buf, ece391_strlen (buf));
+    } else {
+        while (0 < (cnt = ece391_read (fd, buf, BUFSIZE))) {
+            ece391_write (1, buf, cnt);
+        }
+    }
+    ece391_close (fd);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define ITER_SHIFT 8
+#define ITERATIONS (1 << ITER_SHIFT)
+
+/*
+ * Usage: execbench
+ *
+ * Times ITERATIONS execute/halt round trips of a child that exits as soon
+ * as it starts (execbench re-run with the argument "-"), and prints the
+ * minimum, average and maximum cost in TSC cycles, and the wall time of
+ * the whole run.
+ */
+
+static uint64_t
+rdtsc (void)
+{
+    uint64_t tsc;
+
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint64_t start, total = 0;
+    uint32_t delta, min = 0xFFFFFFFF, max = 0, wall;
+    int32_t i;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && 0 == ece391_strcmp (buf, (uint8_t*)"-"))
+        return 0;
+
+    wall = ece391_clock_us ();
+    for (i = 0; i < ITERATIONS; i++) {
+        start = rdtsc ();
+        if (0 != ece391_execute ((uint8_t*)"execbench -")) {
+            ece391_fdputs (1, (uint8_t*)"execute failed\n");
+            return 3;
+        }
+        delta = (uint32_t)(rdtsc () - start);
+        total += delta;
+        if (delta < min)
+            min = delta;
+        if (delta > max)
+            max = delta;
+    }
+    wall = ece391_clock_us () - wall;
+
+    ece391_fdputs (1, (uint8_t*)"exec/halt round trip (cycles):");
+    put_num (" min ", min);
+    put_num (" avg ", (uint32_t)(total >> ITER_SHIFT));
+    put_num (" max ", max);
+    put_num (", avg ", wall >> ITER_SHIFT);
+    ece391_fdputs (1, (uint8_t*)" us\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NTHREADS    2
+#define STACK_SIZE  0x1000
+#define SPINS       2000000
+#define TEXT_LEN    4096
+#define ROUNDS      64
+
+/*
+ * Usage: fputest
+ *
+ * Starts NTHREADS threads with ece391_clone that each keep their own value
+ * in all four lanes of xmm0 while spinning long enough to be preempted,
+ * then check it is still there.  The main thread then searches a buffer
+ * for a byte with SSE2 (16 bytes per compare) and with a plain loop,
+ * checks they agree and prints the cycles each took.
+ */
+
+static uint8_t text[TEXT_LEN] __attribute__((aligned(16)));
+
+static inline uint32_t
+rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void
+worker (void* arg)
+{
+    uint32_t val = (uint32_t)arg + 1;
+    uint32_t lanes[4];
+    volatile uint32_t i;
+    int32_t j, ok = 1;
+
+    asm volatile ("movd %0, %%xmm0; pshufd $0, %%xmm0, %%xmm0" : : "r"(val));
+    for (i = 0; i < SPINS; i++)
+        ;
+    asm volatile ("movdqu %%xmm0, %0" : "=m"(lanes));
+    for (j = 0; j < 4; j++) {
+        if (lanes[j] != val)
+            ok = 0;
+    }
+    ece391_halt (ok ? 0 : 1);
+}
+
+/* index of the first c in buf (len a multiple of 16), len if none */
+static uint32_t
+find_sse (const uint8_t* buf, uint32_t len, uint8_t c)
+{
+    uint32_t i, mask;
+
+    asm volatile ("movd %0, %%xmm1; punpcklbw %%xmm1, %%xmm1;"
+                  "pshuflw $0, %%xmm1, %%xmm1; pshufd $0, %%xmm1, %%xmm1"
+                  : : "r"((uint32_t)c));
+    for (i = 0; i < len; i += 16) {
+        asm volatile ("movdqa (%1), %%xmm2; pcmpeqb %%xmm1, %%xmm2; pmovmskb %%xmm2, %0"
+                      : "=r"(mask) : "r"(buf + i) : "memory");
+        if (mask != 0)
+            return i + __builtin_ctz (mask);
+    }
+    return len;
+}
+
+static uint32_t
+find_scalar (const uint8_t* buf, uint32_t len, uint8_t c)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        if (buf[i] == c)
+            return i;
+    }
+    return len;
+}
+
+int main ()
+{
+    int32_t tids[NTHREADS];
+    uint8_t* stacks;
+    uint8_t buf[16];
+    uint32_t i, start, sse_cycles = 0, scalar_cycles = 0;
+    int32_t fail = 0;
+
+    stacks = (uint8_t*)ece391_sbrk (NTHREADS * STACK_SIZE);
+    if (-1 == (int32_t)stacks) {
+        ece391_fdputs (1, (uint8_t*)"fputest: sbrk FAIL\n");
+        return 2;
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        tids[i] = ece391_clone (worker, stacks + (i + 1) * STACK_SIZE, (void*)i);
+        if (-1 == tids[i]) {
+            ece391_fdputs (1, (uint8_t*)"fputest: clone FAIL\n");
+            return 2;
+        }
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        if (0 != ece391_join (tids[i]))
+            fail = 1;
+    }
+
+    for (i = 0; i < TEXT_LEN; i++)
+        text[i] = 'a' + i % 26;
+    text[TEXT_LEN - 7] = '!';
+    for (i = 0; i < ROUNDS; i++) {
+        start = rdtsc_lo ();
+        if (find_sse (text, TEXT_LEN, '!') != TEXT_LEN - 7)
+            fail = 1;
+        sse_cycles += rdtsc_lo () - start;
+        start = rdtsc_lo ();
+        if (find_scalar (text, TEXT_LEN, '!') != TEXT_LEN - 7)
+            fail = 1;
+        scalar_cycles += rdtsc_lo () - start;
+    }
+    if (find_sse (text, TEXT_LEN, '?') != TEXT_LEN)
+        fail = 1;
+
+    ece391_fdputs (1, (uint8_t*)"sse search: ");
+    ece391_itoa (sse_cycles / ROUNDS, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" cycles, scalar: ");
+    ece391_itoa (scalar_cycles / ROUNDS, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" cycles\n");
+    ece391_fdputs (1, fail ? (uint8_t*)"fputest: FAIL\n" : (uint8_t*)"fputest: PASS\n");
+    return fail ? 2 : 0;
+}
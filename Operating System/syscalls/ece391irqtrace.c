@@ -0,0 +1,41 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * Usage:
+ *   irqtrace         print the interrupt-off report
+ *   irqtrace reset   start the measurement over
+ *
+ * The report has a histogram of how long interrupts stayed off and the
+ * call sites with the longest sections, as "file:line -> file:line".
+ */
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    int32_t fd, cnt;
+
+    if (0 != ece391_getargs (buf, BUFSIZE))
+        buf[0] = '\0';
+    if (-1 == (fd = ece391_open ((uint8_t*)"irqtrace"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open irqtrace\n");
+        return 2;
+    }
+    if (0 == ece391_strcmp (buf, (uint8_t*)"reset")) {
+        ece391_write (fd, buf, 1);
+        ece391_close (fd);
+        return 0;
+    }
+    while (0 < (cnt = ece391_read (fd, buf, BUFSIZE)))
+        ece391_write (1, buf, cnt);
+    ece391_close (fd);
+    if (-1 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"read failed\n");
+        return 3;
+    }
+    return 0;
+}
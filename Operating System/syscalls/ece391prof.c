@@ -0,0 +1,91 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define NSAMPLES 256
+#define HEXBUFSIZE 12
+
+/*
+ * Usage:
+ *   prof <hz>   start sampling at <hz> samples per second
+ *   prof stop   stop sampling and dump the recorded samples
+ *   prof dump   dump the recorded samples without stopping
+ *
+ * The dump has one record per line, "S pid cs eip" for a sample and
+ * "C pid inode" when a pid starts running an executable, all in hex.
+ * Feed it to profsym.py on the host for a flat profile.
+ */
+
+static void
+put_hex (uint32_t value)
+{
+    uint8_t buf[HEXBUFSIZE];
+
+    ece391_itoa (value, buf, 16);
+    ece391_fdputs (1, buf);
+}
+
+static int32_t
+dump (void)
+{
+    ece391_prof_sample_t samples[NSAMPLES];
+    int32_t cnt, i;
+
+    while (0 < (cnt = ece391_prof_read (samples, sizeof (samples)))) {
+        cnt /= sizeof (ece391_prof_sample_t);
+        for (i = 0; i < cnt; i++) {
+            if (0 == samples[i].type) {
+                ece391_fdputs (1, (uint8_t*)"S ");
+                put_hex (samples[i].pid);
+                ece391_fdputs (1, (uint8_t*)" ");
+                put_hex (samples[i].cs);
+                ece391_fdputs (1, (uint8_t*)" ");
+                put_hex (samples[i].eip);
+            } else {
+                ece391_fdputs (1, (uint8_t*)"C ");
+                put_hex (samples[i].pid);
+                ece391_fdputs (1, (uint8_t*)" ");
+                put_hex (samples[i].eip);
+            }
+            ece391_fdputs (1, (uint8_t*)"\n");
+        }
+    }
+    if (-1 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"prof_read failed\n");
+        return 3;
+    }
+    return 0;
+}
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    int32_t hz, i;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
+        return 3;
+    }
+    if (0 == ece391_strcmp (buf, (uint8_t*)"stop")) {
+        ece391_prof_stop ();
+        return dump ();
+    }
+    if (0 == ece391_strcmp (buf, (uint8_t*)"dump"))
+        return dump ();
+
+    hz = 0;
+    for (i = 0; '\0' != buf[i]; i++) {
+        if (buf[i] < '0' || buf[i] > '9') {
+            hz = 0;
+            break;
+        }
+        hz = hz * 10 + (buf[i] - '0');
+    }
+    if (-1 == ece391_prof_start (hz)) {
+        ece391_fdputs (1, (uint8_t*)"usage: prof <hz> | stop | dump\n");
+        return 3;
+    }
+    return 0;
+}
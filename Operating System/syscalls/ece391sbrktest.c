@@ -0,0 +1,57 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define HEAP_STEP  0x10000
+#define HEAP_STEPS 16
+#define TOO_BIG    0x10000000
+
+/*
+ * Usage: sbrktest
+ *
+ * Grows the heap with sbrk in HEAP_STEPS steps of HEAP_STEP bytes, fills
+ * and checks every word, shrinks it back and makes sure an oversized
+ * request fails.  Returns 0 and prints PASS when all of that works.
+ */
+
+int main ()
+{
+    uint32_t* base;
+    uint32_t* end;
+    uint32_t* p;
+    int32_t i, ret;
+
+    base = (uint32_t*)ece391_sbrk (0);
+    if (-1 == (int32_t)base) {
+        ece391_fdputs (1, (uint8_t*)"sbrktest: sbrk(0) FAIL\n");
+        return 2;
+    }
+    for (i = 0; i < HEAP_STEPS; i++) {
+        ret = ece391_sbrk (HEAP_STEP);
+        if (ret != (int32_t)base + i * HEAP_STEP) {
+            ece391_fdputs (1, (uint8_t*)"sbrktest: grow FAIL\n");
+            return 2;
+        }
+    }
+    end = (uint32_t*)ece391_sbrk (0);
+    for (p = base; p < end; p++)
+        *p = (uint32_t)p;
+    for (p = base; p < end; p++) {
+        if (*p != (uint32_t)p) {
+            ece391_fdputs (1, (uint8_t*)"sbrktest: data FAIL\n");
+            return 2;
+        }
+    }
+    if (-1 != ece391_sbrk (TOO_BIG)) {
+        ece391_fdputs (1, (uint8_t*)"sbrktest: limit FAIL\n");
+        return 2;
+    }
+    if ((int32_t)end != ece391_sbrk (-(HEAP_STEPS * HEAP_STEP)) ||
+        (int32_t)base != ece391_sbrk (0)) {
+        ece391_fdputs (1, (uint8_t*)"sbrktest: shrink FAIL\n");
+        return 2;
+    }
+    ece391_fdputs (1, (uint8_t*)"sbrktest: PASS\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define BENCH_BYTES (64 * 1024)
+
+/*
+ * Usage:
+ *   sercat <file>   copy a file or device (e.g. kstat) to the serial port
+ *   sercat          stream 64kb of numbered lines to the serial port
+ *
+ * Prints how many bytes went out and how long the writes took. The
+ * kernel queues the output, so the writes only wait once its ring is full.
+ */
+
+int main ()
+{
+    uint8_t name[BUFSIZE];
+    uint8_t buf[BUFSIZE];
+    uint8_t num[16];
+    int32_t in, out, cnt, len;
+    uint32_t total, start, i;
+
+    if (-1 == (out = ece391_open ((uint8_t*)"serial"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open serial\n");
+        return 2;
+    }
+    total = 0;
+    start = ece391_clock_us ();
+    if (0 == ece391_getargs (name, BUFSIZE) && '\0' != name[0]) {
+        if (-1 == (in = ece391_open (name))) {
+            ece391_fdputs (1, (uint8_t*)"file not found\n");
+            return 2;
+        }
+        while (0 < (cnt = ece391_read (in, buf, BUFSIZE))) {
+            ece391_write (out, buf, cnt);
+            total += cnt;
+        }
+        ece391_close (in);
+    } else {
+        for (i = 0; total < BENCH_BYTES; i++) {
+            ece391_itoa (i, buf, 10);
+            len = ece391_strlen (buf);
+            ece391_strcpy (buf + len, (uint8_t*)" the quick brown fox jumps over the lazy dog\n");
+            len = ece391_strlen (buf);
+            ece391_write (out, buf, len);
+            total += len;
+        }
+    }
+    ece391_close (out);
+
+    ece391_itoa (total, num, 10);
+    ece391_fdputs (1, num);
+    ece391_fdputs (1, (uint8_t*)" bytes queued in ");
+    ece391_itoa (ece391_clock_us () - start, num, 10);
+    ece391_fdputs (1, num);
+    ece391_fdputs (1, (uint8_t*)" us\n");
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * Usage: sleep <ms>
+ *
+ * Sleeps for <ms> milliseconds and prints how long it actually took, as
+ * measured by the monotonic clock.
+ */
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t ms, start, i;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: sleep <ms>\n");
+        return 3;
+    }
+    ms = 0;
+    for (i = 0; '\0' != buf[i]; i++) {
+        if (buf[i] < '0' || buf[i] > '9') {
+            ece391_fdputs (1, (uint8_t*)"usage: sleep <ms>\n");
+            return 3;
+        }
+        ms = ms * 10 + (buf[i] - '0');
+    }
+    start = ece391_clock_us ();
+    if (-1 == ece391_msleep (ms)) {
+        ece391_fdputs (1, (uint8_t*)"nanosleep failed\n");
+        return 2;
+    }
+    ece391_itoa (ece391_clock_us () - start, buf, 10);
+    ece391_fdputs (1, (uint8_t*)"slept ");
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" us\n");
+    return 0;
+}
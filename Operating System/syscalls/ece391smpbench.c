@@ -0,0 +1,94 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAX_THREADS 4
+#define STACK_SIZE  0x1000
+#define WORK        (1 << 24)
+
+/*
+ * Usage: smpbench
+ *
+ * Splits a fixed amount of CPU-bound work over 1, 2, 3 and 4 threads
+ * started with ece391_clone and prints the cycles each split took and
+ * the speedup over one thread, times 100.  On a single processor the
+ * speedup stays near 100; with the other processors online it grows
+ * with the thread count until it runs out of cpus.
+ */
+
+static volatile uint32_t sums[MAX_THREADS];
+static volatile uint32_t per_thread;
+
+static inline uint32_t
+rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void
+worker (void* arg)
+{
+    uint32_t idx = (uint32_t)arg;
+    uint32_t n = per_thread;
+    uint32_t i, x = idx + 1;
+
+    for (i = 0; i < n; i++)
+        x = x * 1103515245 + 12345;
+    sums[idx] = x;
+    ece391_halt (0);
+}
+
+static void
+put_num (const char* label, uint32_t num)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (num, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+int main ()
+{
+    int32_t tids[MAX_THREADS];
+    uint8_t* stacks;
+    uint32_t n, i, start, cycles, base = 0, us;
+    int32_t fail = 0;
+
+    stacks = (uint8_t*)ece391_sbrk (MAX_THREADS * STACK_SIZE);
+    if (-1 == (int32_t)stacks) {
+        ece391_fdputs (1, (uint8_t*)"smpbench: sbrk FAIL\n");
+        return 2;
+    }
+    for (n = 1; n <= MAX_THREADS; n++) {
+        per_thread = WORK / n;
+        us = ece391_clock_us ();
+        start = rdtsc_lo ();
+        for (i = 0; i < n; i++) {
+            tids[i] = ece391_clone (worker, stacks + (i + 1) * STACK_SIZE,
+                                    (void*)i);
+            if (-1 == tids[i]) {
+                ece391_fdputs (1, (uint8_t*)"smpbench: clone FAIL\n");
+                return 2;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (0 != ece391_join (tids[i]))
+                fail = 1;
+        }
+        cycles = rdtsc_lo () - start;
+        us = ece391_clock_us () - us;
+        if (1 == n)
+            base = cycles;
+        put_num ("threads ", n);
+        put_num (": ", cycles);
+        put_num (" cycles (", us);
+        put_num (" us), speedup x100 ", base / (cycles / 100 + 1));
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    ece391_fdputs (1, fail ? (uint8_t*)"smpbench: FAIL\n" : (uint8_t*)"smpbench: PASS\n");
+    return fail ? 2 : 0;
+}
@@ -102,3 +102,22 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/* Microseconds on the monotonic clock.  The value wraps every 71 minutes,
+ * so only the difference of two readings means anything. */
+uint32_t ece391_clock_us(void)
+{
+    ece391_timespec_t ts;
+
+    if (0 != ece391_clock_gettime (CLOCK_MONOTONIC, &ts))
+        return 0;
+    return ts.sec * 1000000 + ts.nsec / 1000;
+}
+
+int32_t ece391_msleep(uint32_t ms)
+{
+    ece391_timespec_t ts;
+
+    ts.sec = ms / 1000;
+    ts.nsec = (ms % 1000) * 1000000;
+    return ece391_nanosleep (&ts);
+}
@@ -19,8 +19,52 @@ extern int32_t ece391_open (const uint8_t* filename);
 extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
+/* Double-buffered vidmap.  The first call keeps the screen_start pointer
+ * from ece391_vidmap but points it at a private copy of the screen; each
+ * later call puts that copy on the screen at the next rtc tick and returns
+ * once it is there.  The copy keeps the frame, so only changes need
+ * redrawing. */
+extern int32_t ece391_vidflip (void);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_prof_start (int32_t hz);
+extern int32_t ece391_prof_stop (void);
+extern int32_t ece391_prof_read (void* buf, int32_t nbytes);
+/* Moves the end of the heap by increment bytes, returns the old end
+ * (like a pointer to the new memory) or -1. */
+extern int32_t ece391_sbrk (int32_t increment);
+/* Starts fn(arg) as a new thread of this program on the stack ending at
+ * stack_top.  fn must finish with ece391_halt, which ends only that
+ * thread.  Returns a thread id for ece391_join, or -1. */
+extern int32_t ece391_clone (void (*fn)(void*), void* stack_top, void* arg);
+/* Waits for a thread from ece391_clone and returns its halt status. */
+extern int32_t ece391_join (int32_t tid);
+
+/* Clock for ece391_clock_gettime: time since boot, never goes back. */
+#define CLOCK_MONOTONIC 1
+
+typedef struct {
+	uint32_t sec;
+	uint32_t nsec;
+} ece391_timespec_t;
+
+/* Reads a clock with nanosecond resolution, returns 0 or -1. */
+extern int32_t ece391_clock_gettime (int32_t clock_id, ece391_timespec_t* tp);
+/* Blocks for at least *req, rounded up to the 1 ms timer tick. */
+extern int32_t ece391_nanosleep (const ece391_timespec_t* req);
+/* ece391_read that gives up after ms milliseconds and returns -1; with
+ * ms 0 it only takes what is ready now. */
+extern int32_t ece391_read_timeout (int32_t fd, void* buf, int32_t nbytes, uint32_t ms);
+
+/* Record returned by ece391_prof_read; type 0 is a sample of the
+ * interrupted eip/cs, type 1 says pid is running the file whose
+ * inode number is in eip. */
+typedef struct {
+	uint32_t eip;
+	uint16_t cs;
+	uint8_t pid;
+	uint8_t type;
+} ece391_prof_sample_t;
 
 enum signums {
 	DIV_ZERO = 0,
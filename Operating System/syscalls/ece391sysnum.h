@@ -11,5 +11,15 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_PROF_START 11
+#define SYS_PROF_STOP  12
+#define SYS_PROF_READ  13
+#define SYS_SBRK       14
+#define SYS_CLONE      15
+#define SYS_JOIN       16
+#define SYS_CLOCK_GETTIME 17
+#define SYS_NANOSLEEP  18
+#define SYS_READ_TIMEOUT 19
+#define SYS_VIDFLIP    20
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,58 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NTHREADS    4
+#define STACK_SIZE  0x1000
+#define COUNT       200000
+
+/*
+ * Usage: threads
+ *
+ * Starts NTHREADS threads with ece391_clone, each on its own stack from
+ * ece391_sbrk, that count to COUNT in a shared array slot and halt with
+ * their index.  The main thread joins them all and checks the counts and
+ * exit statuses, printing PASS or FAIL.
+ */
+
+static volatile uint32_t counts[NTHREADS];
+
+static void
+worker (void* arg)
+{
+    uint32_t idx = (uint32_t)arg;
+    uint32_t i;
+
+    for (i = 0; i < COUNT; i++)
+        counts[idx]++;
+    ece391_halt (idx);
+}
+
+int main ()
+{
+    int32_t tids[NTHREADS];
+    uint8_t* stacks;
+    int32_t i, fail = 0;
+
+    stacks = (uint8_t*)ece391_sbrk (NTHREADS * STACK_SIZE);
+    if (-1 == (int32_t)stacks) {
+        ece391_fdputs (1, (uint8_t*)"threads: sbrk FAIL\n");
+        return 2;
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        tids[i] = ece391_clone (worker, stacks + (i + 1) * STACK_SIZE, (void*)i);
+        if (-1 == tids[i]) {
+            ece391_fdputs (1, (uint8_t*)"threads: clone FAIL\n");
+            return 2;
+        }
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        if (i != ece391_join (tids[i]) || COUNT != counts[i])
+            fail = 1;
+    }
+    if (-1 != ece391_join (tids[0]))
+        fail = 1;
+    ece391_fdputs (1, fail ? (uint8_t*)"threads: FAIL\n" : (uint8_t*)"threads: PASS\n");
+    return fail ? 2 : 0;
+}